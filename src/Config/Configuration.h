@@ -179,27 +179,79 @@ constexpr size_t MaxGCodeLength = 101;					// maximum number of non-comment char
 // Define the maximum length of a GCode that we can queue to synchronise it to a move. Long enough for M150 R255 U255 B255 P255 S255 F1 encoded in binary mode (64 bytes).
 constexpr size_t ShortGCodeLength = 64;
 
-// Output buffer length and number of buffers
-// When using RTOS, it is best if it is possible to fit an HTTP response header in a single buffer. Our headers are currently about 230 bytes long.
+// Output buffer lengths and numbers of buffers
+// Output buffers come in three size classes. A new response starts in a small buffer, and when a buffer fills up the response continues in a buffer of the next larger class,
+// so that short responses don't waste memory and long ones need fewer buffers. If there are no free buffers of the wanted class then we use another class.
+// Our HTTP response headers are currently about 230 bytes long, so a header starts in a small buffer and continues in a standard one.
+// The data for all the buffers is allocated in a single block.
 // A note on reserved buffers: the worst case is when a GCode with a long response is processed. After string the response, there must be enough buffer space
 // for the HTTP responder to return a status response. Otherwise DWC never gets to know that it needs to make a rr_reply call and the system deadlocks.
+// RESERVED_OUTPUT_BUFFERS is in units of the standard buffer size OUTPUT_BUFFER_SIZE.
 #if SAME70 || SAME5x
-constexpr size_t OUTPUT_BUFFER_SIZE = 256;				// How many bytes does each OutputBuffer hold?
-constexpr size_t OUTPUT_BUFFER_COUNT = 40;				// How many OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_SIZE = 256;				// How many bytes does each standard OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_COUNT = 28;				// How many standard OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_SMALL_SIZE = 64;			// How many bytes does each small OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_SMALL_COUNT = 24;		// How many small OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_LARGE_SIZE = 1024;		// How many bytes does each large OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_LARGE_COUNT = 2;			// How many large OutputBuffer instances do we have?
 constexpr size_t RESERVED_OUTPUT_BUFFERS = 4;			// Number of reserved output buffers after long responses, enough to hold a status response
 #elif SAM4E || SAM4S
-constexpr size_t OUTPUT_BUFFER_SIZE = 256;				// How many bytes does each OutputBuffer hold?
-constexpr size_t OUTPUT_BUFFER_COUNT = 26;				// How many OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_SIZE = 256;				// How many bytes does each standard OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_COUNT = 18;				// How many standard OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_SMALL_SIZE = 64;			// How many bytes does each small OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_SMALL_COUNT = 16;		// How many small OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_LARGE_SIZE = 1024;		// How many bytes does each large OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_LARGE_COUNT = 1;			// How many large OutputBuffer instances do we have?
 constexpr size_t RESERVED_OUTPUT_BUFFERS = 4;			// Number of reserved output buffers after long responses, enough to hold a status response
 #elif __LPC17xx__
-constexpr uint16_t OUTPUT_BUFFER_SIZE = 256;            // How many bytes does each OutputBuffer hold?
-constexpr size_t OUTPUT_BUFFER_COUNT = 16;              // How many OutputBuffer instances do we have?
+constexpr uint16_t OUTPUT_BUFFER_SIZE = 256;            // How many bytes does each standard OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_COUNT = 12;              // How many standard OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_SMALL_SIZE = 64;         // How many bytes does each small OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_SMALL_COUNT = 8;         // How many small OutputBuffer instances do we have?
+constexpr size_t OUTPUT_BUFFER_LARGE_SIZE = 1024;       // How many bytes does each large OutputBuffer hold?
+constexpr size_t OUTPUT_BUFFER_LARGE_COUNT = 0;         // How many large OutputBuffer instances do we have? None, because one would use a quarter of the buffer RAM
+                                                        // and leave too few buffers for the other channels; chains of standard buffers are used instead.
 constexpr size_t RESERVED_OUTPUT_BUFFERS = 2;           // Number of reserved output buffers after long responses. Must be enough for an HTTP header
 #else
 # error
 #endif
 
-constexpr size_t maxQueuedCodes = 16;					// How many codes can be queued?
+// Total number of bytes in all the output buffers
+constexpr size_t OUTPUT_BUFFER_TOTAL_SIZE = (OUTPUT_BUFFER_SMALL_SIZE * OUTPUT_BUFFER_SMALL_COUNT) + (OUTPUT_BUFFER_SIZE * OUTPUT_BUFFER_COUNT) + (OUTPUT_BUFFER_LARGE_SIZE * OUTPUT_BUFFER_LARGE_COUNT);
+
+// Large object model reports are generated and sent in chunks of about this size, so that they don't need all the output buffers at once
+constexpr size_t ModelResponseChunkSize = (OUTPUT_BUFFER_TOTAL_SIZE - (OUTPUT_BUFFER_SIZE * RESERVED_OUTPUT_BUFFERS))/4;
+
+// Size of the buffer used to queue codes that must be synchronised with moves. Each queued code needs 8 bytes plus its length rounded up to a multiple of 4.
+#if SAME70 || SAME5x
+constexpr size_t CodeQueueBufferSize = 4096;
+#elif SAM4E || SAM4S
+constexpr size_t CodeQueueBufferSize = 2048;
+#else
+constexpr size_t CodeQueueBufferSize = 1024;
+#endif
+
+// Number of compiled expressions from macro files and loops that we cache. Each one typically needs 100 to 300 bytes of heap memory.
+#if SAME70 || SAME5x
+constexpr size_t ExpressionCacheEntries = 32;
+#else
+constexpr size_t ExpressionCacheEntries = 16;
+#endif
+
+// Number of slots in the cache of object model table lookups. Must be a power of 2. Each one needs 4 bytes of RAM.
+#if SAME70 || SAME5x
+constexpr size_t ObjectModelLookupCacheSize = 128;
+#else
+constexpr size_t ObjectModelLookupCacheSize = 64;
+#endif
+
+// Number of web files whose location, size and ETag we cache so that we can answer repeated requests for them quickly. Each one needs about 30 bytes of RAM plus two filenames.
+#if SAME70 || SAME5x
+constexpr size_t WebFileCacheEntries = 16;
+#else
+constexpr size_t WebFileCacheEntries = 8;
+#endif
+constexpr size_t WebFileCacheNameLength = 48;				// maximum length of a cached web file name excluding the terminating null, longer names are not cached
 
 // These two definitions are only used if TRACK_OBJECT_NAMES is defined, however that definition isn't available in this file
 #if SAME70 || SAME5x
@@ -274,6 +326,8 @@ constexpr size_t MAX_FILES = 10;						// Must be large enough to handle the max
 #endif
 
 constexpr size_t FILE_BUFFER_SIZE = 128;
+constexpr size_t SbcFileReadAheadSize = 1024;			// In SBC mode, small reads from files opened for reading fetch this much data from the SBC so that later reads need no transfers
+constexpr size_t NumSbcReadAheadBuffers = 4;			// The maximum number of read-ahead buffers. They are allocated when first needed in SBC mode and then reused.
 
 constexpr size_t MaxThumbnails = 4;						// Maximum number of thumbnail images read from the job file that we store and report
 
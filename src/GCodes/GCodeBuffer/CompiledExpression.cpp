@@ -0,0 +1,211 @@
+/*
+ * CompiledExpression.cpp
+ */
+
+#include "CompiledExpression.h"
+#include <Platform/Platform.h>
+
+// CompiledExpression members
+
+CompiledExpression::CompiledExpression(const Instruction *_ecv_array pCode, size_t pNumInstructions, const ExpressionValue *_ecv_array pConstants, size_t pNumConstants,
+										const char *_ecv_array pNames, size_t pNameChars, size_t pLength) noexcept
+	: constants(nullptr), names(nullptr), numInstructions(pNumInstructions), numConstants(pNumConstants), nameChars(pNameChars), length(pLength)
+{
+	code = new Instruction[pNumInstructions];
+	memcpy(code, pCode, pNumInstructions * sizeof(Instruction));
+	if (pNumConstants != 0)
+	{
+		constants = new ExpressionValue[pNumConstants];
+		for (size_t i = 0; i < pNumConstants; ++i)
+		{
+			constants[i] = pConstants[i];							// this increments the reference counts of any heap strings
+		}
+	}
+	if (pNameChars != 0)
+	{
+		names = new char[pNameChars];
+		memcpy(names, pNames, pNameChars);
+	}
+}
+
+CompiledExpression::~CompiledExpression()
+{
+	delete[] code;
+	delete[] constants;												// this releases any heap strings
+	delete[] names;
+}
+
+size_t CompiledExpression::GetMemoryUsed() const noexcept
+{
+	return sizeof(*this) + numInstructions * sizeof(Instruction) + numConstants * sizeof(ExpressionValue) + nameChars;
+}
+
+// ExpressionCompiler members
+
+// Append an instruction and return its index. 'stackChange' is the net change in the number of values on the evaluation stack when it is executed.
+size_t ExpressionCompiler::Emit(CompiledExpression::OpCode op, size_t column, int stackChange, uint16_t arg, uint16_t arg2, uint8_t flags) noexcept
+{
+	depth += stackChange;
+	if (depth > maxDepth)
+	{
+		maxDepth = depth;
+	}
+
+	if (numInstructions < CompiledExpression::MaxInstructions)
+	{
+		CompiledExpression::Instruction& instr = code[numInstructions];
+		instr.op = op;
+		instr.flags = flags;
+		instr.column = (uint16_t)column;
+		instr.arg = arg;
+		instr.arg2 = arg2;
+	}
+	else
+	{
+		overflowed = true;
+	}
+	return numInstructions++;
+}
+
+// Make the jump instruction at the specified index jump to the next instruction to be emitted
+void ExpressionCompiler::SetJumpTarget(size_t instructionIndex) noexcept
+{
+	if (instructionIndex < CompiledExpression::MaxInstructions)
+	{
+		code[instructionIndex].arg = (uint16_t)numInstructions;
+	}
+}
+
+uint16_t ExpressionCompiler::AddConstant(const ExpressionValue& val) noexcept
+{
+	if (numConstants < CompiledExpression::MaxConstants)
+	{
+		constants[numConstants] = val;
+		return numConstants++;
+	}
+	overflowed = true;
+	return 0;
+}
+
+// Add a name to the name table and return its offset
+uint16_t ExpressionCompiler::AddName(const char *_ecv_array name) noexcept
+{
+	const size_t len = strlen(name) + 1;
+	if (nameChars + len <= CompiledExpression::MaxNameChars)
+	{
+		memcpy(names + nameChars, name, len);
+		const uint16_t offset = nameChars;
+		nameChars += len;
+		return offset;
+	}
+	overflowed = true;
+	return 0;
+}
+
+// Create the compiled expression, or return nullptr if it is too complex
+CompiledExpression *_ecv_null ExpressionCompiler::Finish(size_t length) const noexcept
+{
+	if (overflowed || maxDepth > (int)CompiledExpression::MaxStackDepth || depth != 1)
+	{
+		return nullptr;
+	}
+	return new CompiledExpression(code, numInstructions, constants, numConstants, names, nameChars, length);
+}
+
+// ExpressionCache members
+
+ExpressionCache::Entry ExpressionCache::entries[ExpressionCacheEntries] = { };
+uint32_t ExpressionCache::useCounter = 0;
+uint32_t ExpressionCache::hits = 0;
+uint32_t ExpressionCache::misses = 0;
+uint32_t ExpressionCache::notCompiled = 0;
+
+// FNV-1a hash of the expression text
+/*static*/ uint32_t ExpressionCache::Hash(const char *_ecv_array text, size_t textLength) noexcept
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < textLength; ++i)
+	{
+		hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// Look for a compiled version of the specified text. If found, return true with 'ce' set to the compiled expression, or to nullptr if it could not be compiled.
+/*static*/ bool ExpressionCache::Find(const char *_ecv_array text, size_t textLength, const CompiledExpression *_ecv_null& ce) noexcept
+{
+	const uint32_t hash = Hash(text, textLength);
+	for (Entry& e : entries)
+	{
+		if (e.text != nullptr && e.hash == hash && e.textLength == textLength && memcmp(e.text, text, textLength) == 0)
+		{
+			e.lastUsed = ++useCounter;
+			ce = e.ce;
+			++hits;
+			return true;
+		}
+	}
+	++misses;
+	return false;
+}
+
+// Add a compiled expression to the cache, taking ownership of it. If the cache is full, replace the least recently used entry.
+/*static*/ void ExpressionCache::Add(const char *_ecv_array text, size_t textLength, CompiledExpression *_ecv_null ce) noexcept
+{
+	Entry *victim = &entries[0];
+	for (Entry& e : entries)
+	{
+		if (e.text == nullptr)
+		{
+			victim = &e;
+			break;
+		}
+		if ((int32_t)(e.lastUsed - victim->lastUsed) < 0)
+		{
+			victim = &e;
+		}
+	}
+
+	ReleaseEntry(*victim);
+	victim->text = new char[textLength];
+	memcpy(victim->text, text, textLength);
+	victim->textLength = (uint16_t)textLength;
+	victim->hash = Hash(text, textLength);
+	victim->ce = ce;
+	victim->lastUsed = ++useCounter;
+	if (ce == nullptr)
+	{
+		++notCompiled;
+	}
+}
+
+/*static*/ void ExpressionCache::ReleaseEntry(Entry& e) noexcept
+{
+	delete e.ce;
+	e.ce = nullptr;
+	delete[] e.text;
+	e.text = nullptr;
+}
+
+/*static*/ void ExpressionCache::Diagnostics(MessageType mtype, Platform& p) noexcept
+{
+	unsigned int numUsed = 0;
+	size_t memoryUsed = 0;
+	for (const Entry& e : entries)
+	{
+		if (e.text != nullptr)
+		{
+			++numUsed;
+			memoryUsed += e.textLength;
+			if (e.ce != nullptr)
+			{
+				memoryUsed += e.ce->GetMemoryUsed();
+			}
+		}
+	}
+	p.MessageF(mtype, "Expression cache: entries %u/%u, memory %u, hits %" PRIu32 ", misses %" PRIu32 ", not compiled %" PRIu32 "\n",
+				numUsed, (unsigned int)ExpressionCacheEntries, (unsigned int)memoryUsed, hits, misses, notCompiled);
+	hits = misses = notCompiled = 0;
+}
+
+// End
@@ -0,0 +1,136 @@
+/*
+ * CompiledExpression.h
+ *
+ * Expressions in macro files are often evaluated many times, for example inside 'while' loops or in macros that are called repeatedly.
+ * To avoid parsing the text each time, ExpressionParser can compile an expression into a compact sequence of instructions for a simple stack machine.
+ * Numeric and string literals are converted once, named constants and function names are resolved once, and object model paths and variable names
+ * are stored ready for lookup. The compiled expressions are held in a small cache.
+ */
+
+#ifndef SRC_GCODES_GCODEBUFFER_COMPILEDEXPRESSION_H_
+#define SRC_GCODES_GCODEBUFFER_COMPILEDEXPRESSION_H_
+
+#include <RepRapFirmware.h>
+#include <ObjectModel/ObjectModel.h>
+
+// Class to represent a compiled expression
+class CompiledExpression
+{
+public:
+	enum class OpCode : uint8_t
+	{
+		pushConstant,					// push constants[arg]
+		pushNamedConstant,				// push the value of a named constant that can only be evaluated at run time (iterations, line, result); arg is the constant number
+		pushParameter,					// push the value of parameter names[arg], after popping arg2 index values
+		pushLocal,						// push the value of local variable names[arg], after popping arg2 index values
+		pushGlobal,						// push the value of global variable names[arg], after popping arg2 index values
+		pushObjectModel,				// push the value of object model path names[arg], after popping arg2 index values
+		unaryOperator,					// apply unary operator 'arg' to the value on top of the stack
+		binaryOperator,					// apply binary operator 'arg' to the top two values on the stack, replacing them by the result
+		toBool,							// check that the value on top of the stack is Boolean
+		jumpIfFalseElsePop,				// if the value on top of the stack is false then jump to arg, else pop it
+		jumpIfTrueElsePop,				// if the value on top of the stack is true then jump to arg, else pop it
+		jumpIfFalsePop,					// pop the value on top of the stack and jump to arg if it was false
+		jump,							// jump to arg
+		callFunction,					// call function 'arg' with arg2 operands popped from the stack
+	};
+
+	// Bits in the flags field of an instruction
+	static constexpr uint8_t FlagInvert = 0x01;			// binary operator: invert the result of a comparison
+	static constexpr uint8_t FlagWantLength = 0x02;		// identifier: return the length of the array instead of the array
+	static constexpr uint8_t FlagWantExists = 0x04;		// identifier: return whether the value exists
+
+	struct Instruction
+	{
+		OpCode op;
+		uint8_t flags;
+		uint16_t column;				// offset from the start of the expression text of the source of this instruction, used for error reporting
+		uint16_t arg;
+		uint16_t arg2;
+	};
+
+	static constexpr size_t MaxInstructions = 64;
+	static constexpr size_t MaxConstants = 16;
+	static constexpr size_t MaxNameChars = 160;
+	static constexpr size_t MaxStackDepth = 12;
+
+	CompiledExpression(const Instruction *_ecv_array pCode, size_t pNumInstructions, const ExpressionValue *_ecv_array pConstants, size_t pNumConstants,
+						const char *_ecv_array pNames, size_t pNameChars, size_t pLength) noexcept;
+	~CompiledExpression();
+	CompiledExpression(const CompiledExpression&) = delete;
+	CompiledExpression& operator=(const CompiledExpression&) = delete;
+
+	size_t GetNumInstructions() const noexcept { return numInstructions; }
+	const Instruction& GetInstruction(size_t n) const noexcept pre(n < numInstructions) { return code[n]; }
+	const ExpressionValue& GetConstant(size_t n) const noexcept pre(n < numConstants) { return constants[n]; }
+	const char *_ecv_array GetName(size_t offset) const noexcept { return names + offset; }
+	size_t GetLength() const noexcept { return length; }
+	size_t GetMemoryUsed() const noexcept;
+
+private:
+	Instruction *_ecv_array code;
+	ExpressionValue *_ecv_array _ecv_null constants;
+	char *_ecv_array _ecv_null names;
+	uint16_t numInstructions;
+	uint8_t numConstants;
+	uint8_t nameChars;
+	uint16_t length;					// the number of characters of source text that the expression occupied
+};
+
+// Class used by ExpressionParser to build a compiled expression
+class ExpressionCompiler
+{
+public:
+	ExpressionCompiler() noexcept : numInstructions(0), numConstants(0), nameChars(0), depth(0), maxDepth(0), overflowed(false) { }
+
+	size_t Emit(CompiledExpression::OpCode op, size_t column, int stackChange, uint16_t arg = 0, uint16_t arg2 = 0, uint8_t flags = 0) noexcept;
+	void SetJumpTarget(size_t instructionIndex) noexcept;
+	void AdjustDepth(int stackChange) noexcept { depth += stackChange; }
+	uint16_t AddConstant(const ExpressionValue& val) noexcept;
+	uint16_t AddName(const char *_ecv_array name) noexcept;
+
+	CompiledExpression *_ecv_null Finish(size_t length) const noexcept;
+
+private:
+	CompiledExpression::Instruction code[CompiledExpression::MaxInstructions];
+	ExpressionValue constants[CompiledExpression::MaxConstants];
+	char names[CompiledExpression::MaxNameChars];
+	size_t numInstructions;
+	size_t numConstants;
+	size_t nameChars;
+	int depth;
+	int maxDepth;
+	bool overflowed;
+};
+
+// Cache of compiled expressions, indexed by the source text.
+// Because the key is the text of the expression up to the end of the line, an edited file never finds a stale entry.
+// This is only accessed by the Main task.
+class ExpressionCache
+{
+public:
+	static bool Find(const char *_ecv_array text, size_t textLength, const CompiledExpression *_ecv_null& ce) noexcept;
+	static void Add(const char *_ecv_array text, size_t textLength, CompiledExpression *_ecv_null ce) noexcept;
+	static void Diagnostics(MessageType mtype, Platform& p) noexcept;
+
+private:
+	struct Entry
+	{
+		char *_ecv_array _ecv_null text;		// copy of the source text, or nullptr if the entry is unused
+		CompiledExpression *_ecv_null ce;		// compiled expression, or nullptr if the expression could not be compiled
+		uint32_t hash;
+		uint32_t lastUsed;
+		uint16_t textLength;
+	};
+
+	static uint32_t Hash(const char *_ecv_array text, size_t textLength) noexcept;
+	static void ReleaseEntry(Entry& e) noexcept;
+
+	static Entry entries[ExpressionCacheEntries];
+	static uint32_t useCounter;
+	static uint32_t hits;
+	static uint32_t misses;
+	static uint32_t notCompiled;
+};
+
+#endif /* SRC_GCODES_GCODEBUFFER_COMPILEDEXPRESSION_H_ */
@@ -8,6 +8,7 @@
 #include "ExpressionParser.h"
 
 #include "GCodeBuffer.h"
+#include "CompiledExpression.h"
 #include <Platform/RepRap.h>
 #include <Platform/Platform.h>
 #include <General/NamedEnum.h>
@@ -31,6 +32,12 @@ namespace StackUsage
 	constexpr uint32_t GetObjectValueUsingTableNumber = 48;
 }
 
+// Lists of binary operators and their priorities
+static constexpr const char *BinaryOperators = "?^&|!=<>+-*/";				// for multi-character operators <= and >= and != this is the first character
+static constexpr uint8_t BinaryOperatorPriorities[] = { 1, 2, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6 };
+constexpr uint8_t UnaryPriority = 10;											// must be higher than any binary operator priority
+static_assert(ARRAY_SIZE(BinaryOperatorPriorities) == strlen(BinaryOperators));
+
 // These can't be declared locally inside ParseIdentifierExpression because NamedEnum includes static data
 NamedEnum(NamedConstant, unsigned int, _false, iterations, line, _null, pi, _result, _true);
 NamedEnum(Function, unsigned int, abs, acos, asin, atan, atan2, cos, datetime, degrees, exists, floor, isnan, max, min, mod, radians, random, sin, sqrt, tan);
@@ -59,7 +66,36 @@ ExpressionValue ExpressionParser::Parse(bool evaluate) THROWS(GCodeException)
 {
 	obsoleteField.Clear();
 	ExpressionValue result;
-	ParseInternal(result, evaluate, 0);
+	if (evaluate && ShouldUseCache())
+	{
+		size_t textLength = 0;
+		while (startp + textLength < endp && startp[textLength] != 0)
+		{
+			++textLength;
+		}
+
+		const CompiledExpression *_ecv_null ce;
+		if (!ExpressionCache::Find(startp, textLength, ce))
+		{
+			CompiledExpression * const newCe = Compile();
+			ExpressionCache::Add(startp, textLength, newCe);
+			ce = newCe;
+		}
+
+		if (ce != nullptr)
+		{
+			Execute(*ce, result);
+		}
+		else
+		{
+			ParseInternal(result, evaluate, 0);
+		}
+	}
+	else
+	{
+		ParseInternal(result, evaluate, 0);
+	}
+
 	if (!obsoleteField.IsEmpty())
 	{
 		reprap.GetPlatform().MessageF(WarningMessage, "obsolete object model field %s queried\n", obsoleteField.c_str());
@@ -71,12 +107,6 @@ ExpressionValue ExpressionParser::Parse(bool evaluate) THROWS(GCodeException)
 // This is recursive, so avoid allocating large amounts of data on the stack
 void ExpressionParser::ParseInternal(ExpressionValue& val, bool evaluate, uint8_t priority) THROWS(GCodeException)
 {
-	// Lists of binary operators and their priorities
-	static constexpr const char *operators = "?^&|!=<>+-*/";				// for multi-character operators <= and >= and != this is the first character
-	static constexpr uint8_t priorities[] = { 1, 2, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6 };
-	constexpr uint8_t UnaryPriority = 10;									// must be higher than any binary operator priority
-	static_assert(ARRAY_SIZE(priorities) == strlen(operators));
-
 	// Start by looking for a unary operator or opening bracket
 	SkipWhiteSpace();
 	const char c = CurrentCharacter();
@@ -87,46 +117,12 @@ void ExpressionParser::ParseInternal(ExpressionValue& val, bool evaluate, uint8_
 		break;
 
 	case '-':
-		AdvancePointer();
-		CheckStack(StackUsage::ParseInternal);
-		ParseInternal(val, evaluate, UnaryPriority);
-		switch (val.GetType())
-		{
-		case TypeCode::Int32:
-			val.iVal = -val.iVal;		//TODO overflow check
-			break;
-
-		case TypeCode::Float:
-			val.fVal = -val.fVal;
-			break;
-
-		default:
-			ThrowParseException("expected numeric value after '-'");
-		}
-		break;
-
 	case '+':
+	case '!':
 		AdvancePointer();
 		CheckStack(StackUsage::ParseInternal);
 		ParseInternal(val, evaluate, UnaryPriority);
-		switch (val.GetType())
-		{
-		case TypeCode::Uint32:
-			// Convert enumeration to integer
-			val.SetInt((int32_t)val.uVal);
-			break;
-
-		case TypeCode::Int32:
-		case TypeCode::Float:
-			break;
-
-		case TypeCode::DateTime_tc:					// unary + converts a DateTime to a seconds count
-			val.SetInt((uint32_t)val.Get56BitValue());
-			break;
-
-		default:
-			ThrowParseException("expected numeric or enumeration value after '+'");
-		}
+		ApplyUnaryOperator(c, val, evaluate);
 		break;
 
 	case '#':
@@ -142,18 +138,7 @@ void ExpressionParser::ParseInternal(ExpressionValue& val, bool evaluate, uint8_
 		{
 			CheckStack(StackUsage::ParseInternal);
 			ParseInternal(val, evaluate, UnaryPriority);
-			if (val.GetType() == TypeCode::CString)
-			{
-				val.SetInt((int32_t)strlen(val.sVal));
-			}
-			else if (val.GetType() == TypeCode::HeapString)
-			{
-				val.SetInt((int32_t)val.shVal.GetLength());
-			}
-			else
-			{
-				ThrowParseException("expected object model value or string after '#");
-			}
+			ApplyUnaryOperator(c, val, evaluate);
 		}
 		break;
 
@@ -167,14 +152,6 @@ void ExpressionParser::ParseInternal(ExpressionValue& val, bool evaluate, uint8_
 		ParseExpectKet(val, evaluate, ')');
 		break;
 
-	case '!':
-		AdvancePointer();
-		CheckStack(StackUsage::ParseInternal);
-		ParseInternal(val, evaluate, UnaryPriority);
-		ConvertToBool(val, evaluate);
-		val.bVal = !val.bVal;
-		break;
-
 	default:
 		if (isdigit(c))						// looks like a number
 		{
@@ -193,54 +170,11 @@ void ExpressionParser::ParseInternal(ExpressionValue& val, bool evaluate, uint8_
 	}
 
 	// See if it is followed by a binary operator
-	do
+	char opChar;
+	bool invert;
+	uint8_t opPrio;
+	while (ParseBinaryOperator(opChar, invert, opPrio, priority))
 	{
-		SkipWhiteSpace();
-		char opChar = CurrentCharacter();
-		if (opChar == 0)	// don't pass null to strchr
-		{
-			return;
-		}
-
-		const char * const q = strchr(operators, opChar);
-		if (q == nullptr)
-		{
-			return;
-		}
-		const size_t index = q - operators;
-		const uint8_t opPrio = priorities[index];
-		if (opPrio <= priority)
-		{
-			return;
-		}
-
-		AdvancePointer();								// skip the [first] operator character
-
-		// Handle >= and <= and !=
-		bool invert = false;
-		if (opChar == '!')
-		{
-			if (CurrentCharacter() != '=')
-			{
-				ThrowParseException("expected '='");
-			}
-			invert = true;
-			AdvancePointer();
-			opChar = '=';
-		}
-		else if ((opChar == '>' || opChar == '<') && CurrentCharacter() == '=')
-		{
-			invert = true;
-			AdvancePointer();
-			opChar ^= ('>' ^ '<');			// change < to > or vice versa
-		}
-
-		// Allow == && || as alternatives to = & |
-		if ((opChar == '=' || opChar == '&' || opChar == '|') && CurrentCharacter() == opChar)
-		{
-			AdvancePointer();
-		}
-
 		// Handle operators that do not always evaluate their second operand
 		switch (opChar)
 		{
@@ -295,316 +229,445 @@ void ExpressionParser::ParseInternal(ExpressionValue& val, bool evaluate, uint8_
 				ExpressionValue val2;
 				CheckStack(StackUsage::ParseInternal);
 				ParseInternal(val2, evaluate, opPrio);	// get the next operand
-				switch(opChar)
-				{
-				case '+':
-					if (val.GetType() == TypeCode::DateTime_tc)
-					{
-						if (val2.GetType() == TypeCode::Uint32)
-						{
-							val.Set56BitValue(val.Get56BitValue() + val2.uVal);
-						}
-						else if (val2.GetType() == TypeCode::Int32)
-						{
-							val.Set56BitValue((int64_t)val.Get56BitValue() + val2.iVal);
-						}
-						else if (evaluate)
-						{
-							ThrowParseException("invalid operand types");
-						}
-					}
-					else
-					{
-						BalanceNumericTypes(val, val2, evaluate);
-						if (val.GetType() == TypeCode::Float)
-						{
-							val.fVal += val2.fVal;
-							val.param = max(val.param, val2.param);
-						}
-						else
-						{
-							val.iVal += val2.iVal;
-						}
-					}
-					break;
-
-				case '-':
-					if (val.GetType() == TypeCode::DateTime_tc)
-					{
-						if (val2.GetType() == TypeCode::DateTime_tc)
-						{
-							// Difference of two data/times
-							val.SetInt((int32_t)(val.Get56BitValue() - val2.Get56BitValue()));
-						}
-						else if (val2.GetType() == TypeCode::Uint32)
-						{
-							val.Set56BitValue(val.Get56BitValue() - val2.uVal);
-						}
-						else if (val2.GetType() == TypeCode::Int32)
-						{
-							val.Set56BitValue((int64_t)val.Get56BitValue() - val2.iVal);
-						}
-						else if (evaluate)
-						{
-							ThrowParseException("invalid operand types");
-						}
-					}
-					else
-					{
-						BalanceNumericTypes(val, val2, evaluate);
-						if (val.GetType() == TypeCode::Float)
-						{
-							val.fVal -= val2.fVal;
-							val.param = max(val.param, val2.param);
-						}
-						else
-						{
-							val.iVal -= val2.iVal;
-						}
-					}
-					break;
-
-				case '*':
-					BalanceNumericTypes(val, val2, evaluate);
-					if (val.GetType() == TypeCode::Float)
-					{
-						val.fVal *= val2.fVal;
-						val.param = max(val.param, val2.param);
-					}
-					else
-					{
-						val.iVal *= val2.iVal;
-					}
-					break;
-
-				case '/':
-					ConvertToFloat(val, evaluate);
-					ConvertToFloat(val2, evaluate);
-					val.fVal /= val2.fVal;
-					val.param = MaxFloatDigitsDisplayedAfterPoint;
-					break;
-
-				case '>':
-					BalanceTypes(val, val2, evaluate);
-					{
-						bool bResult;
-						switch (val.GetType())
-						{
-						case TypeCode::Int32:
-							bResult = (val.iVal > val2.iVal);
-							break;
-
-						case TypeCode::Float:
-							bResult = (val.fVal > val2.fVal);
-							break;
-
-						case TypeCode::DateTime_tc:
-							bResult = val.Get56BitValue() > val2.Get56BitValue();
-							break;
-
-						case TypeCode::Bool:
-							bResult = (val.bVal && !val2.bVal);
-							break;
-
-						default:
-							if (evaluate)
-							{
-								ThrowParseException("expected numeric or Boolean operands to comparison operator");
-							}
-							bResult = false;
-							break;
-						}
-						val.SetBool((invert) ? !bResult : bResult);
-					}
-					break;
-
-				case '<':
-					BalanceTypes(val, val2, evaluate);
-					{
-						bool bResult;
-						switch (val.GetType())
-						{
-						case TypeCode::Int32:
-							bResult = (val.iVal < val2.iVal);
-							break;
-
-						case TypeCode::Float:
-							bResult = (val.fVal < val2.fVal);
-							break;
-
-						case TypeCode::DateTime_tc:
-							bResult = val.Get56BitValue() < val2.Get56BitValue();
-							break;
-
-						case TypeCode::Bool:
-							bResult = (!val.bVal && val2.bVal);
-							break;
-
-						default:
-							if (evaluate)
-							{
-								ThrowParseException("expected numeric or Boolean operands to comparison operator");
-							}
-							bResult = false;
-							break;
-						}
-						val.SetBool((invert) ? !bResult : bResult);
-					}
-					break;
-
-				case '=':
-					{
-						bool bResult;
-						// Before balancing, handle comparisons with null
-						if (val.GetType() == TypeCode::None)
-						{
-							bResult = (val2.GetType() == TypeCode::None);
-						}
-						else if (val2.GetType() == TypeCode::None)
-						{
-							bResult = false;
-						}
-						else
-						{
-							BalanceTypes(val, val2, evaluate);
-							switch (val.GetType())
-							{
-							case TypeCode::ObjectModel_tc:
-								ThrowParseException("cannot compare objects");
-
-							case TypeCode::Int32:
-								bResult = (val.iVal == val2.iVal);
-								break;
-
-							case TypeCode::Uint32:
-								bResult = (val.uVal == val2.uVal);
-								break;
-
-							case TypeCode::Float:
-								bResult = (val.fVal == val2.fVal);
-								break;
-
-							case TypeCode::DateTime_tc:
-								bResult = val.Get56BitValue() == val2.Get56BitValue();
-								break;
-
-							case TypeCode::Bool:
-								bResult = (val.bVal == val2.bVal);
-								break;
-
-							case TypeCode::CString:
-								bResult = (strcmp(val.sVal, (val2.GetType() == TypeCode::HeapString) ? val2.shVal.Get().Ptr() : val2.sVal) == 0);
-								break;
-
-							case TypeCode::HeapString:
-								bResult = (strcmp(val.shVal.Get().Ptr(), (val2.GetType() == TypeCode::HeapString) ? val2.shVal.Get().Ptr() : val2.sVal) == 0);
-								break;
-
-							default:
-								if (evaluate)
-								{
-									ThrowParseException("unexpected operand type to equality operator");
-								}
-								bResult = false;
-								break;
-							}
-						}
-						val.SetBool((invert) ? !bResult : bResult);
-					}
-					break;
-
-				case '^':
-					StringConcat(val, val2);
-					break;
-				}
+				ApplyBinaryOperator(opChar, invert, val, val2, evaluate);
 			}
+			break;
 		}
-	} while (true);
+	}
 }
 
-// Concatenate val1 and val2 and assign the result to val1
-// This is written as a separate function because it needs a temporary string buffer, and its caller is recursive. Its declaration must be declared 'noinline'.
-/*static*/ void  ExpressionParser::StringConcat(ExpressionValue &val, ExpressionValue &val2) noexcept
+// Check whether the next token is a binary operator with priority higher than 'priority'.
+// If it is then skip it and return true with the operator character, whether the result is to be inverted, and the operator priority.
+// The operators >= and <= and != are returned as inverted < and > and =.
+bool ExpressionParser::ParseBinaryOperator(char& opChar, bool& invert, uint8_t& opPrio, uint8_t priority) THROWS(GCodeException)
 {
-    String<MaxStringExpressionLength> str;
-    val.AppendAsString(str.GetRef());
-    val2.AppendAsString(str.GetRef());
-    StringHandle sh(str.c_str());
-    val.SetStringHandle(sh);
-}
+	SkipWhiteSpace();
+	opChar = CurrentCharacter();
+	if (opChar == 0)	// don't pass null to strchr
+	{
+		return false;
+	}
 
-bool ExpressionParser::ParseBoolean() THROWS(GCodeException)
-{
-	ExpressionValue val = Parse();
-	ConvertToBool(val, true);
-	return val.bVal;
-}
+	const char * const q = strchr(BinaryOperators, opChar);
+	if (q == nullptr)
+	{
+		return false;
+	}
+	opPrio = BinaryOperatorPriorities[q - BinaryOperators];
+	if (opPrio <= priority)
+	{
+		return false;
+	}
 
-float ExpressionParser::ParseFloat() THROWS(GCodeException)
-{
-	ExpressionValue val = Parse();
-	ConvertToFloat(val, true);
-	return val.fVal;
-}
+	AdvancePointer();								// skip the [first] operator character
 
-int32_t ExpressionParser::ParseInteger() THROWS(GCodeException)
-{
-	const ExpressionValue val = Parse();
-	switch (val.GetType())
+	// Handle >= and <= and !=
+	invert = false;
+	if (opChar == '!')
 	{
-	case TypeCode::Int32:
-		return val.iVal;
-
-	case TypeCode::Uint32:
-		if (val.uVal > (uint32_t)std::numeric_limits<int32_t>::max())
+		if (CurrentCharacter() != '=')
 		{
-			ThrowParseException("unsigned integer too large");
+			ThrowParseException("expected '='");
 		}
-		return (int32_t)val.uVal;
+		invert = true;
+		AdvancePointer();
+		opChar = '=';
+	}
+	else if ((opChar == '>' || opChar == '<') && CurrentCharacter() == '=')
+	{
+		invert = true;
+		AdvancePointer();
+		opChar ^= ('>' ^ '<');			// change < to > or vice versa
+	}
 
-	default:
-		ThrowParseException("expected integer value");
+	// Allow == && || as alternatives to = & |
+	if ((opChar == '=' || opChar == '&' || opChar == '|') && CurrentCharacter() == opChar)
+	{
+		AdvancePointer();
 	}
+	return true;
 }
 
-uint32_t ExpressionParser::ParseUnsigned() THROWS(GCodeException)
+// Apply a unary operator
+void ExpressionParser::ApplyUnaryOperator(char op, ExpressionValue& val, bool evaluate) THROWS(GCodeException)
 {
-	const ExpressionValue val = Parse();
-	switch (val.GetType())
+	switch (op)
 	{
-	case TypeCode::Uint32:
-		return val.uVal;
+	case '-':
+		switch (val.GetType())
+		{
+		case TypeCode::Int32:
+			val.iVal = -val.iVal;		//TODO overflow check
+			break;
 
-	case TypeCode::Int32:
-		if (val.iVal >= 0)
+		case TypeCode::Float:
+			val.fVal = -val.fVal;
+			break;
+
+		default:
+			ThrowParseException("expected numeric value after '-'");
+		}
+		break;
+
+	case '+':
+		switch (val.GetType())
 		{
-			return (uint32_t)val.iVal;
+		case TypeCode::Uint32:
+			// Convert enumeration to integer
+			val.SetInt((int32_t)val.uVal);
+			break;
+
+		case TypeCode::Int32:
+		case TypeCode::Float:
+			break;
+
+		case TypeCode::DateTime_tc:					// unary + converts a DateTime to a seconds count
+			val.SetInt((uint32_t)val.Get56BitValue());
+			break;
+
+		default:
+			ThrowParseException("expected numeric or enumeration value after '+'");
 		}
-		ThrowParseException("value must be non-negative");
+		break;
+
+	case '#':
+		if (val.GetType() == TypeCode::CString)
+		{
+			val.SetInt((int32_t)strlen(val.sVal));
+		}
+		else if (val.GetType() == TypeCode::HeapString)
+		{
+			val.SetInt((int32_t)val.shVal.GetLength());
+		}
+		else
+		{
+			ThrowParseException("expected object model value or string after '#");
+		}
+		break;
+
+	case '!':
+		ConvertToBool(val, evaluate);
+		val.bVal = !val.bVal;
+		break;
 
 	default:
-		ThrowParseException("expected non-negative integer value");
+		THROW_INTERNAL_ERROR;
 	}
 }
 
-DriverId ExpressionParser::ParseDriverId() THROWS(GCodeException)
-{
-	ExpressionValue val = Parse();
-	ConvertToDriverId(val, true);
-	return val.GetDriverIdValue();
-}
-
-void ExpressionParser::ParseArray(size_t& length, function_ref<void(size_t index) THROWS(GCodeException)> processElement) THROWS(GCodeException)
+// Apply a binary operator that always evaluates both operands
+void ExpressionParser::ApplyBinaryOperator(char opChar, bool invert, ExpressionValue& val, ExpressionValue& val2, bool evaluate) THROWS(GCodeException)
 {
-	size_t numElements = 0;
-	AdvancePointer();					// skip the '{'
-	while (numElements < length)
+	switch(opChar)
 	{
-		processElement(numElements);
-		++numElements;
-		if (CurrentCharacter() != EXPRESSION_LIST_SEPARATOR)
+	case '+':
+		if (val.GetType() == TypeCode::DateTime_tc)
 		{
-			break;
+			if (val2.GetType() == TypeCode::Uint32)
+			{
+				val.Set56BitValue(val.Get56BitValue() + val2.uVal);
+			}
+			else if (val2.GetType() == TypeCode::Int32)
+			{
+				val.Set56BitValue((int64_t)val.Get56BitValue() + val2.iVal);
+			}
+			else if (evaluate)
+			{
+				ThrowParseException("invalid operand types");
+			}
+		}
+		else
+		{
+			BalanceNumericTypes(val, val2, evaluate);
+			if (val.GetType() == TypeCode::Float)
+			{
+				val.fVal += val2.fVal;
+				val.param = max(val.param, val2.param);
+			}
+			else
+			{
+				val.iVal += val2.iVal;
+			}
+		}
+		break;
+
+	case '-':
+		if (val.GetType() == TypeCode::DateTime_tc)
+		{
+			if (val2.GetType() == TypeCode::DateTime_tc)
+			{
+				// Difference of two data/times
+				val.SetInt((int32_t)(val.Get56BitValue() - val2.Get56BitValue()));
+			}
+			else if (val2.GetType() == TypeCode::Uint32)
+			{
+				val.Set56BitValue(val.Get56BitValue() - val2.uVal);
+			}
+			else if (val2.GetType() == TypeCode::Int32)
+			{
+				val.Set56BitValue((int64_t)val.Get56BitValue() - val2.iVal);
+			}
+			else if (evaluate)
+			{
+				ThrowParseException("invalid operand types");
+			}
+		}
+		else
+		{
+			BalanceNumericTypes(val, val2, evaluate);
+			if (val.GetType() == TypeCode::Float)
+			{
+				val.fVal -= val2.fVal;
+				val.param = max(val.param, val2.param);
+			}
+			else
+			{
+				val.iVal -= val2.iVal;
+			}
+		}
+		break;
+
+	case '*':
+		BalanceNumericTypes(val, val2, evaluate);
+		if (val.GetType() == TypeCode::Float)
+		{
+			val.fVal *= val2.fVal;
+			val.param = max(val.param, val2.param);
+		}
+		else
+		{
+			val.iVal *= val2.iVal;
+		}
+		break;
+
+	case '/':
+		ConvertToFloat(val, evaluate);
+		ConvertToFloat(val2, evaluate);
+		val.fVal /= val2.fVal;
+		val.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case '>':
+		BalanceTypes(val, val2, evaluate);
+		{
+			bool bResult;
+			switch (val.GetType())
+			{
+			case TypeCode::Int32:
+				bResult = (val.iVal > val2.iVal);
+				break;
+
+			case TypeCode::Float:
+				bResult = (val.fVal > val2.fVal);
+				break;
+
+			case TypeCode::DateTime_tc:
+				bResult = val.Get56BitValue() > val2.Get56BitValue();
+				break;
+
+			case TypeCode::Bool:
+				bResult = (val.bVal && !val2.bVal);
+				break;
+
+			default:
+				if (evaluate)
+				{
+					ThrowParseException("expected numeric or Boolean operands to comparison operator");
+				}
+				bResult = false;
+				break;
+			}
+			val.SetBool((invert) ? !bResult : bResult);
+		}
+		break;
+
+	case '<':
+		BalanceTypes(val, val2, evaluate);
+		{
+			bool bResult;
+			switch (val.GetType())
+			{
+			case TypeCode::Int32:
+				bResult = (val.iVal < val2.iVal);
+				break;
+
+			case TypeCode::Float:
+				bResult = (val.fVal < val2.fVal);
+				break;
+
+			case TypeCode::DateTime_tc:
+				bResult = val.Get56BitValue() < val2.Get56BitValue();
+				break;
+
+			case TypeCode::Bool:
+				bResult = (!val.bVal && val2.bVal);
+				break;
+
+			default:
+				if (evaluate)
+				{
+					ThrowParseException("expected numeric or Boolean operands to comparison operator");
+				}
+				bResult = false;
+				break;
+			}
+			val.SetBool((invert) ? !bResult : bResult);
+		}
+		break;
+
+	case '=':
+		{
+			bool bResult;
+			// Before balancing, handle comparisons with null
+			if (val.GetType() == TypeCode::None)
+			{
+				bResult = (val2.GetType() == TypeCode::None);
+			}
+			else if (val2.GetType() == TypeCode::None)
+			{
+				bResult = false;
+			}
+			else
+			{
+				BalanceTypes(val, val2, evaluate);
+				switch (val.GetType())
+				{
+				case TypeCode::ObjectModel_tc:
+					ThrowParseException("cannot compare objects");
+
+				case TypeCode::Int32:
+					bResult = (val.iVal == val2.iVal);
+					break;
+
+				case TypeCode::Uint32:
+					bResult = (val.uVal == val2.uVal);
+					break;
+
+				case TypeCode::Float:
+					bResult = (val.fVal == val2.fVal);
+					break;
+
+				case TypeCode::DateTime_tc:
+					bResult = val.Get56BitValue() == val2.Get56BitValue();
+					break;
+
+				case TypeCode::Bool:
+					bResult = (val.bVal == val2.bVal);
+					break;
+
+				case TypeCode::CString:
+					bResult = (strcmp(val.sVal, (val2.GetType() == TypeCode::HeapString) ? val2.shVal.Get().Ptr() : val2.sVal) == 0);
+					break;
+
+				case TypeCode::HeapString:
+					bResult = (strcmp(val.shVal.Get().Ptr(), (val2.GetType() == TypeCode::HeapString) ? val2.shVal.Get().Ptr() : val2.sVal) == 0);
+					break;
+
+				default:
+					if (evaluate)
+					{
+						ThrowParseException("unexpected operand type to equality operator");
+					}
+					bResult = false;
+					break;
+				}
+			}
+			val.SetBool((invert) ? !bResult : bResult);
+		}
+		break;
+
+	case '^':
+		StringConcat(val, val2);
+		break;
+
+	default:
+		THROW_INTERNAL_ERROR;
+	}
+}
+
+// Concatenate val1 and val2 and assign the result to val1
+// This is written as a separate function because it needs a temporary string buffer, and its caller is recursive. Its declaration must be declared 'noinline'.
+/*static*/ void  ExpressionParser::StringConcat(ExpressionValue &val, ExpressionValue &val2) noexcept
+{
+    String<MaxStringExpressionLength> str;
+    val.AppendAsString(str.GetRef());
+    val2.AppendAsString(str.GetRef());
+    StringHandle sh(str.c_str());
+    val.SetStringHandle(sh);
+}
+
+bool ExpressionParser::ParseBoolean() THROWS(GCodeException)
+{
+	ExpressionValue val = Parse();
+	ConvertToBool(val, true);
+	return val.bVal;
+}
+
+float ExpressionParser::ParseFloat() THROWS(GCodeException)
+{
+	ExpressionValue val = Parse();
+	ConvertToFloat(val, true);
+	return val.fVal;
+}
+
+int32_t ExpressionParser::ParseInteger() THROWS(GCodeException)
+{
+	const ExpressionValue val = Parse();
+	switch (val.GetType())
+	{
+	case TypeCode::Int32:
+		return val.iVal;
+
+	case TypeCode::Uint32:
+		if (val.uVal > (uint32_t)std::numeric_limits<int32_t>::max())
+		{
+			ThrowParseException("unsigned integer too large");
+		}
+		return (int32_t)val.uVal;
+
+	default:
+		ThrowParseException("expected integer value");
+	}
+}
+
+uint32_t ExpressionParser::ParseUnsigned() THROWS(GCodeException)
+{
+	const ExpressionValue val = Parse();
+	switch (val.GetType())
+	{
+	case TypeCode::Uint32:
+		return val.uVal;
+
+	case TypeCode::Int32:
+		if (val.iVal >= 0)
+		{
+			return (uint32_t)val.iVal;
+		}
+		ThrowParseException("value must be non-negative");
+
+	default:
+		ThrowParseException("expected non-negative integer value");
+	}
+}
+
+DriverId ExpressionParser::ParseDriverId() THROWS(GCodeException)
+{
+	ExpressionValue val = Parse();
+	ConvertToDriverId(val, true);
+	return val.GetDriverIdValue();
+}
+
+void ExpressionParser::ParseArray(size_t& length, function_ref<void(size_t index) THROWS(GCodeException)> processElement) THROWS(GCodeException)
+{
+	size_t numElements = 0;
+	AdvancePointer();					// skip the '{'
+	while (numElements < length)
+	{
+		processElement(numElements);
+		++numElements;
+		if (CurrentCharacter() != EXPRESSION_LIST_SEPARATOR)
+		{
+			break;
 		}
 		if (numElements == length)
 		{
@@ -929,64 +992,8 @@ void ExpressionParser::ParseIdentifierExpression(ExpressionValue& rslt, bool eva
 			ThrowParseException(InvalidExistsMessage);
 		}
 
-		switch (whichConstant.RawValue())
-		{
-		case NamedConstant::_true:
-			rslt.SetBool(true);
-			return;
-
-		case NamedConstant::_false:
-			rslt.SetBool(false);
-			return;
-
-		case NamedConstant::_null:
-			rslt.SetNull(nullptr);
-			return;
-
-		case NamedConstant::pi:
-			rslt.SetFloat(Pi);
-			return;
-
-		case NamedConstant::iterations:
-			{
-				const int32_t v = gb.CurrentFileMachineState().GetIterations();
-				if (v < 0)
-				{
-					ThrowParseException("'iterations' used when not inside a loop");
-				}
-				rslt.SetInt(v);
-			}
-			return;
-
-		case NamedConstant::_result:
-			{
-				int32_t res;
-				switch (gb.GetLastResult())
-				{
-				case GCodeResult::ok:
-					res = 0;
-					break;
-
-				case GCodeResult::warning:
-				case GCodeResult::warningNotSupported:
-					res = 1;
-					break;
-
-				default:
-					res = 2;
-					break;
-				}
-				rslt.SetInt(res);
-			}
-			return;
-
-		case NamedConstant::line:
-			rslt.SetInt((int32_t)gb.GetLineNumber());
-			return;
-
-		default:
-			THROW_INTERNAL_ERROR;
-		}
+		GetNamedConstantValue(whichConstant.RawValue(), rslt);
+		return;
 	}
 
 	// Check whether it is a function call
@@ -1016,176 +1023,22 @@ void ExpressionParser::ParseIdentifierExpression(ExpressionValue& rslt, bool eva
 			CheckStack(StackUsage::ParseInternal);
 			ParseInternal(rslt, evaluate, 0);					// evaluate the first operand
 
-			switch (func.RawValue())
+			if (func == Function::atan2 || func == Function::mod)
 			{
-			case Function::abs:
-				switch (rslt.GetType())
+				SkipWhiteSpace();
+				if (CurrentCharacter() != ',')
 				{
-				case TypeCode::Int32:
-					rslt.iVal = labs(rslt.iVal);
-					break;
-
-				case TypeCode::Float:
-					rslt.fVal = fabsf(rslt.fVal);
-					break;
-
-				default:
-					if (evaluate)
-					{
-						ThrowParseException("expected numeric operand");
-					}
-					rslt.SetInt(0);
-				}
-				break;
-
-			case Function::sin:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = sinf(rslt.fVal);
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::cos:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = cosf(rslt.fVal);
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::tan:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = tanf(rslt.fVal);
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::asin:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = asinf(rslt.fVal);
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::acos:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = acosf(rslt.fVal);
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::atan:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = atanf(rslt.fVal);
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::atan2:
-				{
-					ConvertToFloat(rslt, evaluate);
-					SkipWhiteSpace();
-					if (CurrentCharacter() != ',')
-					{
-						ThrowParseException("expected ','");
-					}
-					AdvancePointer();
-					SkipWhiteSpace();
-					ExpressionValue nextOperand;
-					// We recently checked the stack for a call to ParseInternal, no need to do it again
-					ParseInternal(nextOperand, evaluate, 0);
-					ConvertToFloat(nextOperand, evaluate);
-					rslt.fVal = atan2f(rslt.fVal, nextOperand.fVal);
-					rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				}
-				break;
-
-			case Function::degrees:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = rslt.fVal * RadiansToDegrees;
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::radians:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = rslt.fVal * DegreesToRadians;
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::sqrt:
-				ConvertToFloat(rslt, evaluate);
-				rslt.fVal = fastSqrtf(rslt.fVal);
-				rslt.param = MaxFloatDigitsDisplayedAfterPoint;
-				break;
-
-			case Function::isnan:
-				ConvertToFloat(rslt, evaluate);
-				rslt.SetBool(std::isnan(rslt.fVal) != 0);
-				break;
-
-			case Function::floor:
-				{
-					ConvertToFloat(rslt, evaluate);
-					const float f = floorf(rslt.fVal);
-					if (f <= (float)std::numeric_limits<int32_t>::max() && f >= (float)std::numeric_limits<int32_t>::min())
-					{
-						rslt.SetInt((int32_t)f);
-					}
-					else
-					{
-						rslt.fVal = f;
-					}
-				}
-				break;
-
-			case Function::mod:
-				{
-					SkipWhiteSpace();
-					if (CurrentCharacter() != ',')
-					{
-						ThrowParseException("expected ','");
-					}
-					AdvancePointer();
-					SkipWhiteSpace();
-					ExpressionValue nextOperand;
-					// We recently checked the stack for a call to ParseInternal, no need to do it again
-					ParseInternal(nextOperand, evaluate, 0);
-					BalanceNumericTypes(rslt, nextOperand, evaluate);
-					if (rslt.GetType() == TypeCode::Float)
-					{
-						rslt.fVal = fmod(rslt.fVal, nextOperand.fVal);
-					}
-					else if (nextOperand.iVal == 0)
-					{
-						rslt.iVal = 0;
-					}
-					else
-					{
-						rslt.iVal %= nextOperand.iVal;
-					}
-				}
-				break;
-
-			case Function::max:
-				for (;;)
-				{
-					SkipWhiteSpace();
-					if (CurrentCharacter() != ',')
-					{
-						break;
-					}
-					AdvancePointer();
-					SkipWhiteSpace();
-					ExpressionValue nextOperand;
-					// We recently checked the stack for a call to ParseInternal, no need to do it again
-					ParseInternal(nextOperand, evaluate, 0);
-					BalanceNumericTypes(rslt, nextOperand, evaluate);
-					if (rslt.GetType() == TypeCode::Float)
-					{
-						rslt.fVal = max<float>(rslt.fVal, nextOperand.fVal);
-						rslt.param = max(rslt.param, nextOperand.param);
-					}
-					else
-					{
-						rslt.iVal = max<int32_t>(rslt.iVal, nextOperand.iVal);
-					}
+					ThrowParseException("expected ','");
 				}
-				break;
-
-			case Function::min:
+				AdvancePointer();
+				SkipWhiteSpace();
+				ExpressionValue nextOperand;
+				// We recently checked the stack for a call to ParseInternal, no need to do it again
+				ParseInternal(nextOperand, evaluate, 0);
+				ApplyBinaryFunction(func.RawValue(), rslt, nextOperand, evaluate);
+			}
+			else if (func == Function::max || func == Function::min)
+			{
 				for (;;)
 				{
 					SkipWhiteSpace();
@@ -1198,73 +1051,12 @@ void ExpressionParser::ParseIdentifierExpression(ExpressionValue& rslt, bool eva
 					ExpressionValue nextOperand;
 					// We recently checked the stack for a call to ParseInternal, no need to do it again
 					ParseInternal(nextOperand, evaluate, 0);
-					BalanceNumericTypes(rslt, nextOperand, evaluate);
-					if (rslt.GetType() == TypeCode::Float)
-					{
-						rslt.fVal = min<float>(rslt.fVal, nextOperand.fVal);
-						rslt.param = max(rslt.param, nextOperand.param);
-					}
-					else
-					{
-						rslt.iVal = min<int32_t>(rslt.iVal, nextOperand.iVal);
-					}
-				}
-				break;
-
-			case Function::random:
-				{
-					uint32_t limit;
-					if (rslt.GetType() == TypeCode::Uint32)
-					{
-						limit = rslt.uVal;
-					}
-					else if (rslt.GetType() == TypeCode::Int32 && rslt.iVal > 0)
-					{
-						limit = rslt.iVal;
-					}
-					else
-					{
-						ThrowParseException("expected positive integer");
-					}
-					rslt.SetInt((int32_t)random(limit));
-				}
-				break;
-
-			case Function::datetime:
-				{
-					uint64_t val;
-					switch (rslt.GetType())
-					{
-					case TypeCode::Int32:
-						val = (uint64_t)max<uint32_t>(rslt.iVal, 0);
-						break;
-
-					case TypeCode::Uint32:
-						val = (uint64_t)rslt.uVal;
-						break;
-
-					case TypeCode::Uint64:
-					case TypeCode::DateTime_tc:
-						val = rslt.Get56BitValue();
-						break;
-
-					case TypeCode::CString:
-						val = ParseDateTime(rslt.sVal);
-						break;
-
-					case TypeCode::HeapString:
-						val = ParseDateTime(rslt.shVal.Get().Ptr());
-						break;
-
-					default:
-						ThrowParseException("can't convert value to DateTime");
-					}
-					rslt.SetDateTime(val);
+					ApplyBinaryFunction(func.RawValue(), rslt, nextOperand, evaluate);
 				}
-				break;
-
-			default:
-				THROW_INTERNAL_ERROR;
+			}
+			else
+			{
+				ApplyUnaryFunction(func.RawValue(), rslt, evaluate);
 			}
 		}
 
@@ -1320,78 +1112,833 @@ void ExpressionParser::ParseIdentifierExpression(ExpressionValue& rslt, bool eva
 	rslt.SetNull(nullptr);
 }
 
-// Parse a string to a DateTime
-time_t ExpressionParser::ParseDateTime(const char *s) const THROWS(GCodeException)
+// Get the value of a named constant
+void ExpressionParser::GetNamedConstantValue(unsigned int whichConstant, ExpressionValue& rslt) const THROWS(GCodeException)
 {
-	tm timeInfo;
-	if (SafeStrptime(s, "%Y-%m-%dT%H:%M:%S", &timeInfo) == nullptr)
+	switch (whichConstant)
 	{
-		ThrowParseException("string is not a valid date and time");
-	}
-	return mktime(&timeInfo);
-}
+	case NamedConstant::_true:
+		rslt.SetBool(true);
+		break;
 
-// Get the value of a variable
-void ExpressionParser::GetVariableValue(ExpressionValue& rslt, const VariableSet *vars, const char *name, bool parameter, bool wantExists) THROWS(GCodeException)
-{
-	const Variable* var = vars->Lookup(name);
-	if (wantExists)
-	{
-		rslt.SetBool(var != nullptr);
-		return;
-	}
+	case NamedConstant::_false:
+		rslt.SetBool(false);
+		break;
 
-	if (var != nullptr && (!parameter || var->GetScope() < 0))
-	{
-		rslt = var->GetValue();
-		return;
-	}
+	case NamedConstant::_null:
+		rslt.SetNull(nullptr);
+		break;
 
-	ThrowParseException((parameter) ? "unknown parameter '%s'" : "unknown variable '%s'", name);
+	case NamedConstant::pi:
+		rslt.SetFloat(Pi);
+		break;
+
+	case NamedConstant::iterations:
+		{
+			const int32_t v = gb.CurrentFileMachineState().GetIterations();
+			if (v < 0)
+			{
+				ThrowParseException("'iterations' used when not inside a loop");
+			}
+			rslt.SetInt(v);
+		}
+		break;
+
+	case NamedConstant::_result:
+		{
+			int32_t res;
+			switch (gb.GetLastResult())
+			{
+			case GCodeResult::ok:
+				res = 0;
+				break;
+
+			case GCodeResult::warning:
+			case GCodeResult::warningNotSupported:
+				res = 1;
+				break;
+
+			default:
+				res = 2;
+				break;
+			}
+			rslt.SetInt(res);
+		}
+		break;
+
+	case NamedConstant::line:
+		rslt.SetInt((int32_t)gb.GetLineNumber());
+		break;
+
+	default:
+		THROW_INTERNAL_ERROR;
+	}
 }
 
-// Parse a quoted string, given that the current character is double-quote
-// This is almost a copy of InternalGetQuotedString in class StringParser
-void ExpressionParser::ParseQuotedString(ExpressionValue& rslt) THROWS(GCodeException)
+// Apply a function that takes a single operand
+void ExpressionParser::ApplyUnaryFunction(unsigned int func, ExpressionValue& rslt, bool evaluate) THROWS(GCodeException)
 {
-	String<MaxStringExpressionLength> str;
-	AdvancePointer();
-	while (true)
+	switch (func)
 	{
-		char c = CurrentCharacter();
-		AdvancePointer();
-		if (c < ' ')
+	case Function::abs:
+		switch (rslt.GetType())
 		{
-			ThrowParseException("control character in string");
+		case TypeCode::Int32:
+			rslt.iVal = labs(rslt.iVal);
+			break;
+
+		case TypeCode::Float:
+			rslt.fVal = fabsf(rslt.fVal);
+			break;
+
+		default:
+			if (evaluate)
+			{
+				ThrowParseException("expected numeric operand");
+			}
+			rslt.SetInt(0);
 		}
-		if (c == '"')
+		break;
+
+	case Function::sin:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = sinf(rslt.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::cos:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = cosf(rslt.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::tan:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = tanf(rslt.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::asin:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = asinf(rslt.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::acos:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = acosf(rslt.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::atan:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = atanf(rslt.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::degrees:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = rslt.fVal * RadiansToDegrees;
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::radians:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = rslt.fVal * DegreesToRadians;
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::sqrt:
+		ConvertToFloat(rslt, evaluate);
+		rslt.fVal = fastSqrtf(rslt.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::isnan:
+		ConvertToFloat(rslt, evaluate);
+		rslt.SetBool(std::isnan(rslt.fVal) != 0);
+		break;
+
+	case Function::floor:
 		{
-			if (CurrentCharacter() != c)
+			ConvertToFloat(rslt, evaluate);
+			const float f = floorf(rslt.fVal);
+			if (f <= (float)std::numeric_limits<int32_t>::max() && f >= (float)std::numeric_limits<int32_t>::min())
 			{
-				StringHandle sh(str.c_str());
-				rslt.SetStringHandle(sh);
-				return;
+				rslt.SetInt((int32_t)f);
+			}
+			else
+			{
+				rslt.fVal = f;
 			}
-			AdvancePointer();
 		}
-		else if (c == '\'')
+		break;
+
+	case Function::random:
 		{
-			if (isalpha(CurrentCharacter()))
+			uint32_t limit;
+			if (rslt.GetType() == TypeCode::Uint32)
 			{
-				// Single quote before an alphabetic character forces that character to lower case
-				c = tolower(CurrentCharacter());
-				AdvancePointer();
+				limit = rslt.uVal;
 			}
-			else if (CurrentCharacter() == c)
+			else if (rslt.GetType() == TypeCode::Int32 && rslt.iVal > 0)
 			{
-				// Two quotes are used to represent one
-				AdvancePointer();
+				limit = rslt.iVal;
+			}
+			else
+			{
+				ThrowParseException("expected positive integer");
 			}
+			rslt.SetInt((int32_t)random(limit));
 		}
-		if (str.cat(c))
+		break;
+
+	case Function::datetime:
 		{
-			ThrowParseException("string too long");
+			uint64_t val;
+			switch (rslt.GetType())
+			{
+			case TypeCode::Int32:
+				val = (uint64_t)max<uint32_t>(rslt.iVal, 0);
+				break;
+
+			case TypeCode::Uint32:
+				val = (uint64_t)rslt.uVal;
+				break;
+
+			case TypeCode::Uint64:
+			case TypeCode::DateTime_tc:
+				val = rslt.Get56BitValue();
+				break;
+
+			case TypeCode::CString:
+				val = ParseDateTime(rslt.sVal);
+				break;
+
+			case TypeCode::HeapString:
+				val = ParseDateTime(rslt.shVal.Get().Ptr());
+				break;
+
+			default:
+				ThrowParseException("can't convert value to DateTime");
+			}
+			rslt.SetDateTime(val);
 		}
+		break;
+
+	default:
+		THROW_INTERNAL_ERROR;
+	}
+}
+
+// Apply a function that takes two operands. For max and min, this is called repeatedly if there are more than two operands.
+void ExpressionParser::ApplyBinaryFunction(unsigned int func, ExpressionValue& rslt, ExpressionValue& nextOperand, bool evaluate) THROWS(GCodeException)
+{
+	switch (func)
+	{
+	case Function::atan2:
+		ConvertToFloat(rslt, evaluate);
+		ConvertToFloat(nextOperand, evaluate);
+		rslt.fVal = atan2f(rslt.fVal, nextOperand.fVal);
+		rslt.param = MaxFloatDigitsDisplayedAfterPoint;
+		break;
+
+	case Function::mod:
+		BalanceNumericTypes(rslt, nextOperand, evaluate);
+		if (rslt.GetType() == TypeCode::Float)
+		{
+			rslt.fVal = fmod(rslt.fVal, nextOperand.fVal);
+		}
+		else if (nextOperand.iVal == 0)
+		{
+			rslt.iVal = 0;
+		}
+		else
+		{
+			rslt.iVal %= nextOperand.iVal;
+		}
+		break;
+
+	case Function::max:
+		BalanceNumericTypes(rslt, nextOperand, evaluate);
+		if (rslt.GetType() == TypeCode::Float)
+		{
+			rslt.fVal = max<float>(rslt.fVal, nextOperand.fVal);
+			rslt.param = max(rslt.param, nextOperand.param);
+		}
+		else
+		{
+			rslt.iVal = max<int32_t>(rslt.iVal, nextOperand.iVal);
+		}
+		break;
+
+	case Function::min:
+		BalanceNumericTypes(rslt, nextOperand, evaluate);
+		if (rslt.GetType() == TypeCode::Float)
+		{
+			rslt.fVal = min<float>(rslt.fVal, nextOperand.fVal);
+			rslt.param = max(rslt.param, nextOperand.param);
+		}
+		else
+		{
+			rslt.iVal = min<int32_t>(rslt.iVal, nextOperand.iVal);
+		}
+		break;
+
+	default:
+		THROW_INTERNAL_ERROR;
+	}
+}
+
+// Parse a string to a DateTime
+time_t ExpressionParser::ParseDateTime(const char *s) const THROWS(GCodeException)
+{
+	tm timeInfo;
+	if (SafeStrptime(s, "%Y-%m-%dT%H:%M:%S", &timeInfo) == nullptr)
+	{
+		ThrowParseException("string is not a valid date and time");
+	}
+	return mktime(&timeInfo);
+}
+
+// Get the value of a variable
+void ExpressionParser::GetVariableValue(ExpressionValue& rslt, const VariableSet *vars, const char *name, bool parameter, bool wantExists) THROWS(GCodeException)
+{
+	const Variable* var = vars->Lookup(name);
+	if (wantExists)
+	{
+		rslt.SetBool(var != nullptr);
+		return;
+	}
+
+	if (var != nullptr && (!parameter || var->GetScope() < 0))
+	{
+		rslt = var->GetValue();
+		return;
+	}
+
+	ThrowParseException((parameter) ? "unknown parameter '%s'" : "unknown variable '%s'", name);
+}
+
+// Parse a quoted string, given that the current character is double-quote
+// This is almost a copy of InternalGetQuotedString in class StringParser
+void ExpressionParser::ParseQuotedString(ExpressionValue& rslt) THROWS(GCodeException)
+{
+	String<MaxStringExpressionLength> str;
+	AdvancePointer();
+	while (true)
+	{
+		char c = CurrentCharacter();
+		AdvancePointer();
+		if (c < ' ')
+		{
+			ThrowParseException("control character in string");
+		}
+		if (c == '"')
+		{
+			if (CurrentCharacter() != c)
+			{
+				StringHandle sh(str.c_str());
+				rslt.SetStringHandle(sh);
+				return;
+			}
+			AdvancePointer();
+		}
+		else if (c == '\'')
+		{
+			if (isalpha(CurrentCharacter()))
+			{
+				// Single quote before an alphabetic character forces that character to lower case
+				c = tolower(CurrentCharacter());
+				AdvancePointer();
+			}
+			else if (CurrentCharacter() == c)
+			{
+				// Two quotes are used to represent one
+				AdvancePointer();
+			}
+		}
+		if (str.cat(c))
+		{
+			ThrowParseException("string too long");
+		}
+	}
+}
+
+// Return true if we should use the compiled expression cache for this expression
+bool ExpressionParser::ShouldUseCache() const noexcept
+{
+	// The cache is only accessed by the Main task, so we only use it for expressions in files that the Main task is executing.
+	// To avoid filling the cache with expressions that are evaluated only once, we use it only in macro files and inside loops.
+	// Elements of array expressions are parsed after skipping the opening brace, so they are never cached.
+	return currentp == startp
+		&& gb.IsDoingLocalFile()
+		&& (gb.IsDoingFileMacro() || gb.CurrentFileMachineState().GetIterations() >= 0);
+}
+
+// Compile the expression, returning nullptr if it is too complex to compile or has a syntax error.
+// If there is a syntax error, the caller will parse the expression in the normal way so that the error is reported exactly as before.
+CompiledExpression *_ecv_null ExpressionParser::Compile() noexcept
+{
+	ExpressionCompiler * const comp = new ExpressionCompiler;
+	CompiledExpression *_ecv_null ce;
+	try
+	{
+		CompileInternal(*comp, 0);
+		ce = comp->Finish(currentp - startp);
+	}
+	catch (const GCodeException&)
+	{
+		ce = nullptr;
+	}
+	delete comp;
+	currentp = startp;
+	return ce;
+}
+
+// Compile a bracketed expression
+void ExpressionParser::CompileExpectKet(ExpressionCompiler& comp, char closingBracket) THROWS(GCodeException)
+{
+	CheckStack(StackUsage::ParseInternal);
+	CompileInternal(comp, 0);
+	if (CurrentCharacter() != closingBracket)
+	{
+		ThrowParseException("expected '%c'", (uint32_t)closingBracket);
+	}
+	AdvancePointer();
+}
+
+// Compile an expression, stopping before any binary operators with priority 'priority' or lower. This must accept the same syntax as ParseInternal.
+// This is recursive, so avoid allocating large amounts of data on the stack
+void ExpressionParser::CompileInternal(ExpressionCompiler& comp, uint8_t priority) THROWS(GCodeException)
+{
+	SkipWhiteSpace();
+	const char c = CurrentCharacter();
+	switch (c)
+	{
+	case '"':
+		{
+			ExpressionValue val;
+			ParseQuotedString(val);
+			comp.Emit(CompiledExpression::OpCode::pushConstant, currentp - startp, 1, comp.AddConstant(val));
+		}
+		break;
+
+	case '-':
+	case '+':
+	case '!':
+		AdvancePointer();
+		CheckStack(StackUsage::ParseInternal);
+		CompileInternal(comp, UnaryPriority);
+		comp.Emit(CompiledExpression::OpCode::unaryOperator, currentp - startp, 0, c);
+		break;
+
+	case '#':
+		AdvancePointer();
+		SkipWhiteSpace();
+		if (isalpha(CurrentCharacter()))
+		{
+			CheckStack(StackUsage::ParseIdentifierExpression);
+			CompileIdentifierExpression(comp, true, false);
+		}
+		else
+		{
+			CheckStack(StackUsage::ParseInternal);
+			CompileInternal(comp, UnaryPriority);
+			comp.Emit(CompiledExpression::OpCode::unaryOperator, currentp - startp, 0, c);
+		}
+		break;
+
+	case '{':
+		AdvancePointer();
+		CompileExpectKet(comp, '}');
+		break;
+
+	case '(':
+		AdvancePointer();
+		CompileExpectKet(comp, ')');
+		break;
+
+	default:
+		if (isdigit(c))						// looks like a number
+		{
+			ExpressionValue val;
+			ParseNumber(val);
+			comp.Emit(CompiledExpression::OpCode::pushConstant, currentp - startp, 1, comp.AddConstant(val));
+		}
+		else if (isalpha(c))				// looks like a variable name
+		{
+			CheckStack(StackUsage::ParseIdentifierExpression);
+			CompileIdentifierExpression(comp, false, false);
+		}
+		else
+		{
+			ThrowParseException("expected an expression");
+		}
+		break;
+	}
+
+	// See if it is followed by a binary operator
+	char opChar;
+	bool invert;
+	uint8_t opPrio;
+	while (ParseBinaryOperator(opChar, invert, opPrio, priority))
+	{
+		switch (opChar)
+		{
+		case '&':
+		case '|':
+			{
+				// The second operand is evaluated only if the first one doesn't determine the result
+				comp.Emit(CompiledExpression::OpCode::toBool, currentp - startp, 0);
+				const size_t jumpIndex = comp.Emit((opChar == '&') ? CompiledExpression::OpCode::jumpIfFalseElsePop : CompiledExpression::OpCode::jumpIfTrueElsePop, currentp - startp, -1);
+				CheckStack(StackUsage::ParseInternal);
+				CompileInternal(comp, opPrio);
+				comp.Emit(CompiledExpression::OpCode::toBool, currentp - startp, 0);
+				comp.SetJumpTarget(jumpIndex);
+			}
+			break;
+
+		case '?':
+			{
+				comp.Emit(CompiledExpression::OpCode::toBool, currentp - startp, 0);
+				const size_t jumpToElse = comp.Emit(CompiledExpression::OpCode::jumpIfFalsePop, currentp - startp, -1);
+				CheckStack(StackUsage::ParseInternal);
+				CompileInternal(comp, opPrio);							// compile the second operand
+				if (CurrentCharacter() != ':')
+				{
+					ThrowParseException("expected ':'");
+				}
+				AdvancePointer();
+				const size_t jumpToEnd = comp.Emit(CompiledExpression::OpCode::jump, currentp - startp, 0);
+				comp.AdjustDepth(-1);									// only one of the second and third operands is evaluated
+				comp.SetJumpTarget(jumpToElse);
+				// We recently checked the stack for a call to CompileInternal, no need to do it again
+				CompileInternal(comp, opPrio - 1);						// compile the third operand, which may be a further conditional expression
+				comp.SetJumpTarget(jumpToEnd);
+				return;
+			}
+
+		default:
+			CheckStack(StackUsage::ParseInternal);
+			CompileInternal(comp, opPrio);								// compile the next operand
+			comp.Emit(CompiledExpression::OpCode::binaryOperator, currentp - startp, -1, opChar, 0, (invert) ? CompiledExpression::FlagInvert : 0);
+			break;
+		}
+	}
+}
+
+// Compile an identifier expression. This must accept the same syntax as ParseIdentifierExpression.
+// *** This function is recursive, so keep its stack usage low!
+void ExpressionParser::CompileIdentifierExpression(ExpressionCompiler& comp, bool applyLengthOperator, bool applyExists) THROWS(GCodeException)
+{
+	if (!isalpha(CurrentCharacter()))
+	{
+		ThrowParseException("expected an identifier");
+	}
+
+	const size_t startColumn = currentp - startp;					// errors when fetching the value are reported at the start of the identifier
+
+	// Loop parsing identifiers and index expressions
+	// When we come across an index expression, compile it so that it pushes its value at run time, and place a marker in the identifier string.
+	String<MaxVariableNameLength> id;
+	unsigned int numIndices = 0;
+	char c;
+	while (isalpha((c = CurrentCharacter())) || isdigit(c) || c == '_' || c == '.' || c == '[')
+	{
+		AdvancePointer();
+		if (c == '[')
+		{
+			CheckStack(StackUsage::ParseInternal);
+			CompileInternal(comp, 0);
+			if (CurrentCharacter() != ']')
+			{
+				ThrowParseException("expected ']'");
+			}
+			AdvancePointer();										// skip the ']'
+			++numIndices;
+			c = '^';												// add the marker
+		}
+		if (id.cat(c))
+		{
+			ThrowParseException("variable name too long");;
+		}
+	}
+
+	// Check for the names of constants. Those that don't change can be evaluated now.
+	const NamedConstant whichConstant(id.c_str());
+	if (whichConstant.IsValid())
+	{
+		if (applyExists)
+		{
+			ThrowParseException(InvalidExistsMessage);
+		}
+
+		switch (whichConstant.RawValue())
+		{
+		case NamedConstant::iterations:
+		case NamedConstant::line:
+		case NamedConstant::_result:
+			comp.Emit(CompiledExpression::OpCode::pushNamedConstant, currentp - startp, 1, whichConstant.RawValue());
+			break;
+
+		default:
+			{
+				ExpressionValue val;
+				GetNamedConstantValue(whichConstant.RawValue(), val);
+				comp.Emit(CompiledExpression::OpCode::pushConstant, currentp - startp, 1, comp.AddConstant(val));
+			}
+			break;
+		}
+		return;
+	}
+
+	// Check whether it is a function call
+	SkipWhiteSpace();
+	if (CurrentCharacter() == '(')
+	{
+		if (applyExists)
+		{
+			ThrowParseException(InvalidExistsMessage);
+		}
+
+		const Function func(id.c_str());
+		if (!func.IsValid())
+		{
+			ThrowParseException("unknown function");
+		}
+
+		AdvancePointer();
+		if (func == Function::exists)
+		{
+			CheckStack(StackUsage::ParseIdentifierExpression);
+			CompileIdentifierExpression(comp, false, true);
+		}
+		else
+		{
+			CheckStack(StackUsage::ParseInternal);
+			CompileInternal(comp, 0);								// compile the first operand
+
+			if (func == Function::atan2 || func == Function::mod)
+			{
+				SkipWhiteSpace();
+				if (CurrentCharacter() != ',')
+				{
+					ThrowParseException("expected ','");
+				}
+				AdvancePointer();
+				SkipWhiteSpace();
+				// We recently checked the stack for a call to CompileInternal, no need to do it again
+				CompileInternal(comp, 0);
+				comp.Emit(CompiledExpression::OpCode::callFunction, currentp - startp, -1, func.RawValue(), 2);
+			}
+			else if (func == Function::max || func == Function::min)
+			{
+				for (;;)
+				{
+					SkipWhiteSpace();
+					if (CurrentCharacter() != ',')
+					{
+						break;
+					}
+					AdvancePointer();
+					SkipWhiteSpace();
+					// We recently checked the stack for a call to CompileInternal, no need to do it again
+					CompileInternal(comp, 0);
+					comp.Emit(CompiledExpression::OpCode::callFunction, currentp - startp, -1, func.RawValue(), 2);
+				}
+			}
+			else
+			{
+				comp.Emit(CompiledExpression::OpCode::callFunction, currentp - startp, 0, func.RawValue(), 1);
+			}
+		}
+
+		SkipWhiteSpace();
+		if (CurrentCharacter() != ')')
+		{
+			ThrowParseException("expected ')'");
+		}
+		AdvancePointer();
+		return;
+	}
+
+	// Check for a parameter, local or global variable, else assume an object model value
+	CompiledExpression::OpCode op;
+	const char *_ecv_array name = id.c_str();
+	if (StringStartsWith(name, "param."))
+	{
+		op = CompiledExpression::OpCode::pushParameter;
+		name += strlen("param.");
+	}
+	else if (StringStartsWith(name, "global."))
+	{
+		op = CompiledExpression::OpCode::pushGlobal;
+		name += strlen("global.");
+	}
+	else if (StringStartsWith(name, "var."))
+	{
+		op = CompiledExpression::OpCode::pushLocal;
+		name += strlen("var.");
+	}
+	else if (applyExists && (strcmp(name, "param") == 0 || strcmp(name, "var") == 0))
+	{
+		// "exists(var)" and "exists(param)" are always true. The identifier can't have had any indices.
+		comp.Emit(CompiledExpression::OpCode::pushConstant, currentp - startp, 1, comp.AddConstant(ExpressionValue(true)));
+		return;
+	}
+	else
+	{
+		op = CompiledExpression::OpCode::pushObjectModel;
+	}
+
+	const uint8_t flags = ((applyLengthOperator) ? CompiledExpression::FlagWantLength : 0) | ((applyExists) ? CompiledExpression::FlagWantExists : 0);
+	comp.Emit(op, startColumn, 1 - (int)numIndices, comp.AddName(name), numIndices, flags);
+}
+
+// Execute a compiled expression, leaving the current pointer at the end of the expression text
+void ExpressionParser::Execute(const CompiledExpression& ce, ExpressionValue& rslt) THROWS(GCodeException)
+{
+	ExpressionValue stack[CompiledExpression::MaxStackDepth];
+	size_t sp = 0;														// the number of values on the stack
+	size_t pc = 0;
+	while (pc < ce.GetNumInstructions())
+	{
+		const CompiledExpression::Instruction& instr = ce.GetInstruction(pc);
+		++pc;
+		currentp = startp + instr.column;								// so that if we throw an exception, the column is reported correctly
+		switch (instr.op)
+		{
+		case CompiledExpression::OpCode::pushConstant:
+			stack[sp++] = ce.GetConstant(instr.arg);
+			break;
+
+		case CompiledExpression::OpCode::pushNamedConstant:
+			GetNamedConstantValue(instr.arg, stack[sp++]);
+			break;
+
+		case CompiledExpression::OpCode::pushParameter:
+		case CompiledExpression::OpCode::pushLocal:
+		case CompiledExpression::OpCode::pushGlobal:
+		case CompiledExpression::OpCode::pushObjectModel:
+			sp -= instr.arg2;											// pop the indices, if any
+			ExecuteIdentifier(ce, pc - 1, stack + sp, stack[sp]);
+			++sp;
+			break;
+
+		case CompiledExpression::OpCode::unaryOperator:
+			ApplyUnaryOperator((char)instr.arg, stack[sp - 1], true);
+			break;
+
+		case CompiledExpression::OpCode::binaryOperator:
+			--sp;
+			ApplyBinaryOperator((char)instr.arg, (instr.flags & CompiledExpression::FlagInvert) != 0, stack[sp - 1], stack[sp], true);
+			break;
+
+		case CompiledExpression::OpCode::toBool:
+			ConvertToBool(stack[sp - 1], true);
+			break;
+
+		case CompiledExpression::OpCode::jumpIfFalseElsePop:
+			if (stack[sp - 1].bVal)
+			{
+				--sp;
+			}
+			else
+			{
+				pc = instr.arg;
+			}
+			break;
+
+		case CompiledExpression::OpCode::jumpIfTrueElsePop:
+			if (stack[sp - 1].bVal)
+			{
+				pc = instr.arg;
+			}
+			else
+			{
+				--sp;
+			}
+			break;
+
+		case CompiledExpression::OpCode::jumpIfFalsePop:
+			--sp;
+			if (!stack[sp].bVal)
+			{
+				pc = instr.arg;
+			}
+			break;
+
+		case CompiledExpression::OpCode::jump:
+			pc = instr.arg;
+			break;
+
+		case CompiledExpression::OpCode::callFunction:
+			if (instr.arg2 == 2)
+			{
+				--sp;
+				ApplyBinaryFunction(instr.arg, stack[sp - 1], stack[sp], true);
+			}
+			else
+			{
+				ApplyUnaryFunction(instr.arg, stack[sp - 1], true);
+			}
+			break;
+
+		default:
+			THROW_INTERNAL_ERROR;
+		}
+	}
+
+	rslt = stack[0];
+	currentp = startp + ce.GetLength();
+}
+
+// Execute an instruction that fetches the value of a variable or object model path, given the values of any indices that were pushed on the stack
+// The result may overwrite the first index.
+void ExpressionParser::ExecuteIdentifier(const CompiledExpression& ce, size_t pc, ExpressionValue *_ecv_array indices, ExpressionValue& rslt) THROWS(GCodeException)
+{
+	const CompiledExpression::Instruction& instr = ce.GetInstruction(pc);
+	const bool wantExists = (instr.flags & CompiledExpression::FlagWantExists) != 0;
+	ObjectExplorationContext context(&gb, (instr.flags & CompiledExpression::FlagWantLength) != 0, wantExists, gb.GetLineNumber(), GetColumn());
+	for (size_t i = 0; i < instr.arg2; ++i)
+	{
+		if (indices[i].GetType() != TypeCode::Int32)
+		{
+			ThrowParseException("expected integer expression");
+		}
+		context.ProvideIndex(indices[i].iVal);
+	}
+
+	const char *_ecv_array const name = ce.GetName(instr.arg);
+	switch (instr.op)
+	{
+	case CompiledExpression::OpCode::pushParameter:
+		GetVariableValue(rslt, &gb.GetVariables(), name, true, wantExists);
+		break;
+
+	case CompiledExpression::OpCode::pushLocal:
+		GetVariableValue(rslt, &gb.GetVariables(), name, false, wantExists);
+		break;
+
+	case CompiledExpression::OpCode::pushGlobal:
+		{
+			auto vars = reprap.GetGlobalVariablesForReading();
+			GetVariableValue(rslt, vars.Ptr(), name, false, wantExists);
+		}
+		break;
+
+	case CompiledExpression::OpCode::pushObjectModel:
+		CheckStack(StackUsage::GetObjectValueUsingTableNumber);
+		rslt = reprap.GetObjectValueUsingTableNumber(context, nullptr, name, 0);
+		if (context.ObsoleteFieldQueried() && obsoleteField.IsEmpty())
+		{
+			obsoleteField.copy(name);
+		}
+		break;
+
+	default:
+		THROW_INTERNAL_ERROR;
 	}
 }
 
@@ -13,6 +13,8 @@
 #include <GCodes/GCodeException.h>
 
 class VariableSet;
+class CompiledExpression;
+class ExpressionCompiler;
 
 class ExpressionParser
 {
@@ -42,6 +44,7 @@ private:
 	[[noreturn]] void __attribute__((noinline)) ThrowParseException(const char *str, uint32_t param) const THROWS(GCodeException);
 
 	void ParseInternal(ExpressionValue& val, bool evaluate, uint8_t priority) THROWS(GCodeException);
+	bool ParseBinaryOperator(char& opChar, bool& invert, uint8_t& opPrio, uint8_t priority) THROWS(GCodeException);
 	void ParseExpectKet(ExpressionValue& rslt, bool evaluate, char expectedKet) THROWS(GCodeException);
 	void __attribute__((noinline)) ParseNumber(ExpressionValue& rslt) noexcept
 		pre(readPointer >= 0; isdigit(gb.buffer[readPointer]));
@@ -54,6 +57,22 @@ private:
 
 	void GetVariableValue(ExpressionValue& rslt, const VariableSet *vars, const char *name, bool parameter, bool wantExists) THROWS(GCodeException);
 
+	// The following must be declared 'noinline' because they are called from recursive functions and have significant stack usage
+	void __attribute__((noinline)) ApplyUnaryOperator(char op, ExpressionValue& val, bool evaluate) THROWS(GCodeException);
+	void __attribute__((noinline)) ApplyBinaryOperator(char opChar, bool invert, ExpressionValue& val, ExpressionValue& val2, bool evaluate) THROWS(GCodeException);
+	void __attribute__((noinline)) ApplyUnaryFunction(unsigned int func, ExpressionValue& rslt, bool evaluate) THROWS(GCodeException);
+	void __attribute__((noinline)) ApplyBinaryFunction(unsigned int func, ExpressionValue& rslt, ExpressionValue& nextOperand, bool evaluate) THROWS(GCodeException);
+
+	// Expression compilation and execution
+	bool ShouldUseCache() const noexcept;
+	CompiledExpression *_ecv_null Compile() noexcept;
+	void CompileInternal(ExpressionCompiler& comp, uint8_t priority) THROWS(GCodeException);
+	void CompileExpectKet(ExpressionCompiler& comp, char closingBracket) THROWS(GCodeException);
+	void CompileIdentifierExpression(ExpressionCompiler& comp, bool applyLengthOperator, bool applyExists) THROWS(GCodeException);
+	void Execute(const CompiledExpression& ce, ExpressionValue& rslt) THROWS(GCodeException);
+	void __attribute__((noinline)) ExecuteIdentifier(const CompiledExpression& ce, size_t pc, ExpressionValue *_ecv_array indices, ExpressionValue& rslt) THROWS(GCodeException);
+	void GetNamedConstantValue(unsigned int whichConstant, ExpressionValue& rslt) const THROWS(GCodeException);
+
 	void ConvertToFloat(ExpressionValue& val, bool evaluate) const THROWS(GCodeException);
 	void ConvertToBool(ExpressionValue& val, bool evaluate) const THROWS(GCodeException);
 	void ConvertToString(ExpressionValue& val, bool evaluate) noexcept;
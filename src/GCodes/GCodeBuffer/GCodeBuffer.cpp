@@ -17,6 +17,7 @@
 #include "BinaryParser.h"
 #include "StringParser.h"
 #include <GCodes/GCodeException.h>
+#include <GCodes/GCodeProfiler.h>
 #include <Platform/RepRap.h>
 #include <Platform/Platform.h>
 #include <Movement/StepTimer.h>
@@ -45,6 +46,7 @@
 
 // Macro to build a standard lambda function that includes the necessary type conversions
 #define OBJECT_MODEL_FUNC(...) OBJECT_MODEL_FUNC_BODY(GCodeBuffer, __VA_ARGS__)
+#define OBJECT_MODEL_FUNC_IF(...) OBJECT_MODEL_FUNC_IF_BODY(GCodeBuffer, __VA_ARGS__)
 
 constexpr ObjectModelTableEntry GCodeBuffer::objectModelTable[] =
 {
@@ -59,12 +61,19 @@ constexpr ObjectModelTableEntry GCodeBuffer::objectModelTable[] =
 	{ "lineNumber",			OBJECT_MODEL_FUNC((int32_t)self->GetLineNumber()),									ObjectModelEntryFlags::live },
 	{ "macroRestartable",	OBJECT_MODEL_FUNC((bool)self->machineState->macroRestartable),						ObjectModelEntryFlags::none },
 	{ "name",				OBJECT_MODEL_FUNC(self->codeChannel.ToString()),									ObjectModelEntryFlags::none },
-	{ "stackDepth",			OBJECT_MODEL_FUNC((int32_t)self->GetStackDepth()),									ObjectModelEntryFlags::none },
+	{ "profile",			OBJECT_MODEL_FUNC_IF(GCodeProfiler::IsEnabled(), self, 1),							ObjectModelEntryFlags::live },
+	{ "stackDepth",			OBJECT_MODEL_FUNC((int32_t)self->GetStackDepth()),									ObjectModelEntryFlags::live },
 	{ "state",				OBJECT_MODEL_FUNC(self->GetStateText()),											ObjectModelEntryFlags::live },
-	{ "volumetric",			OBJECT_MODEL_FUNC((bool)self->machineState->volumetricExtrusion),					ObjectModelEntryFlags::none },
+	{ "volumetric",			OBJECT_MODEL_FUNC((bool)self->machineState->volumetricExtrusion),					ObjectModelEntryFlags::live },
+
+	// 1. inputs[].profile
+	{ "blockedTime",		OBJECT_MODEL_FUNC(GCodeProfiler::GetBlockedTime(self->codeChannel), 3),				ObjectModelEntryFlags::live },
+	{ "calls",				OBJECT_MODEL_FUNC(GCodeProfiler::GetNumCommands(self->codeChannel)),				ObjectModelEntryFlags::live },
+	{ "execTime",			OBJECT_MODEL_FUNC(GCodeProfiler::GetExecTime(self->codeChannel), 3),				ObjectModelEntryFlags::live },
+	{ "maxExecTime",		OBJECT_MODEL_FUNC(GCodeProfiler::GetMaxExecTime(self->codeChannel), 4),				ObjectModelEntryFlags::live },
 };
 
-constexpr uint8_t GCodeBuffer::objectModelTableDescriptor[] = { 1, 12 };
+constexpr uint8_t GCodeBuffer::objectModelTableDescriptor[] = { 2, 13, 4 };
 
 DEFINE_GET_OBJECT_MODEL_TABLE(GCodeBuffer)
 
@@ -98,6 +107,9 @@ GCodeBuffer::GCodeBuffer(GCodeChannel::RawType channel, GCodeInput *normalIn, Fi
 #endif
 	  stringParser(*this),
 	  machineState(new GCodeMachineState()), whenReportDueTimerStarted(millis()),
+#if SUPPORT_OBJECT_MODEL
+	  holdingOutput(false),
+#endif
 #if HAS_SBC_INTERFACE
 	  isBinaryBuffer(false),
 #endif
@@ -123,6 +135,10 @@ void GCodeBuffer::Reset() noexcept
 
 	while (PopState(false)) { }
 
+#if SUPPORT_OBJECT_MODEL
+	FinishModelResponse();
+#endif
+
 #if HAS_SBC_INTERFACE
 	isBinaryBuffer = false;
 	requestedMacroFile.Clear();
@@ -144,6 +160,37 @@ void GCodeBuffer::Init() noexcept
 	timerRunning = false;
 }
 
+#if SUPPORT_OBJECT_MODEL
+
+// Start sending an M409 report in chunks, returning true if we can do so
+bool GCodeBuffer::StartModelResponse() noexcept
+{
+	if (!holdingOutput)
+	{
+		holdingOutput = reprap.GetPlatform().HoldOutput(responseMessageType);
+	}
+	return holdingOutput;
+}
+
+// Send the next chunk of an M409 report
+void GCodeBuffer::SendModelResponseChunk(OutputBuffer *chunk) noexcept
+{
+	reprap.GetPlatform().SendHeldOutput(responseMessageType, chunk);
+}
+
+// Finish or abandon sending an M409 report in chunks
+void GCodeBuffer::FinishModelResponse() noexcept
+{
+	modelResumePoint.Reset();
+	if (holdingOutput)
+	{
+		holdingOutput = false;
+		reprap.GetPlatform().ReleaseOutput(responseMessageType);
+	}
+}
+
+#endif
+
 void GCodeBuffer::StartTimer() noexcept
 {
 	whenTimerStarted = millis();
@@ -241,6 +241,14 @@ public:
 	void AddParameters(VariableSet& vars, int codeRunning) noexcept;
 	VariableSet& GetVariables() const noexcept;
 
+#if SUPPORT_OBJECT_MODEL
+	// Functions to support sending an M409 report in chunks. Other messages to this channel are held back until the report is complete so that they can't get between the chunks.
+	JsonResumePoint& GetModelResumePoint() noexcept { return modelResumePoint; }
+	bool StartModelResponse() noexcept;
+	void SendModelResponseChunk(OutputBuffer *chunk) noexcept;
+	void FinishModelResponse() noexcept;
+#endif
+
 #if SUPPORT_COORDINATE_ROTATION
 	bool DoingCoordinateRotation() const noexcept;
 #endif
@@ -289,6 +297,11 @@ private:
 	uint32_t whenReportDueTimerStarted;					// When the report-due-timer has been started
 	static constexpr uint32_t reportDueInterval = 1000;	// Interval in which we send in ms
 
+#if SUPPORT_OBJECT_MODEL
+	JsonResumePoint modelResumePoint;					// Where to continue an M409 report that we are generating in chunks
+	bool holdingOutput;									// True if we are holding back other messages to this channel while we send an M409 report
+#endif
+
 #if HAS_SBC_INTERFACE
 	bool isBinaryBuffer;
 #endif
@@ -0,0 +1,167 @@
+/*
+ * GCodeProfiler.cpp
+ */
+
+#include "GCodeProfiler.h"
+#include <GCodes/GCodeBuffer/GCodeBuffer.h>
+#include <Platform/OutputMemory.h>
+#include <Movement/StepTimer.h>
+
+GCodeProfiler::ProfileData *_ecv_null GCodeProfiler::data = nullptr;
+bool GCodeProfiler::enabled = false;
+
+/*static*/ void GCodeProfiler::Enable() noexcept
+{
+	if (data == nullptr)
+	{
+		data = new ProfileData;
+		Reset();
+	}
+	enabled = true;
+}
+
+/*static*/ void GCodeProfiler::Reset() noexcept
+{
+	if (data != nullptr)
+	{
+		memset((void *)data, 0, sizeof(ProfileData));
+	}
+}
+
+// Find the slot for the specified code, creating it if necessary. Return nullptr if the table is full.
+/*static*/ GCodeProfiler::CodeStats *_ecv_null GCodeProfiler::FindOrCreateSlot(uint8_t channel, char letter, int16_t number) noexcept
+{
+	const size_t mask = NumCodeSlots - 1;
+	const size_t start = ((uint32_t)(uint16_t)number * 7u + (uint32_t)(uint8_t)letter * 31u + channel) & mask;
+	size_t slot = start;
+	do
+	{
+		CodeStats& cs = data->codes[slot];
+		if (cs.numCalls == 0)
+		{
+			cs.channel = channel;
+			cs.letter = letter;
+			cs.number = number;
+			return &cs;
+		}
+		if (cs.channel == channel && cs.letter == letter && cs.number == number)
+		{
+			return &cs;
+		}
+		slot = (slot + 1) & mask;
+	} while (slot != start);
+	return nullptr;
+}
+
+// Record an attempt to execute the current command. This is only called by the Main task.
+// ActOnCode returns false when a command can't be completed yet, for example because it is waiting for movement to stop or for a lock.
+// The time between the first attempt and completion that was not spent inside ActOnCode is counted as blocked time.
+/*static*/ void GCodeProfiler::CommandAttempted(const GCodeBuffer& gb, uint32_t startTicks, uint32_t endTicks, bool finished) noexcept
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	const uint8_t channel = gb.GetChannel().RawValue();
+	const char letter = gb.GetCommandLetter();
+	const int16_t number = (gb.HasCommandNumber()) ? (int16_t)gb.GetCommandNumber() : -1;
+	ChannelStats& chs = data->channels[channel];
+	if (chs.commandLetter != letter || chs.commandNumber != number)
+	{
+		// Starting a new command, or the previous one was abandoned without completing
+		chs.commandLetter = letter;
+		chs.commandNumber = number;
+		chs.commandStartTicks = startTicks;
+		chs.commandExecTicks = 0;
+	}
+	chs.commandExecTicks += endTicks - startTicks;
+
+	if (finished)
+	{
+		const uint32_t execTicks = chs.commandExecTicks;
+		const uint32_t blockedTicks = (endTicks - chs.commandStartTicks) - execTicks;
+		chs.commandLetter = 0;
+
+		++chs.numCalls;
+		chs.totalExecTicks += execTicks;
+		chs.totalBlockedTicks += blockedTicks;
+		if (execTicks > chs.maxExecTicks)
+		{
+			chs.maxExecTicks = execTicks;
+		}
+
+		CodeStats *_ecv_null const cs = FindOrCreateSlot(channel, letter, number);
+		if (cs == nullptr)
+		{
+			++data->numDiscarded;
+		}
+		else
+		{
+			++cs->numCalls;
+			cs->totalExecTicks += execTicks;
+			cs->totalBlockedTicks += blockedTicks;
+			if (execTicks > cs->maxExecTicks)
+			{
+				cs->maxExecTicks = execTicks;
+			}
+		}
+	}
+}
+
+/*static*/ float GCodeProfiler::TicksToSeconds(uint64_t ticks) noexcept
+{
+	return (float)ticks * (1.0f/(float)StepClockRate);
+}
+
+// Append a report of the statistics to the buffer
+/*static*/ void GCodeProfiler::Report(OutputBuffer *buf) noexcept
+{
+	buf->printf("G-code profiler is %s", (enabled) ? "enabled" : "disabled");
+	if (data == nullptr)
+	{
+		buf->cat('\n');
+		return;
+	}
+
+	buf->catf(", %" PRIu32 " commands not recorded\nChannel Code Calls Exec(ms) MaxExec(ms) Blocked(ms)\n", data->numDiscarded);
+	for (size_t chan = 0; chan < NumGCodeChannels; ++chan)
+	{
+		for (const CodeStats& cs : data->codes)
+		{
+			if (cs.numCalls != 0 && cs.channel == chan)
+			{
+				buf->catf("%s %c", GCodeChannel(chan).ToString(), cs.letter);
+				if (cs.number >= 0)
+				{
+					buf->catf("%d", cs.number);
+				}
+				buf->catf(" %" PRIu32 " %.2f %.3f %.2f\n",
+							cs.numCalls, (double)(TicksToSeconds(cs.totalExecTicks) * 1000.0f), (double)(TicksToSeconds(cs.maxExecTicks) * 1000.0f),
+								(double)(TicksToSeconds(cs.totalBlockedTicks) * 1000.0f));
+			}
+		}
+	}
+}
+
+/*static*/ int32_t GCodeProfiler::GetNumCommands(GCodeChannel chan) noexcept
+{
+	return (data == nullptr) ? 0 : (int32_t)data->channels[chan.RawValue()].numCalls;
+}
+
+/*static*/ float GCodeProfiler::GetExecTime(GCodeChannel chan) noexcept
+{
+	return (data == nullptr) ? 0.0f : TicksToSeconds(data->channels[chan.RawValue()].totalExecTicks);
+}
+
+/*static*/ float GCodeProfiler::GetMaxExecTime(GCodeChannel chan) noexcept
+{
+	return (data == nullptr) ? 0.0f : TicksToSeconds(data->channels[chan.RawValue()].maxExecTicks);
+}
+
+/*static*/ float GCodeProfiler::GetBlockedTime(GCodeChannel chan) noexcept
+{
+	return (data == nullptr) ? 0.0f : TicksToSeconds(data->channels[chan.RawValue()].totalBlockedTicks);
+}
+
+// End
@@ -0,0 +1,77 @@
+/*
+ * GCodeProfiler.h
+ *
+ * Optional profiler that records, for each input channel and G/M/T code, how many times the code was executed,
+ * how long it spent executing, and how long it spent waiting (e.g. for movement to stop or for a resource lock).
+ * The profiler is enabled and reported using M123. Its memory is allocated the first time it is enabled.
+ */
+
+#ifndef SRC_GCODES_GCODEPROFILER_H_
+#define SRC_GCODES_GCODEPROFILER_H_
+
+#include <RepRapFirmware.h>
+#include <GCodes/GCodeChannel.h>
+
+class GCodeProfiler
+{
+public:
+	static bool IsEnabled() noexcept { return enabled; }
+	static void Enable() noexcept;
+	static void Disable() noexcept { enabled = false; }
+	static void Reset() noexcept;
+
+	// Record an attempt to execute the current command in the GCodeBuffer. 'finished' is the value returned by ActOnCode.
+	static void CommandAttempted(const GCodeBuffer& gb, uint32_t startTicks, uint32_t endTicks, bool finished) noexcept;
+
+	static void Report(OutputBuffer *buf) noexcept;
+
+	// Functions called from the object model
+	static int32_t GetNumCommands(GCodeChannel chan) noexcept;
+	static float GetExecTime(GCodeChannel chan) noexcept;
+	static float GetMaxExecTime(GCodeChannel chan) noexcept;
+	static float GetBlockedTime(GCodeChannel chan) noexcept;
+
+private:
+	static constexpr size_t NumCodeSlots = 64;					// must be a power of 2
+
+	// Statistics for one code on one channel
+	struct CodeStats
+	{
+		uint64_t totalExecTicks;
+		uint64_t totalBlockedTicks;
+		uint32_t numCalls;										// zero if this slot is unused
+		uint32_t maxExecTicks;
+		int16_t number;											// the command number, or -1 if there wasn't one
+		char letter;
+		uint8_t channel;
+	};
+
+	// Statistics for a channel and the state of the command currently being executed on it
+	struct ChannelStats
+	{
+		uint64_t totalExecTicks;
+		uint64_t totalBlockedTicks;
+		uint32_t numCalls;
+		uint32_t maxExecTicks;
+		uint32_t commandStartTicks;								// when we first tried to execute the current command
+		uint32_t commandExecTicks;								// how much time we have spent executing the current command so far
+		int16_t commandNumber;
+		char commandLetter;										// the letter of the current command, or 0 if we are not part way through a command
+	};
+
+	struct ProfileData
+	{
+		ChannelStats channels[NumGCodeChannels];
+		CodeStats codes[NumCodeSlots];
+		uint32_t numDiscarded;									// number of commands not recorded because the code table was full
+	};
+
+	static CodeStats *_ecv_null FindOrCreateSlot(uint8_t channel, char letter, int16_t number) noexcept;
+	static float TicksToSeconds(uint64_t ticks) noexcept;
+
+	// The data is never freed once allocated, so that the object model can read it safely from other tasks
+	static ProfileData *_ecv_null data;
+	static bool enabled;
+};
+
+#endif /* SRC_GCODES_GCODEPROFILER_H_ */
@@ -15,12 +15,9 @@
 
 // GCodeQueue class
 
-GCodeQueue::GCodeQueue() noexcept : freeItems(nullptr), queuedItems(nullptr)
+GCodeQueue::GCodeQueue() noexcept : readOffset(0), writeOffset(0), numQueued(0), maxQueued(0)
 {
-	for (size_t i = 0; i < maxQueuedCodes; i++)
-	{
-		freeItems = new QueuedCode(freeItems);
-	}
+	buffer = reinterpret_cast<char *>(new uint32_t[CodeQueueBufferSize/sizeof(uint32_t)]);
 }
 
 // Return true if the move in the GCodeBuffer should be queued. Caller has already checked that the command does not contain an expression.
@@ -108,66 +105,115 @@ GCodeQueue::GCodeQueue() noexcept : freeItems(nullptr), queuedItems(nullptr)
 
 		if (shouldQueue)
 		{
-			return gb.DataLength() <= BufferSizePerQueueItem;					// only queue it if it is short enough to fit in a queue item
+			return gb.DataLength() <= MaxQueuedCodeLength;						// only queue it if it is short enough
 		}
 	}
 
 	return false;
 }
 
+// If there is no room for a record header at the specified offset, or there is a wrap marker there, return zero; else return the offset
+size_t GCodeQueue::SkipWrapMarker(size_t offset) const noexcept
+{
+	return (offset + sizeof(RecordHeader) > CodeQueueBufferSize || GetHeader(offset)->dataLength == WrapMarker) ? 0 : offset;
+}
+
 // Try to queue the command in the passed GCodeBuffer.
 // If successful, return true to indicate it has been queued.
 // If the queue is full, return false. Caller will wait for space to become available.
 bool GCodeQueue::QueueCode(GCodeBuffer &gb, uint32_t scheduleAt) noexcept
 {
-	// Can we queue this code somewhere?
-	if (freeItems == nullptr)
+	const size_t dataLength = min<size_t>(gb.DataLength(), MaxQueuedCodeLength);
+	const size_t needed = RecordSize(dataLength);
+
+	// Find space for the new record
+	size_t offset;
+	if (numQueued == 0)
+	{
+		readOffset = writeOffset = offset = 0;
+	}
+	else if (writeOffset > readOffset)
+	{
+		if (needed <= CodeQueueBufferSize - writeOffset)
+		{
+			offset = writeOffset;
+		}
+		else if (needed <= readOffset)
+		{
+			// Not enough room at the end, so wrap round to the start
+			if (SkipWrapMarker(writeOffset) != 0)
+			{
+				GetHeader(writeOffset)->dataLength = WrapMarker;
+			}
+			offset = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if (writeOffset < readOffset && needed <= readOffset - writeOffset)
+	{
+		offset = writeOffset;
+	}
+	else
 	{
 		return false;
 	}
 
-	// Unlink a free element and assign gb's code to it
-	QueuedCode * const code = freeItems;
-	freeItems = code->next;
-	code->AssignFrom(gb);
-	code->executeAtMove = scheduleAt;
-	code->next = nullptr;
+	// Store the record
+	RecordHeader * const hdr = GetHeader(offset);
+	hdr->executeAtMove = scheduleAt;
+	hdr->dataLength = dataLength;
+#if HAS_SBC_INTERFACE
+	hdr->isBinary = gb.IsBinary();
+#else
+	hdr->isBinary = false;
+#endif
+	memcpy(buffer + offset + sizeof(RecordHeader), gb.DataStart(), dataLength);
 
-	// Append it to the list of queued codes
-	if (queuedItems == nullptr)
+	// If there is no room for another record header after this one, the next record will start at the beginning
+	writeOffset = offset + needed;
+	if (writeOffset + sizeof(RecordHeader) > CodeQueueBufferSize)
 	{
-		queuedItems = code;
+		writeOffset = 0;
 	}
-	else
+
+	++numQueued;
+	if (numQueued > maxQueued)
 	{
-		QueuedCode *last = queuedItems;
-		while (last->Next() != nullptr)
-		{
-			last = last->Next();
-		}
-		last->next = code;
+		maxQueued = numQueued;
 	}
-
 	return true;
 }
 
 bool GCodeQueue::FillBuffer(GCodeBuffer *gb) noexcept
 {
 	// Can this buffer be filled?
-	if (queuedItems == nullptr || queuedItems->executeAtMove > reprap.GetMove().GetCompletedMoves())
+	if (numQueued == 0 || GetHeader(readOffset)->executeAtMove > reprap.GetMove().GetCompletedMoves())
 	{
 		// No - stop here
 		return false;
 	}
 
 	// Yes - load it into the passed GCodeBuffer instance
-	QueuedCode *code = queuedItems;
-	code->AssignTo(gb);
+	const RecordHeader * const hdr = GetHeader(readOffset);
+	const char *_ecv_array const data = buffer + readOffset + sizeof(RecordHeader);
+#if HAS_SBC_INTERFACE
+	if (hdr->isBinary)
+	{
+		// Note that the data has to remain on a 4-byte boundary for this to work
+		gb->PutBinary(reinterpret_cast<const uint32_t *>(data), hdr->dataLength / sizeof(uint32_t));
+	}
+	else
+#endif
+	{
+		gb->PutAndDecode(data, hdr->dataLength);
+	}
 
-	// Release this item again
-	queuedItems = queuedItems->next;
-	code->next = freeItems;
-	freeItems = code;
+	// Release this record
+	--numQueued;
+	readOffset = (numQueued == 0) ? writeOffset : NextRecord(readOffset);
 	return true;
 }
 
@@ -185,101 +231,56 @@ size_t GCodeQueue::BytesCached() const noexcept
 // Return true if there is nothing to do
 bool GCodeQueue::IsIdle() const noexcept
 {
-	return queuedItems == nullptr || queuedItems->executeAtMove > reprap.GetMove().GetCompletedMoves();
+	return numQueued == 0 || GetHeader(readOffset)->executeAtMove > reprap.GetMove().GetCompletedMoves();
 }
 
 // Because some moves may end before the print is actually paused, we need a method to
-// remove all the entries that will not be executed after the print has finally paused
+// remove all the entries that will not be executed after the print has finally paused.
+// The records are in order of increasing move number, so we keep the ones before the first record that is for a move that has not been scheduled.
 void GCodeQueue::PurgeEntries() noexcept
 {
-	QueuedCode *item = queuedItems, *lastItem = nullptr;
-	while (item != nullptr)
+	const uint32_t scheduledMoves = reprap.GetMove().GetScheduledMoves();
+	size_t offset = readOffset;
+	for (unsigned int i = 0; i < numQueued; ++i)
 	{
-		if (item->executeAtMove > reprap.GetMove().GetScheduledMoves())
+		if (GetHeader(offset)->executeAtMove > scheduledMoves)
 		{
-			// Release this item
-			QueuedCode *nextItem = item->Next();
-			item->next = freeItems;
-			freeItems = item;
-
-			// Unlink it from the list
-			if (lastItem == nullptr)
-			{
-				queuedItems = nextItem;
-			}
-			else
-			{
-				lastItem->next = nextItem;
-			}
-			item = nextItem;
-		}
-		else
-		{
-			lastItem = item;
-			item = item->Next();
+			numQueued = i;
+			writeOffset = offset;
+			break;
 		}
+		offset = NextRecord(offset);
 	}
 }
 
 void GCodeQueue::Clear() noexcept
 {
-	while (queuedItems != nullptr)
-	{
-		QueuedCode * const item = queuedItems;
-		queuedItems = item->Next();
-		item->next = freeItems;
-		freeItems = item;
-	}
+	numQueued = 0;
+	readOffset = writeOffset = 0;
 }
 
 void GCodeQueue::Diagnostics(MessageType mtype) noexcept
 {
-	if (queuedItems == nullptr)
+	const size_t bytesUsed = (numQueued == 0) ? 0
+								: (writeOffset > readOffset) ? writeOffset - readOffset
+									: CodeQueueBufferSize - readOffset + writeOffset;
+	reprap.GetPlatform().MessageF(mtype, "Code queue: %u queued (max %u), %u of %u bytes used\n", numQueued, maxQueued, bytesUsed, CodeQueueBufferSize);
+	maxQueued = numQueued;
+
+	size_t offset = readOffset;
+	for (unsigned int i = 0; i < numQueued; ++i)
 	{
-		reprap.GetPlatform().Message(mtype, "Code queue is empty\n");
-	}
-	else
-	{
-		const QueuedCode *item = queuedItems;
-		do
-		{
+		const RecordHeader * const hdr = GetHeader(offset);
 #if HAS_SBC_INTERFACE
-			// The following may output binary gibberish if this code is stored in binary.
-			// We could restore this message by using GCodeBuffer::AppendFullCommand but there is probably no need to
-			if (!reprap.UsingSbcInterface())
+		// The following may output binary gibberish if this code is stored in binary.
+		// We could restore this message by using GCodeBuffer::AppendFullCommand but there is probably no need to
+		if (!hdr->isBinary)
 #endif
-			{
-				reprap.GetPlatform().MessageF(mtype, "Queued '%.*s' for move %" PRIu32 "\n", item->dataLength, item->data, item->executeAtMove);
-			}
-		} while ((item = item->Next()) != nullptr);
-	}
-}
-
-// QueuedCode class
-
-void QueuedCode::AssignFrom(GCodeBuffer &gb) noexcept
-{
-#if HAS_SBC_INTERFACE
-	isBinary = gb.IsBinary();
-#endif
-	dataLength = min<size_t>(gb.DataLength(), sizeof(data));
-	memcpy(data, gb.DataStart(), dataLength);
-}
-
-void QueuedCode::AssignTo(GCodeBuffer *gb) noexcept
-{
-#if HAS_SBC_INTERFACE
-	if (isBinary)
-	{
-		// Note that the data has to remain on a 4-byte boundary for this to work
-		gb->PutBinary(reinterpret_cast<const uint32_t *>(data), dataLength / sizeof(uint32_t));
-	}
-	else
-#endif
-	{
-		gb->PutAndDecode(data, dataLength);
+		{
+			reprap.GetPlatform().MessageF(mtype, "Queued '%.*s' for move %" PRIu32 "\n", (int)hdr->dataLength, buffer + offset + sizeof(RecordHeader), hdr->executeAtMove);
+		}
+		offset = NextRecord(offset);
 	}
 }
 
 // End
-
@@ -10,10 +10,9 @@
 #include "RepRapFirmware.h"
 #include "GCodeInput.h"
 
-class QueuedCode;
-
-const size_t BufferSizePerQueueItem = ShortGCodeLength;
-
+// The queue is a ring buffer of variable-length records. Each record comprises a header followed by the command data padded to a multiple of 4 bytes.
+// A header with dataLength == WrapMarker means that the remainder of the buffer is unused and the next record starts at the beginning.
+// Records are always added in order of increasing move number, because the number of scheduled moves never decreases.
 class GCodeQueue : public GCodeInput
 {
 public:
@@ -33,33 +32,32 @@ public:
 	static bool ShouldQueueCode(GCodeBuffer &gb) THROWS(GCodeException);	// Return true if this code should be queued
 
 private:
-	QueuedCode *freeItems;
-	QueuedCode *queuedItems;
-};
-
-class QueuedCode
-{
-public:
-	friend class GCodeQueue;
-
-	QueuedCode(QueuedCode *n) noexcept : next(n), dataLength(0) { }
-	QueuedCode *Next() const noexcept { return next; }
-
-private:
-	QueuedCode *next;
-
-#if HAS_SBC_INTERFACE
-	bool isBinary;
-	alignas(4) char data[BufferSizePerQueueItem];
-#else
-	char data[BufferSizePerQueueItem];
-#endif
-	size_t dataLength;
-
-	uint32_t executeAtMove;
-
-	void AssignFrom(GCodeBuffer &gb) noexcept;
-	void AssignTo(GCodeBuffer *gb) noexcept;
+	struct RecordHeader
+	{
+		uint32_t executeAtMove;
+		uint16_t dataLength;
+		uint8_t isBinary;
+		uint8_t spare;
+	};
+
+	static constexpr uint16_t WrapMarker = 0xFFFF;
+	static constexpr size_t MaxQueuedCodeLength = MaxGCodeLength;
+
+	static_assert(sizeof(RecordHeader) == 8);
+	static_assert(CodeQueueBufferSize % 4 == 0);
+	static_assert(CodeQueueBufferSize >= 2 * (sizeof(RecordHeader) + ((MaxQueuedCodeLength + 3) & ~3u)));	// we must be able to queue at least two codes of maximum length
+
+	static constexpr size_t RecordSize(size_t dataLength) noexcept { return sizeof(RecordHeader) + ((dataLength + 3) & ~3u); }
+
+	RecordHeader *GetHeader(size_t offset) const noexcept { return reinterpret_cast<RecordHeader *>(buffer + offset); }
+	size_t SkipWrapMarker(size_t offset) const noexcept;
+	size_t NextRecord(size_t offset) const noexcept { return SkipWrapMarker(offset + RecordSize(GetHeader(offset)->dataLength)); }
+
+	char *_ecv_array buffer;											// 4-byte aligned storage for the records
+	size_t readOffset;													// offset of the oldest record
+	size_t writeOffset;													// offset at which to store the next record
+	unsigned int numQueued;												// number of records in the queue
+	unsigned int maxQueued;												// the maximum number of records that have been queued
 };
 
 #endif
@@ -353,6 +353,7 @@ private:
 	void FileMacroCyclesReturn(GCodeBuffer& gb) noexcept;								// End a macro
 
 	bool ActOnCode(GCodeBuffer& gb, const StringRef& reply) noexcept;					// Do a G, M or T Code
+	bool DoActOnCode(GCodeBuffer& gb, const StringRef& reply) noexcept;					// Do a G, M or T Code without profiling it
 	bool HandleGcode(GCodeBuffer& gb, const StringRef& reply) THROWS(GCodeException);	// Do a G code
 	bool HandleMcode(GCodeBuffer& gb, const StringRef& reply) THROWS(GCodeException);	// Do an M code
 	bool HandleTcode(GCodeBuffer& gb, const StringRef& reply) THROWS(GCodeException);	// Do a T code
@@ -11,11 +11,13 @@
 #include "GCodeBuffer/GCodeBuffer.h"
 #include "GCodeException.h"
 #include "GCodeQueue.h"
+#include "GCodeProfiler.h"
 #include "Heating/Heat.h"
 #if HAS_SBC_INTERFACE
 # include <SBC/SbcInterface.h>
 #endif
 #include <Movement/Move.h>
+#include <Movement/StepTimer.h>
 #include <Networking/Network.h>
 #include <Platform/Scanner.h>
 #include <PrintMonitor/PrintMonitor.h>
@@ -65,6 +67,18 @@
 // If the code to act on is completed, this returns true, otherwise false.
 // It is called repeatedly for a given code until it returns true for that code.
 bool GCodes::ActOnCode(GCodeBuffer& gb, const StringRef& reply) noexcept
+{
+	if (GCodeProfiler::IsEnabled())
+	{
+		const uint32_t startTicks = StepTimer::GetTimerTicks();
+		const bool finished = DoActOnCode(gb, reply);
+		GCodeProfiler::CommandAttempted(gb, startTicks, StepTimer::GetTimerTicks(), finished);
+		return finished;
+	}
+	return DoActOnCode(gb, reply);
+}
+
+bool GCodes::DoActOnCode(GCodeBuffer& gb, const StringRef& reply) noexcept
 {
 	try
 	{
@@ -1940,6 +1954,40 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, const StringRef& reply) THROWS(GCodeEx
 				}
 				break;
 
+			case 123: // G-code profiler
+				{
+					bool seen = false;
+					if (gb.Seen('S'))
+					{
+						seen = true;
+						if (gb.GetUIValue() != 0)
+						{
+							GCodeProfiler::Enable();
+						}
+						else
+						{
+							GCodeProfiler::Disable();
+						}
+					}
+					if (gb.Seen('R'))
+					{
+						seen = true;
+						if (gb.GetUIValue() != 0)
+						{
+							GCodeProfiler::Reset();
+						}
+					}
+					if (!seen)
+					{
+						if (!OutputBuffer::Allocate(outBuf))
+						{
+							return false;												// cannot allocate an output buffer, try again later
+						}
+						GCodeProfiler::Report(outBuf);
+					}
+				}
+				break;
+
 			// M135 (set PID sample interval) is no longer supported
 
 			case 140: // Bed temperature
@@ -2885,13 +2933,45 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, const StringRef& reply) THROWS(GCodeEx
 					{
 						lastAuxStatusReportType = ObjectModelAuxStatusReportType;
 					}
-					outBuf = reprap.GetModelResponse(&gb, key.c_str(), flags.c_str());
+
+					// Large reports to channels that take plain text are generated in chunks, so that each call does a limited amount of work.
+					// We send each chunk as soon as we have generated it and hold back other messages to the channel until the report is complete, so that they can't get between the chunks.
+					JsonResumePoint& resumePoint = gb.GetModelResumePoint();
+					if (!gb.LatestMachineState().commandRepeated)
+					{
+						gb.FinishModelResponse();
+					}
+#if HAS_SBC_INTERFACE
+					const bool canGenerateInChunks = !gb.IsBinary() && &gb != auxGCode && gb.StartModelResponse();
+#else
+					const bool canGenerateInChunks = (&gb != auxGCode) && gb.StartModelResponse();
+#endif
+					try
+					{
+						outBuf = reprap.GetModelResponseChunk(&gb, key.c_str(), flags.c_str(), resumePoint, (canGenerateInChunks) ? ModelResponseChunkSize : 0);
+					}
+					catch (const GCodeException&)
+					{
+						gb.FinishModelResponse();
+						throw;
+					}
 					if (outBuf == nullptr)
 					{
-						OutputBuffer::ReleaseAll(outBuf);
 						// We don't delay and retry here, in case the user asked for too much of the object model in one go for the output buffers to contain it
+						gb.FinishModelResponse();
 						reply.copy("{\"err\":-1}\n");
 					}
+					else if (canGenerateInChunks)
+					{
+						gb.SendModelResponseChunk(outBuf);
+						outBuf = nullptr;
+						if (resumePoint.IsSuspended())
+						{
+							result = GCodeResult::notFinished;
+							break;
+						}
+						gb.FinishModelResponse();
+					}
 					if (&gb == auxGCode)
 					{
 						gb.ResetReportDueTimer();
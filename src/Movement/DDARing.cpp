@@ -446,6 +446,34 @@ bool DDARing::IsIdle() const noexcept
 	return currentDda == nullptr && getPointer->GetState() == DDA::empty;
 }
 
+// Return the approximate time in milliseconds needed to execute the moves in the ring.
+// This is called by other tasks, so the states of the moves may change while we are looking at them. The result only needs to be approximate.
+uint32_t DDARing::GetQueuedMoveTime() const noexcept
+{
+	// When the ring is full, addPointer == getPointer, so we stop at the first empty DDA or when we get back to where we started
+	uint32_t clocks = 0;
+	const DDA * const startPointer = getPointer;
+	const DDA *dda = startPointer;
+	do
+	{
+		const DDA::DDAState st = dda->GetState();
+		if (st == DDA::empty)
+		{
+			break;
+		}
+		if (st != DDA::completed)
+		{
+			const int32_t timeLeft = (st == DDA::executing) ? dda->GetTimeLeft() : (int32_t)dda->GetClocksNeeded();
+			if (timeLeft > 0)
+			{
+				clocks += (uint32_t)timeLeft;
+			}
+		}
+		dda = dda->GetNext();
+	} while (dda != startPointer);
+	return clocks/(StepClockRate/1000);
+}
+
 // Try to push some babystepping through the lookahead queue, returning the amount pushed
 // Caution! Thus is called with scheduling locked, therefore it must make no FreeRTOS calls, or call anything that makes them
 float DDARing::PushBabyStepping(size_t axis, float amount) noexcept
@@ -43,6 +43,7 @@ public:
 	uint32_t ExtruderPrintingSince() const noexcept { return extrudersPrintingSince; }	// When we started doing normal moves after the most recent extruder-only move
 	int32_t GetAccumulatedMovement(size_t drive, bool& isPrinting) noexcept;
 
+	uint32_t GetQueuedMoveTime() const noexcept;										// Return the approximate time in ms needed to execute the moves in the ring
 	uint32_t GetScheduledMoves() const noexcept { return scheduledMoves; }				// How many moves have been scheduled?
 	uint32_t GetCompletedMoves() const noexcept { return completedMoves; }				// How many moves have been completed?
 	void ResetMoveCounters() noexcept { scheduledMoves = completedMoves = 0; }
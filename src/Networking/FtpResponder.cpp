@@ -15,7 +15,8 @@
 #include <Platform/Platform.h>
 
 FtpResponder::FtpResponder(NetworkResponder *n) noexcept
-	: UploadingNetworkResponder(n), dataSocket(nullptr), passivePort(0), passivePortOpenTime(0), dataBuf(nullptr), haveFileToMove(false)
+	: UploadingNetworkResponder(n), dataSocket(nullptr), passivePort(0), passivePortOpenTime(0), dataBuf(nullptr),
+	  restartOffset(0), transferStartTime(0), transferBytes(0), haveFileToMove(false)
 {
 }
 
@@ -128,7 +129,10 @@ bool FtpResponder::Spin() noexcept
 				}
 				else
 				{
-					outBuf->copy("226 Transfer complete.\r\n");
+					// Report the throughput so that slow transfers can be diagnosed
+					const uint32_t transferTime = millis() - transferStartTime;
+					outBuf->printf("226 Transfer complete, %" PRIu32 " bytes in %.1fs (%.1fKb/s).\r\n",
+									transferBytes, (double)((float)transferTime * 0.001), (double)((float)transferBytes/(float)max<uint32_t>(transferTime, 1) * (1000.0/1024.0)));
 				}
 				Commit(ResponderState::reading);
 				CloseDataPort();
@@ -259,6 +263,7 @@ void FtpResponder::SendPassiveData() noexcept
 
 			// Tell the output buffer how much data we have taken
 			dataBuf->Taken(sent);
+			transferBytes += sent;
 			if (sent < bytesLeft)
 			{
 				return;
@@ -328,6 +333,7 @@ void FtpResponder::SendPassiveData() noexcept
 			}
 
 			fileBuffer->Taken(sent);
+			transferBytes += sent;
 			if (sent < remaining)
 			{
 				return;
@@ -357,6 +363,7 @@ void FtpResponder::DoUpload() noexcept
 		}
 
 		dataSocket->Taken(len);
+		transferBytes += len;
 		if (!fileBeingUploaded.Write(buffer, len))
 		{
 			uploadError = true;
@@ -501,6 +508,9 @@ void FtpResponder::ProcessLine() noexcept
 		{
 			outBuf->copy(	"211-Features:\r\n"
 							"PASV\r\n"			// support PASV mode
+							"SIZE\r\n"			// support file size requests
+							"REST STREAM\r\n"	// support resuming downloads and uploads
+							"MLST type*;size*;\r\n"		// support machine-readable listings
 							"211 End\r\n"
 						);
 			Commit(ResponderState::reading);
@@ -563,8 +573,19 @@ void FtpResponder::ProcessLine() noexcept
 					passivePort / 256, passivePort % 256);
 			Commit(ResponderState::waitingForPasvPort);
 		}
+		// set the offset for the next transfer
+		else if (StringStartsWith(clientMessage, "REST"))
+		{
+			ProcessRest(ResponderState::reading);
+		}
+		// get the size of a file
+		else if (StringStartsWith(clientMessage, "SIZE"))
+		{
+			ProcessSize(ResponderState::reading);
+		}
 		// PASV commands are not supported in this state
-		else if (StringStartsWith(clientMessage, "LIST") || StringStartsWith(clientMessage, "RETR") || StringStartsWith(clientMessage, "STOR"))
+		else if (   StringStartsWith(clientMessage, "LIST") || StringStartsWith(clientMessage, "MLSD")
+				 || StringStartsWith(clientMessage, "RETR") || StringStartsWith(clientMessage, "STOR"))
 		{
 			outBuf->copy("425 Use PASV first.\r\n");
 			Commit(ResponderState::reading);
@@ -675,6 +696,7 @@ void FtpResponder::ProcessLine() noexcept
 			// send announcement via ftp main port
 			outBuf->copy("150 Here comes the directory listing.\r\n");
 			Commit(ResponderState::sendingPasvData);
+			StartTransfer();
 
 			// build directory listing, dataBuf is sent later in the Spin loop
 			FileInfo fileInfo;
@@ -692,6 +714,33 @@ void FtpResponder::ProcessLine() noexcept
 				} while (MassStorage::FindNext(fileInfo));
 			}
 		}
+		// list directory entries in machine-readable form
+		else if (StringStartsWith(clientMessage, "MLSD"))
+		{
+			outBuf->copy("150 Here comes the directory listing.\r\n");
+			Commit(ResponderState::sendingPasvData);
+			StartTransfer();
+
+			FileInfo fileInfo;
+			if (MassStorage::FindFirst(currentDirectory.c_str(), fileInfo))
+			{
+				do {
+					// Example: "type=file;size=1234; file.gcode\r\n"
+					// We don't send the modify fact, because it must be in UTC but our file times are local times and we don't know the time zone
+					dataBuf->catf("type=%s;size=%lu; %s\r\n", (fileInfo.isDirectory) ? "dir" : "file", fileInfo.size, fileInfo.fileName.c_str());
+				} while (MassStorage::FindNext(fileInfo));
+			}
+		}
+		// set the offset for the next transfer
+		else if (StringStartsWith(clientMessage, "REST"))
+		{
+			ProcessRest(ResponderState::pasvPortOpened);
+		}
+		// get the size of a file
+		else if (StringStartsWith(clientMessage, "SIZE"))
+		{
+			ProcessSize(ResponderState::pasvPortOpened);
+		}
 		// switch transfer mode (sends response, but doesn't have any effects)
 		else if (StringStartsWith(clientMessage, "TYPE"))
 		{
@@ -718,37 +767,49 @@ void FtpResponder::ProcessLine() noexcept
 			filenameBeingProcessed.Clear();
 
 			const char * const filename = GetParameter("STOR");
-			if (StartUpload(currentDirectory.c_str(), filename, OpenMode::write))
+			if ((restartOffset == 0) ? StartUpload(currentDirectory.c_str(), filename, OpenMode::write) : ResumeUpload(filename))
 			{
 				outBuf->copy("150 OK to send data.\r\n");
 				Commit(ResponderState::uploading);
+				StartTransfer();
 			}
 			else
 			{
 				outBuf->copy("550 Failed to open file.\r\n");
 				Commit(ResponderState::reading);
 			}
+			restartOffset = 0;
 		}
 		// download a file
 		else if (StringStartsWith(clientMessage, "RETR"))
 		{
 			const char * const filename = GetParameter("RETR");
 			fileBeingSent = GetPlatform().OpenFile(currentDirectory.c_str(), filename, OpenMode::read);
-			if (fileBeingSent != nullptr)
+			if (fileBeingSent != nullptr && restartOffset != 0 && (restartOffset > fileBeingSent->Length() || !fileBeingSent->Seek(restartOffset)))
 			{
-				outBuf->printf("150 Opening data connection for %s (%lu bytes).\r\n", filename, fileBeingSent->Length());
+				fileBeingSent->Close();
+				fileBeingSent = nullptr;
+				outBuf->copy("554 Invalid restart offset.\r\n");
+				Commit(ResponderState::reading);
+			}
+			else if (fileBeingSent != nullptr)
+			{
+				outBuf->printf("150 Opening data connection for %s (%lu bytes).\r\n", filename, fileBeingSent->Length() - restartOffset);
 				Commit(ResponderState::sendingPasvData);
+				StartTransfer();
 			}
 			else
 			{
 				outBuf->copy("550 Failed to open file.\r\n");
 				Commit(ResponderState::reading);
 			}
+			restartOffset = 0;
 		}
 		// abort current operation
 		else if (StringEqualsIgnoreCase(clientMessage, "ABOR"))
 		{
 			CloseDataPort();
+			restartOffset = 0;
 
 			outBuf->copy("226 ABOR successful.\r\n");
 			Commit(ResponderState::reading);
@@ -883,6 +944,97 @@ void FtpResponder::ChangeDirectory(const char *newDirectory) noexcept
 	}
 }
 
+// Process a REST command, which sets the offset at which the next RETR or STOR command starts
+void FtpResponder::ProcessRest(ResponderState nextState) noexcept
+{
+	const char *param = GetParameter("REST");
+	const char *endPtr;
+	const uint32_t offset = StrToU32(param, &endPtr);
+	if (endPtr != param && *endPtr == 0)
+	{
+		restartOffset = offset;
+		outBuf->printf("350 Restarting at %lu. Send STOR or RETR.\r\n", restartOffset);
+	}
+	else
+	{
+		outBuf->copy("501 Invalid restart offset.\r\n");
+	}
+	Commit(nextState);
+}
+
+// Process a SIZE command
+void FtpResponder::ProcessSize(ResponderState nextState) noexcept
+{
+	// If an upload of this file was cancelled then the data received so far is in the temporary upload file, so report the length of that
+	// so that the client knows where to resume the upload from
+	const char * const filename = GetParameter("SIZE");
+	String<MaxFilenameLength> partFilename;
+	FileStore *f = nullptr;
+	if (!partFilename.copy(filename) && !partFilename.cat(UPLOAD_EXTENSION) && GetPlatform().FileExists(currentDirectory.c_str(), partFilename.c_str()))
+	{
+		f = GetPlatform().OpenFile(currentDirectory.c_str(), partFilename.c_str(), OpenMode::read);
+	}
+	if (f == nullptr)
+	{
+		f = GetPlatform().OpenFile(currentDirectory.c_str(), filename, OpenMode::read);
+	}
+	if (f != nullptr)
+	{
+		outBuf->printf("213 %lu\r\n", f->Length());
+		f->Close();
+	}
+	else
+	{
+		outBuf->copy("550 Could not get file size.\r\n");
+	}
+	Commit(nextState);
+}
+
+// Resume an upload at restartOffset. The data received so far is in the temporary upload file left by the cancelled upload,
+// which must be at least restartOffset bytes long. Anything beyond restartOffset is discarded and the usual upload completion handling applies.
+bool FtpResponder::ResumeUpload(const char *filename) noexcept
+{
+	if (   !MassStorage::CombineName(filenameBeingProcessed.GetRef(), currentDirectory.c_str(), filename)
+		|| filenameBeingProcessed.cat(UPLOAD_EXTENSION)
+	   )
+	{
+		filenameBeingProcessed.Clear();
+		return false;
+	}
+
+	FileStore * const file = GetPlatform().OpenFile(currentDirectory.c_str(), filenameBeingProcessed.c_str(), OpenMode::append);
+	if (file == nullptr || file->Length() < restartOffset || !file->Seek(restartOffset) || !file->Truncate())
+	{
+		if (file != nullptr)
+		{
+			file->Close();
+		}
+		filenameBeingProcessed.Clear();
+		return false;
+	}
+
+	fileBeingUploaded.Set(file);
+	dummyUpload = false;
+	uploadError = false;
+	responderState = ResponderState::uploading;
+	return true;
+}
+
+// If the upload was not completed then keep what we received in the temporary upload file, so that the client can resume the upload using REST.
+// The target file is left alone until an upload completes.
+void FtpResponder::CancelUpload() noexcept
+{
+	if (fileBeingUploaded.IsLive() && !uploadError && !filenameBeingProcessed.IsEmpty())
+	{
+		fileBeingUploaded.Close();
+		filenameBeingProcessed.Clear();
+	}
+	else
+	{
+		UploadingNetworkResponder::CancelUpload();
+	}
+}
+
 void FtpResponder::CloseDataPort() noexcept
 {
 	if (reprap.Debug(moduleWebserver))
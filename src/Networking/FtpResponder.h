@@ -26,6 +26,7 @@ public:
 
 protected:
 	void ConnectionLost() noexcept override;
+	void CancelUpload() noexcept override;
 	void SendData() noexcept override;
 	void SendPassiveData() noexcept;
 	void DoUpload() noexcept;
@@ -35,6 +36,10 @@ protected:
 	const char *GetParameter(const char *after) const noexcept;	// return the parameter followed by whitespaces after a command
 	void ChangeDirectory(const char *newDirectory) noexcept;
 	void CloseDataPort() noexcept;
+	void ProcessRest(ResponderState nextState) noexcept;
+	void ProcessSize(ResponderState nextState) noexcept;
+	bool ResumeUpload(const char *filename) noexcept;
+	void StartTransfer() noexcept { transferStartTime = millis(); transferBytes = 0; }
 
 	static const size_t ftpMessageLength = 128;			// maximum line length for incoming FTP commands
 	static const uint32_t ftpPasvPortTimeout = 10000;	// maximum time to wait for an FTP data connection in milliseconds
@@ -43,6 +48,9 @@ protected:
 	TcpPort passivePort;
 	uint32_t passivePortOpenTime;
 	OutputBuffer *dataBuf;
+	FilePosition restartOffset;							// the offset given in the last REST command, used by the next RETR or STOR command
+	uint32_t transferStartTime;
+	uint32_t transferBytes;								// how many bytes the current or last data transfer sent or received
 
 	bool sendError;
 	bool haveCompleteLine;
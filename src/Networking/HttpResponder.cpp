@@ -13,6 +13,7 @@
 #include "Socket.h"
 #include "GCodes/GCodes.h"
 #include "General/IP4String.h"
+#include "WebFileCache.h"
 
 #define KO_START "rr_"
 const size_t KoFirst = 3;
@@ -20,9 +21,17 @@ const size_t KoFirst = 3;
 const char* const overflowResponse = "overflow";
 const char* const badEscapeResponse = "bad escape";
 const char serviceUnavailableResponse[] = "HTTP/1.1 503 Service Unavailable\r\n\r\n";
-static_assert(ARRAY_SIZE(serviceUnavailableResponse) <= OUTPUT_BUFFER_SIZE, "OUTPUT_BUFFER_SIZE too small");
+static_assert(ARRAY_SIZE(serviceUnavailableResponse) <= OUTPUT_BUFFER_SMALL_SIZE, "OUTPUT_BUFFER_SMALL_SIZE too small");		// a new OutputBuffer is a small one
 
-const uint32_t HttpReceiveTimeout = 2000;
+const uint32_t HttpReceiveTimeout = 2000;					// this is also how long we keep an idle persistent connection open
+
+// Always leave at least one responder free to accept new connections, so that clients that keep their connections open can't lock out other clients
+const unsigned int MaxPersistentConnections = NumHttpResponders - 1;
+
+#if SUPPORT_OBJECT_MODEL
+// Event streams stay open indefinitely, so limit them to half the responders. They also count as persistent connections.
+const unsigned int MaxEventStreams = NumHttpResponders/2;
+#endif
 
 // Text for a human-readable 404 page
 const char* const ErrorPagePart1 =
@@ -36,7 +45,10 @@ const char* const ErrorPagePart2 =
 	"</p>\n"
 	"</body>\n";
 
-HttpResponder::HttpResponder(NetworkResponder *n) noexcept : UploadingNetworkResponder(n)
+HttpResponder::HttpResponder(NetworkResponder *n) noexcept : UploadingNetworkResponder(n), downloadLength(0), requestsOnConnection(0), isPersistent(false)
+#if SUPPORT_OBJECT_MODEL
+	, isEventStream(false)
+#endif
 {
 }
 
@@ -48,14 +60,8 @@ bool HttpResponder::Accept(Socket *s, NetworkProtocol protocol) noexcept
 		responderState = ResponderState::reading;
 		skt = s;
 		timer = millis();
-
-		// Reset the parse state variables
-		clientPointer = 0;
-		parseState = HttpParseState::doingCommandWord;
-		numCommandWords = 0;
-		numQualKeys = 0;
-		numHeaderKeys = 0;
-		commandWords[0] = clientMessage;
+		requestsOnConnection = 0;
+		ResetParser();
 
 		if (reprap.Debug(moduleWebserver))
 		{
@@ -66,6 +72,20 @@ bool HttpResponder::Accept(Socket *s, NetworkProtocol protocol) noexcept
 	return false;
 }
 
+// Reset the parse state variables ready to receive a new request
+void HttpResponder::ResetParser() noexcept
+{
+	clientPointer = 0;
+#if SUPPORT_OBJECT_MODEL
+	modelResumePoint.Reset();
+#endif
+	parseState = HttpParseState::doingCommandWord;
+	numCommandWords = 0;
+	numQualKeys = 0;
+	numHeaderKeys = 0;
+	commandWords[0] = clientMessage;
+}
+
 // Do some work, returning true if we did anything significant
 bool HttpResponder::Spin() noexcept
 {
@@ -97,7 +117,18 @@ bool HttpResponder::Spin() noexcept
 
 			if (!skt->CanRead() || millis() - timer >= HttpReceiveTimeout)
 			{
-				ConnectionLost();
+				if (requestsOnConnection != 0 && clientPointer == 0 && skt->CanRead())
+				{
+					// A persistent connection has been idle for too long, so close it tidily
+					skt->Close();
+					skt = nullptr;
+					responderState = ResponderState::free;
+					ReleasePersistentConnection();
+				}
+				else
+				{
+					ConnectionLost();
+				}
 				return true;
 			}
 
@@ -122,6 +153,11 @@ bool HttpResponder::Spin() noexcept
 		SendData();
 		return true;
 
+#if SUPPORT_OBJECT_MODEL
+	case ResponderState::streamingEvents:
+		return SendEvents();
+#endif
+
 	default:	// should not happen
 		return false;
 	}
@@ -453,7 +489,7 @@ bool HttpResponder::CharFromClient(char c) noexcept
 // This may also return true with response == nullptr if we tried to generate a response but ran out of buffers.
 bool HttpResponder::GetJsonResponse(const char *_ecv_array request, OutputBuffer *&response, bool& keepOpen) noexcept
 {
-	keepOpen = false;	// assume we don't want to persist the connection
+	keepOpen = true;	// assume we can persist the connection if the client wants to
 	const char *parameter;
 	if (StringEqualsIgnoreCase(request, "connect") && (parameter = GetKeyValue("password")) != nullptr)
 	{
@@ -542,10 +578,15 @@ bool HttpResponder::GetJsonResponse(const char *_ecv_array request, OutputBuffer
 	else if (StringEqualsIgnoreCase(request, "upload"))
 	{
 		response->printf("{\"err\":%d}", (uploadError) ? 1 : 0);
+		keepOpen = !uploadError;		// if the upload failed then we may not have read all the data, so close the connection
 	}
 	else if (StringEqualsIgnoreCase(request, "delete") && (parameter = GetKeyValue("name")) != nullptr)
 	{
 		const bool ok = MassStorage::Delete(parameter, false);
+		if (ok)
+		{
+			WebFileCache::Invalidate();					// we may have deleted a web file
+		}
 		response->printf("{\"err\":%d}", (ok) ? 0 : 1);
 	}
 	else if (StringEqualsIgnoreCase(request, "filelist") && (parameter = GetKeyValue("dir")) != nullptr)
@@ -578,6 +619,10 @@ bool HttpResponder::GetJsonResponse(const char *_ecv_array request, OutputBuffer
 		{
 			const bool deleteExisting = StringEqualsIgnoreCase(GetKeyValue("deleteexisting"), "yes");
 			success = MassStorage::Rename(oldVal, newVal, deleteExisting, false);
+			if (success)
+			{
+				WebFileCache::Invalidate();				// we may have moved or replaced a web file
+			}
 		}
 		response->printf("{\"err\":%d}", (success) ? 0 : 1);
 	}
@@ -641,7 +686,29 @@ bool HttpResponder::GetJsonResponse(const char *_ecv_array request, OutputBuffer
 		OutputBuffer::ReleaseAll(response);
 		const char *const filterVal = GetKeyValue("key");
 		const char *const flagsVal = GetKeyValue("flags");
-		response = reprap.GetModelResponse(nullptr, filterVal, flagsVal);
+		const char *const seqsVal = GetKeyValue("seqs");
+		modelResumePoint.Reset();
+		try
+		{
+			// Generate the first chunk of the response. If that isn't the whole response, we generate the rest as the client accepts the data.
+			modelSeqs = (seqsVal != nullptr && (filterVal == nullptr || filterVal[0] == 0)) ? seqsVal : nullptr;
+			if (modelSeqs != nullptr)
+			{
+				response = reprap.GetModelPatchResponseChunk(nullptr, flagsVal, modelSeqs, modelResumePoint, ModelResponseChunkSize);	// the client wants only the changes since the sequence numbers it last saw
+			}
+			else
+			{
+				response = reprap.GetModelResponseChunk(nullptr, filterVal, flagsVal, modelResumePoint, ModelResponseChunkSize);
+			}
+			modelKey = filterVal;
+			modelFlags = flagsVal;
+		}
+		catch (const GCodeException&)
+		{
+			modelResumePoint.Reset();
+			RejectMessage("invalid object model request", 400);
+			return false;
+		}
 	}
 #endif
 	else if (StringEqualsIgnoreCase(request, "config"))
@@ -670,6 +737,18 @@ const char* HttpResponder::GetKeyValue(const char *key) const noexcept
 	return nullptr;
 }
 
+const char* HttpResponder::GetHeaderValue(const char *key) const noexcept
+{
+	for (size_t i = 0; i < numHeaderKeys; ++i)
+	{
+		if (StringEqualsIgnoreCase(headers[i].key, key))
+		{
+			return headers[i].value;
+		}
+	}
+	return nullptr;
+}
+
 // Called to process a FileInfo request, which may take several calls
 // Return true if complete
 bool HttpResponder::SendFileInfo(bool quitEarly) noexcept
@@ -687,7 +766,8 @@ bool HttpResponder::SendFileInfo(bool quitEarly) noexcept
 					);
 		outBuf->catf("Content-Length: %u\r\n", (jsonResponse != nullptr) ? jsonResponse->Length() : 0);
 		AddCorsHeader();
-		outBuf->cat("Connection: close\r\n\r\n");
+		const bool keepOpen = WantKeepAlive();
+		AddConnectionHeaders(keepOpen);
 		outBuf->Append(jsonResponse);
 		if (outBuf->HadOverflow())
 		{
@@ -698,7 +778,7 @@ bool HttpResponder::SendFileInfo(bool quitEarly) noexcept
 		else
 		{
 			filenameBeingProcessed.Clear();
-			Commit();
+			CommitResponse(keepOpen);
 		}
 	}
 	return gotFileInfo;
@@ -776,6 +856,7 @@ void HttpResponder::SendFile(const char *_ecv_array nameOfFileToSend, bool isWeb
 #if HAS_MASS_STORAGE
 	FileStore *fileToSend = nullptr;
 	bool zip = false;
+	const WebFileCache::Entry *_ecv_null cacheEntry = nullptr;
 
 	if (isWebFile)
 	{
@@ -793,9 +874,44 @@ void HttpResponder::SendFile(const char *_ecv_array nameOfFileToSend, bool isWeb
 		// Check that the length of the filename requested is short enough for CombineName not to generate an error message before we try to open it.
 		// We used to report a possible virus attack in this case, but that sometimes leads to false warnings because of OCSP requests from AV programs,
 		// or file download requests after IP address changes
+		const char *_ecv_array const requestedName = nameOfFileToSend;
 		if (strlen(nameOfFileToSend) <= MaxExpectedWebDirFilenameLength)
 		{
-			for (;;)
+			// See whether we served this file recently, in which case we know which file to open and the client may already have the current version
+			cacheEntry = WebFileCache::Find(requestedName);
+			if (cacheEntry != nullptr)
+			{
+				if (ClientHasCurrentVersion(cacheEntry->etag))
+				{
+					SendNotModified(cacheEntry->fileName, cacheEntry->etag);
+					return;
+				}
+
+				if (cacheEntry->zip)
+				{
+					String<MaxFilenameLength> nameBuf;
+					nameBuf.copy(cacheEntry->fileName);
+					nameBuf.cat(".gz");
+					fileToSend = GetPlatform().OpenFile(Platform::GetWebDir(), nameBuf.c_str(), OpenMode::read);
+				}
+				else
+				{
+					fileToSend = GetPlatform().OpenFile(Platform::GetWebDir(), cacheEntry->fileName, OpenMode::read);
+				}
+
+				if (fileToSend == nullptr)
+				{
+					WebFileCache::Remove(cacheEntry);					// the file has gone, so look for it again
+					cacheEntry = nullptr;
+				}
+				else
+				{
+					nameOfFileToSend = cacheEntry->fileName;
+					zip = cacheEntry->zip;
+				}
+			}
+
+			while (fileToSend == nullptr)
 			{
 				// Try to open a gzipped version of the file first
 				if (!StringEndsWithIgnoreCase(nameOfFileToSend, ".gz"))
@@ -832,6 +948,17 @@ void HttpResponder::SendFile(const char *_ecv_array nameOfFileToSend, bool isWeb
 					break;
 				}
 			}
+
+			if (fileToSend != nullptr && cacheEntry == nullptr)
+			{
+				cacheEntry = WebFileCache::Add(requestedName, nameOfFileToSend, fileToSend->Length(), zip);
+				if (cacheEntry != nullptr && ClientHasCurrentVersion(cacheEntry->etag))
+				{
+					fileToSend->Close();
+					SendNotModified(nameOfFileToSend, cacheEntry->etag);
+					return;
+				}
+			}
 		}
 
 		// If we still couldn't find the file and it was an HTML file, return the 404 error page
@@ -858,6 +985,8 @@ void HttpResponder::SendFile(const char *_ecv_array nameOfFileToSend, bool isWeb
 	}
 
 	fileBeingSent = fileToSend;
+	transferStartTime = millis();
+	downloadLength = fileToSend->Length();
 	outBuf->copy("HTTP/1.1 200 OK\r\n");
 
 	// Don't cache files served by rr_download
@@ -869,6 +998,10 @@ void HttpResponder::SendFile(const char *_ecv_array nameOfFileToSend, bool isWeb
 					);
 		AddCorsHeader();
 	}
+	else if (cacheEntry != nullptr)
+	{
+		AddWebCacheHeaders(nameOfFileToSend, cacheEntry->etag);
+	}
 
 	const char* contentType;
 	if (StringEndsWithIgnoreCase(nameOfFileToSend, ".png"))
@@ -912,8 +1045,9 @@ void HttpResponder::SendFile(const char *_ecv_array nameOfFileToSend, bool isWeb
 	}
 
 	outBuf->catf("Content-Length: %lu\r\n", fileToSend->Length());
-	outBuf->cat("Connection: close\r\n\r\n");
-	Commit();
+	const bool keepOpen = WantKeepAlive();
+	AddConnectionHeaders(keepOpen);
+	CommitResponse(keepOpen);
 #else
 	RejectMessage("file not found", 404);
 #endif
@@ -921,6 +1055,7 @@ void HttpResponder::SendFile(const char *_ecv_array nameOfFileToSend, bool isWeb
 
 void HttpResponder::SendGCodeReply() noexcept
 {
+	bool keepOpen;
 	{
 		// Do we need to keep the G-Code reply for other clients?
 		bool clearReply = false;
@@ -956,7 +1091,8 @@ void HttpResponder::SendGCodeReply() noexcept
 					);
 		outBuf->catf("Content-Length: %u\r\n", gcodeReply.DataLength());
 		AddCorsHeader();
-		outBuf->cat("Connection: close\r\n\r\n");
+		keepOpen = WantKeepAlive();
+		AddConnectionHeaders(keepOpen);
 		outStack.Append(gcodeReply);
 
 		// Possibly clean up the G-code reply once again
@@ -966,7 +1102,7 @@ void HttpResponder::SendGCodeReply() noexcept
 		}
 	}
 
-	Commit();
+	CommitResponse(keepOpen);
 }
 
 // Send a JSON response to the current command. outBuf is non-null on entry.
@@ -987,6 +1123,14 @@ void HttpResponder::SendJsonResponse(const char *_ecv_array command) noexcept
 			return;
 		}
 
+#if SUPPORT_OBJECT_MODEL
+		if (StringEqualsIgnoreCase(command, "events"))			// rr_events
+		{
+			StartEventStream();
+			return;
+		}
+#endif
+
 #if HAS_MASS_STORAGE
 		if (StringEqualsIgnoreCase(command, "download"))
 		{
@@ -1031,21 +1175,8 @@ void HttpResponder::SendJsonResponse(const char *_ecv_array command) noexcept
 		return;
 	}
 
-	// Send the JSON response
-	bool keepOpen = false;
-	if (mayKeepOpen)
-	{
-		// Check that the browser wants to persist the connection too
-		for (size_t i = 0; i < numHeaderKeys; ++i)
-		{
-			if (StringEqualsIgnoreCase(headers[i].key, "Connection"))
-			{
-				// Comment out the following line to disable persistent connections
-				keepOpen = StringEqualsIgnoreCase(headers[i].value, "keep-alive");
-				break;
-			}
-		}
-	}
+	// Send the JSON response. Keep the connection open if the request allows it and the client wants us to.
+	const bool keepOpen = mayKeepOpen && WantKeepAlive();
 
 	// Note that when using RTOS the following response should preferably be small enough to fit in a single buffer.
 	// This is because the current task may get suspended e.g. when reading from SD card to build a file list,
@@ -1059,25 +1190,48 @@ void HttpResponder::SendJsonResponse(const char *_ecv_array command) noexcept
 					"Content-Type: application/json\r\n"
 				);
 	const unsigned int replyLength = (jsonResponse != nullptr) ? jsonResponse->Length() : 0;
-	outBuf->catf("Content-Length: %u\r\n", replyLength);
+#if SUPPORT_OBJECT_MODEL
+	const bool sendInChunks = modelResumePoint.IsSuspended();
+#else
+	const bool sendInChunks = false;
+#endif
+	if (sendInChunks)
+	{
+		outBuf->cat("Transfer-Encoding: chunked\r\n");
+	}
+	else
+	{
+		outBuf->catf("Content-Length: %u\r\n", replyLength);
+	}
 	AddCorsHeader();
-	outBuf->catf("Connection: %s\r\n\r\n", keepOpen ? "keep-alive" : "close");
-	outBuf->Append(jsonResponse);
+	AddConnectionHeaders(keepOpen);
+	if (sendInChunks)
+	{
+		AppendChunk(outBuf, jsonResponse, false);
+	}
+	else
+	{
+		outBuf->Append(jsonResponse);
+	}
 
 	if (outBuf->HadOverflow())
 	{
 		// We ran out of buffers at some point.
 		// DC 2020-05-05: we no longer retry or discard responses if there are no buffers available, instead we return a 503 error immediately
 		ReportOutputBufferExhaustion(__FILE__, __LINE__);
+#if SUPPORT_OBJECT_MODEL
+		modelResumePoint.Reset();
+#endif
 
 		// We know that we have an output buffer, but it may be too short to send a long reply, so send a short one
 		outBuf->copy(serviceUnavailableResponse);
+		ReleasePersistentConnection();
 		Commit(ResponderState::free, false);
 		return;
 	}
 
 	// Here if everything is OK
-	Commit(keepOpen ? ResponderState::reading : ResponderState::free, false);
+	CommitResponse(keepOpen, false);
 	if (reprap.Debug(moduleWebserver))
 	{
 		debugPrintf("Sending JSON reply, length %u\n", replyLength);
@@ -1106,6 +1260,7 @@ void HttpResponder::ProcessMessage() noexcept
 
 	responderState = ResponderState::processingRequest;
 	startedProcessingRequestAt = millis();
+	++requestsOnConnection;
 }
 
 // Process the message received. We have reached the end of the headers.
@@ -1163,7 +1318,8 @@ void HttpResponder::ProcessRequest() noexcept
 				outBuf->catf("Access-Control-Allow-Headers: Content-Type\r\n");
 				AddCorsHeader();
 			}
-			outBuf->cat("\r\n");
+			const bool keepOpen = WantKeepAlive();
+			AddConnectionHeaders(keepOpen);
 			if (outBuf->HadOverflow())
 			{
 				OutputBuffer::ReleaseAll(outBuf);
@@ -1171,7 +1327,7 @@ void HttpResponder::ProcessRequest() noexcept
 			}
 			else
 			{
-				Commit();
+				CommitResponse(keepOpen);
 			}
 			return;
 		}
@@ -1245,6 +1401,7 @@ void HttpResponder::ProcessRequest() noexcept
 						GetPlatform().MessageF(UsbMessage, "Start uploading file %s length %lu\n", filename, postFileLength);
 					}
 					uploadedBytes = 0;
+					transferStartTime = millis();
 
 					// Keep track of the connection that is now uploading
 					const IPAddress remoteIP = GetRemoteIP();
@@ -1275,6 +1432,7 @@ void HttpResponder::ProcessRequest() noexcept
 	{
 		// No output buffers available. Ideally we would wait for one with timeout. For now we just quit.
 		responderState = ResponderState::free;
+		ReleasePersistentConnection();
 	}
 }
 
@@ -1298,6 +1456,7 @@ void HttpResponder::RejectMessage(const char *_ecv_array response, unsigned int
 	{
 		// No output buffers available. Ideally we would wait for one with timeout. For now we just quit.
 		responderState = ResponderState::free;
+		ReleasePersistentConnection();
 	}
 }
 
@@ -1352,7 +1511,14 @@ void HttpResponder::DoUpload() noexcept
 			}
 		}
 
+		const uint32_t uploadTime = millis() - transferStartTime;
 		FinishUpload(postFileLength, fileLastModified, postFileGotCrc, postFileExpectedCrc);
+		if (!uploadError)
+		{
+			++numUploadsTimed;
+			uploadBytesTimed += postFileLength;
+			uploadTimeTimed += uploadTime;
+		}
 		SendJsonResponse("upload");
 	}
 }
@@ -1390,10 +1556,103 @@ void HttpResponder::CancelUpload() noexcept
 void HttpResponder::SendData() noexcept
 {
 	NetworkResponder::SendData();
+	if (downloadLength != 0 && responderState != ResponderState::sending)
+	{
+		// We have finished sending a file
+		++numDownloadsTimed;
+		downloadBytesTimed += downloadLength;
+		downloadTimeTimed += millis() - transferStartTime;
+		downloadLength = 0;
+	}
+
 	if (responderState == ResponderState::reading)
 	{
+		// We have sent the response on a persistent connection. The client may already have sent the next request, which is waiting in the socket.
 		timer = millis();				// restart the timer
+		ResetParser();
+	}
+	else if (responderState == ResponderState::free)
+	{
+		ReleasePersistentConnection();
+#if SUPPORT_OBJECT_MODEL
+		ReleaseEventStream();
+#endif
+	}
+}
+
+// This overrides the version in class UploadingNetworkResponder
+void HttpResponder::ConnectionLost() noexcept
+{
+	downloadLength = 0;								// don't include incomplete downloads in the throughput figures
+	UploadingNetworkResponder::ConnectionLost();
+	ReleasePersistentConnection();
+#if SUPPORT_OBJECT_MODEL
+	ReleaseEventStream();
+#endif
+}
+
+// Called when we have sent all the output we generated. If we are sending an object model response in chunks, generate the next chunk.
+bool HttpResponder::GenerateMoreOutput() noexcept
+{
+#if SUPPORT_OBJECT_MODEL
+	if (modelResumePoint.IsSuspended())
+	{
+		// Wait until there are enough free buffers for the next chunk and its framing, leaving the reserved ones for other channels
+		if (OutputBuffer::GetFreeBuffers() < RESERVED_OUTPUT_BUFFERS + ModelResponseChunkSize/OUTPUT_BUFFER_SIZE + 2)
+		{
+			return true;
+		}
+
+		OutputBuffer *buf;
+		if (!OutputBuffer::Allocate(buf))
+		{
+			return true;
+		}
+
+		OutputBuffer *chunk;
+		try
+		{
+			chunk = (modelSeqs != nullptr)
+					? reprap.GetModelPatchResponseChunk(nullptr, modelFlags, modelSeqs, modelResumePoint, ModelResponseChunkSize)
+						: reprap.GetModelResponseChunk(nullptr, modelKey, modelFlags, modelResumePoint, ModelResponseChunkSize);
+		}
+		catch (const GCodeException&)
+		{
+			// We can't generate the rest of the response, so close the connection to tell the client that it is incomplete
+			OutputBuffer::ReleaseAll(buf);
+			modelResumePoint.Reset();
+			ConnectionLost();
+			return true;
+		}
+		if (chunk == nullptr)
+		{
+			OutputBuffer::ReleaseAll(buf);
+			return true;								// we ran out of buffers, so try again later
+		}
+
+		AppendChunk(buf, chunk, !modelResumePoint.IsSuspended());
+		if (buf->HadOverflow())
+		{
+			// We can't send the rest of the response, so close the connection to tell the client that it is incomplete
+			OutputBuffer::ReleaseAll(buf);
+			ReportOutputBufferExhaustion(__FILE__, __LINE__);
+			modelResumePoint.Reset();
+			ConnectionLost();
+			return true;
+		}
+		outStack.Push(buf);
+		return true;
 	}
+#endif
+	return false;
+}
+
+// Append a chunk of data using HTTP chunked transfer encoding. If it is the last chunk, add the terminating empty chunk too.
+/*static*/ void HttpResponder::AppendChunk(OutputBuffer *buf, OutputBuffer *chunk, bool isLast) noexcept
+{
+	buf->catf("%x\r\n", (unsigned int)chunk->Length());
+	buf->Append(chunk);
+	buf->cat((isLast) ? "\r\n0\r\n\r\n" : "\r\n");
 }
 
 void HttpResponder::Diagnostics(MessageType mt) const noexcept
@@ -1522,7 +1781,20 @@ void HttpResponder::Diagnostics(MessageType mt) const noexcept
 
 /*static*/ void HttpResponder::CommonDiagnostics(MessageType mtype) noexcept
 {
-	GetPlatform().MessageF(mtype, "HTTP sessions: %u of %u\n", numSessions, MaxHttpSessions);
+	GetPlatform().MessageF(mtype, "HTTP sessions: %u of %u, persistent connections %u of %u\n", numSessions, MaxHttpSessions, numPersistentConnections, MaxPersistentConnections);
+#if SUPPORT_OBJECT_MODEL
+	GetPlatform().MessageF(mtype, "HTTP event streams: %u of %u\n", numEventStreams, MaxEventStreams);
+#endif
+
+	// Report the average throughput of the uploads and downloads that completed since the last report
+	GetPlatform().MessageF(mtype, "HTTP uploads %u (%.1fKb/s), downloads %u (%.1fKb/s)\n",
+							numUploadsTimed, (double)((float)uploadBytesTimed/(float)max<uint32_t>(uploadTimeTimed, 1) * (1000.0/1024.0)),
+							numDownloadsTimed, (double)((float)downloadBytesTimed/(float)max<uint32_t>(downloadTimeTimed, 1) * (1000.0/1024.0)));
+	numUploadsTimed = numDownloadsTimed = 0;
+	uploadBytesTimed = uploadTimeTimed = downloadBytesTimed = downloadTimeTimed = 0;
+#if HAS_MASS_STORAGE
+	WebFileCache::Diagnostics(mtype, GetPlatform());
+#endif
 }
 
 void HttpResponder::AddCorsHeader() noexcept
@@ -1533,11 +1805,364 @@ void HttpResponder::AddCorsHeader() noexcept
 	}
 }
 
+#if HAS_MASS_STORAGE
+
+// Return true if a filename includes a version hash, e.g. "js/app.1a2b3c4d.js". The content of such a file never changes, so the client may cache it for as long as it likes.
+static bool IsVersionedWebFile(const char *_ecv_array filename) noexcept
+{
+	unsigned int numHexDigits = 0;
+	for (const char *_ecv_array p = filename; *p != 0; ++p)
+	{
+		if (*p == '.')
+		{
+			if (numHexDigits >= 8)
+			{
+				return true;
+			}
+			numHexDigits = 0;
+		}
+		else if (numHexDigits != 0 || (p != filename && p[-1] == '.'))
+		{
+			numHexDigits = (isxdigit((unsigned char)*p)) ? numHexDigits + 1 : 0;
+		}
+	}
+	return false;
+}
+
+// Add the headers that tell the client how to cache a web file
+void HttpResponder::AddWebCacheHeaders(const char *_ecv_array filename, uint32_t etag) noexcept
+{
+	outBuf->catf("ETag: \"%08" PRIx32 "\"\r\nCache-Control: %s\r\n",
+					etag, (IsVersionedWebFile(filename)) ? "public, max-age=31536000, immutable" : "no-cache");
+}
+
+// Return true if the request included an If-None-Match header that matches the specified ETag
+bool HttpResponder::ClientHasCurrentVersion(uint32_t etag) const noexcept
+{
+	const char *_ecv_array const tags = GetHeaderValue("If-None-Match");
+	if (tags == nullptr)
+	{
+		return false;
+	}
+	if (tags[0] == '*')
+	{
+		return true;
+	}
+	String<StringLength20> etagString;
+	etagString.printf("\"%08" PRIx32 "\"", etag);
+	return strstr(tags, etagString.c_str()) != nullptr;		// this allows for weak ETags and lists of ETags
+}
+
+// Tell the client that the web file it has cached is still current
+void HttpResponder::SendNotModified(const char *_ecv_array filename, uint32_t etag) noexcept
+{
+	WebFileCache::NoteNotModified();
+	outBuf->copy("HTTP/1.1 304 Not Modified\r\n");
+	AddWebCacheHeaders(filename, etag);
+	const bool keepOpen = WantKeepAlive();
+	AddConnectionHeaders(keepOpen);
+	CommitResponse(keepOpen);
+}
+
+#endif
+
+// Decide whether to keep the connection open after we send the response to the current request.
+// HTTP/1.1 connections are persistent unless the client asks us to close them, older ones only if the client asks us to keep them open.
+// We limit the number of persistent connections and the number of requests served on each one, so that other clients get a fair share of the responders.
+// This doesn't claim a persistent connection slot, because we may yet fail to queue the response. CommitResponse() does that.
+bool HttpResponder::WantKeepAlive() noexcept
+{
+	bool wanted = (numCommandWords >= 3 && StringEqualsIgnoreCase(commandWords[2], "HTTP/1.1"));
+	for (size_t i = 0; i < numHeaderKeys; ++i)
+	{
+		if (StringEqualsIgnoreCase(headers[i].key, "Connection"))
+		{
+			if (StringEqualsIgnoreCase(headers[i].value, "close"))
+			{
+				wanted = false;
+			}
+			else if (StringEqualsIgnoreCase(headers[i].value, "keep-alive"))
+			{
+				wanted = true;
+			}
+			break;
+		}
+	}
+
+	if (!wanted || requestsOnConnection >= MaxRequestsPerConnection)
+	{
+		ReleasePersistentConnection();
+		return false;
+	}
+
+	return isPersistent || numPersistentConnections < MaxPersistentConnections;
+}
+
+// Send the response we have queued, then either wait for another request on this connection or close it
+void HttpResponder::CommitResponse(bool keepOpen, bool report) noexcept
+{
+	if (keepOpen && !isPersistent)
+	{
+		isPersistent = true;
+		++numPersistentConnections;
+	}
+	Commit((keepOpen) ? ResponderState::reading : ResponderState::free, report);
+}
+
+// Add the Connection header and the blank line that ends the headers
+void HttpResponder::AddConnectionHeaders(bool keepOpen) noexcept
+{
+	if (keepOpen)
+	{
+		outBuf->catf("Connection: keep-alive\r\nKeep-Alive: timeout=%u, max=%u\r\n\r\n",
+						(unsigned int)(HttpReceiveTimeout/1000), MaxRequestsPerConnection - requestsOnConnection);
+	}
+	else
+	{
+		outBuf->cat("Connection: close\r\n\r\n");
+	}
+}
+
+// Stop counting this connection as a persistent one
+void HttpResponder::ReleasePersistentConnection() noexcept
+{
+	if (isPersistent)
+	{
+		isPersistent = false;
+		--numPersistentConnections;
+	}
+}
+
+#if SUPPORT_OBJECT_MODEL
+
+// Start sending server-sent events on this connection. Each time any of the object model sequence numbers changes we send the client an event containing them,
+// or if it asked for patches then an event containing a JSON merge patch that brings its copy of the object model up to date.
+// Query parameters: patch=1 to send patches, flags=xxx for the flags to use when generating them, interval=nnn to send patches at least this often in milliseconds.
+void HttpResponder::StartEventStream() noexcept
+{
+	if (numEventStreams >= MaxEventStreams || (!isPersistent && numPersistentConnections >= MaxPersistentConnections))
+	{
+		RejectMessage("Too many event streams", 503);
+		return;
+	}
+
+	if (!isPersistent)
+	{
+		isPersistent = true;
+		++numPersistentConnections;
+	}
+	isEventStream = true;
+	++numEventStreams;
+
+	const char *const patchVal = GetKeyValue("patch");
+	eventPatches = (patchVal != nullptr && StrToU32(patchVal) != 0);
+	const char *const intervalVal = GetKeyValue("interval");
+	eventPatchInterval = (intervalVal == nullptr) ? 0 : StrToU32(intervalVal);
+	if (eventPatchInterval != 0 && eventPatchInterval < MinEventInterval)
+	{
+		eventPatchInterval = MinEventInterval;
+	}
+	modelKey = nullptr;
+	modelFlags = GetKeyValue("flags");
+	modelSeqs = nullptr;
+
+	reportedSeqs.valid = false;								// so that the first patch contains the whole object model
+	eventResumePoint.Reset();
+	eventFailures = 0;
+
+	outBuf->copy(	"HTTP/1.1 200 OK\r\n"
+					"Content-Type: text/event-stream\r\n"
+					"Cache-Control: no-cache\r\n"
+				);
+	AddCorsHeader();
+	outBuf->cat("Connection: keep-alive\r\n\r\n");
+
+	// Send the initial state straight away. If it is too large to send in one go, SendEvents sends the rest of it.
+	if (!AppendEvent())
+	{
+		ReportOutputBufferExhaustion(__FILE__, __LINE__);
+		outBuf->copy(serviceUnavailableResponse);
+		ReleaseEventStream();
+		ReleasePersistentConnection();
+		Commit(ResponderState::free, false);
+		return;
+	}
+
+	timer = millis();
+	Commit(ResponderState::streamingEvents, false);
+	if (reprap.Debug(moduleWebserver))
+	{
+		debugPrintf("Started event stream, patches %s\n", (eventPatches) ? "yes" : "no");
+	}
+}
+
+// Send an event if the object model has changed, or a comment to keep the connection alive if we haven't sent anything for a while.
+// Events are rate limited, so that however often the object model changes the client gets at most one event per MinEventInterval.
+// A patch that is too large to send in one go is sent in chunks, one chunk per call.
+bool HttpResponder::SendEvents() noexcept
+{
+	// The client has no reason to send anything more on this connection, so discard anything it does send
+	char c;
+	while (skt->ReadChar(c)) { }
+
+	if (!skt->CanSend() || !CheckAuthenticated())			// CheckAuthenticated also keeps the HTTP session alive
+	{
+		ConnectionLost();									// the client has closed the connection or logged out
+		return true;
+	}
+
+	// If we are part way through sending an event then send the next part of it straight away, unless we failed to generate it last time
+	const uint32_t now = millis();
+	const bool continuingEvent = eventResumePoint.IsSuspended();
+	if (now - timer < MinEventInterval && (!continuingEvent || eventFailures != 0))
+	{
+		return false;
+	}
+
+	const bool changed = continuingEvent
+						|| reprap.GetModelChangeCount() != lastModelChangeCount
+						|| GetReplySeq() != lastReplySeq
+						|| (eventPatches && eventPatchInterval != 0 && now - timer >= eventPatchInterval);
+	if (!changed && now - timer < EventKeepAliveInterval)
+	{
+		return false;
+	}
+
+	// Leave the reserved buffers for other channels, and if we are sending patches make sure there is room for a whole chunk. If we can't get a buffer, try again later.
+	const unsigned int buffersNeeded = (changed && eventPatches) ? RESERVED_OUTPUT_BUFFERS + ModelResponseChunkSize/OUTPUT_BUFFER_SIZE + 2 : RESERVED_OUTPUT_BUFFERS + 1;
+	if (OutputBuffer::GetFreeBuffers() < buffersNeeded || !OutputBuffer::Allocate(outBuf))
+	{
+		return false;
+	}
+
+	if (changed)
+	{
+		if (!AppendEvent())
+		{
+			OutputBuffer::ReleaseAll(outBuf);
+			++eventFailures;
+			if (eventFailures >= MaxEventFailures)
+			{
+				// We can't finish an event that we have started, or we keep failing to generate new ones, so give up. The client will reconnect and get the whole object model.
+				if (reprap.Debug(moduleWebserver))
+				{
+					debugPrintf("Dropped event stream after %u failures\n", eventFailures);
+				}
+				ConnectionLost();
+				return true;
+			}
+			timer = now;									// try again after MinEventInterval
+			return false;
+		}
+		eventFailures = 0;
+	}
+	else
+	{
+		outBuf->copy(":\n\n");									// a comment, which the client ignores
+	}
+
+	timer = now;
+	Commit(ResponderState::streamingEvents, false);
+	return true;
+}
+
+// Append the next part of an event to outBuf that tells the client about changes to the object model. Return false if we ran out of buffers.
+// A patch event is generated in chunks. We start sending the event with the first chunk and append each of the others to the event when SendEvents calls us again.
+bool HttpResponder::AppendEvent() noexcept
+{
+	const bool startingEvent = !eventResumePoint.IsSuspended();
+
+	// Read the change counters before we generate the event, so that if anything changes while we do so then we send another event
+	const uint32_t changeCount = reprap.GetModelChangeCount();
+	const uint16_t replySeq = GetReplySeq();
+
+	const JsonResumePoint originalResumePoint = eventResumePoint;
+	OutputBuffer *data;
+	try
+	{
+		if (eventPatches)
+		{
+			if (startingEvent)
+			{
+				reprap.GetModelSeqs(pendingSeqs);
+			}
+			data = reprap.GetModelPatchResponseChunk(nullptr, modelFlags, reportedSeqs, eventResumePoint, ModelResponseChunkSize);
+		}
+		else
+		{
+			data = reprap.GetModelResponse(nullptr, "seqs", nullptr);
+		}
+	}
+	catch (const GCodeException&)
+	{
+		data = nullptr;
+	}
+
+	if (data == nullptr)
+	{
+		return false;
+	}
+
+	// The JSON ends with a newline and has no others, so it forms a single data line. The extra newline ends the event.
+	if (startingEvent)
+	{
+		outBuf->catf("event: %s\ndata: ", (eventPatches) ? "patch" : "seqs");
+	}
+	outBuf->Append(data);
+	if (!eventResumePoint.IsSuspended())
+	{
+		outBuf->cat('\n');
+	}
+	if (outBuf->HadOverflow())
+	{
+		eventResumePoint = originalResumePoint;				// so that we generate this part of the event again
+		return false;
+	}
+
+	if (startingEvent)
+	{
+		lastModelChangeCount = changeCount;
+		lastReplySeq = replySeq;
+	}
+	if (!eventResumePoint.IsSuspended())
+	{
+		eventResumePoint.Reset();
+		if (eventPatches)
+		{
+			reportedSeqs = pendingSeqs;
+		}
+	}
+	return true;
+}
+
+// Stop counting this connection as an event stream
+void HttpResponder::ReleaseEventStream() noexcept
+{
+	if (isEventStream)
+	{
+		isEventStream = false;
+		--numEventStreams;
+	}
+}
+
+#endif
+
 // Static data
 
 HttpResponder::HttpSession HttpResponder::sessions[MaxHttpSessions];
 unsigned int HttpResponder::numSessions = 0;
 unsigned int HttpResponder::clientsServed = 0;
+unsigned int HttpResponder::numPersistentConnections = 0;
+#if SUPPORT_OBJECT_MODEL
+unsigned int HttpResponder::numEventStreams = 0;
+#endif
+
+unsigned int HttpResponder::numUploadsTimed = 0;
+uint32_t HttpResponder::uploadBytesTimed = 0;
+uint32_t HttpResponder::uploadTimeTimed = 0;
+unsigned int HttpResponder::numDownloadsTimed = 0;
+uint32_t HttpResponder::downloadBytesTimed = 0;
+uint32_t HttpResponder::downloadTimeTimed = 0;
 
 volatile uint16_t HttpResponder::seq = 0;
 volatile OutputStack HttpResponder::gcodeReply;
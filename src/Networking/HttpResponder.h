@@ -30,6 +30,8 @@ public:
 protected:
 	void CancelUpload() noexcept override;
 	void SendData() noexcept override;
+	void ConnectionLost() noexcept override;
+	bool GenerateMoreOutput() noexcept override;
 
 private:
 #ifdef __LPC17xx__
@@ -44,6 +46,10 @@ private:
 	static const uint32_t HttpSessionTimeout = 8000;	// HTTP session timeout in milliseconds
 	static const uint32_t MaxFileInfoGetTime = 2000;	// maximum length of time we spend getting file info, to avoid the client timing out (actual time will be a little longer than this)
 	static const uint32_t MaxBufferWaitTime = 1000;		// maximum length of time we spend waiting for a buffer before we discard gcodeReply buffers
+	static const unsigned int MaxRequestsPerConnection = 100;	// maximum number of requests we serve on one persistent connection before closing it
+	static const uint32_t MinEventInterval = 250;		// minimum interval between server-sent events in milliseconds
+	static const uint32_t EventKeepAliveInterval = 5000;	// how often we send a comment on an idle event stream, must be less than HttpSessionTimeout to keep the session alive
+	static const unsigned int MaxEventFailures = 20;	// how many times in succession we may fail to generate an event before we drop the event stream
 
 	enum class HttpParseState
 	{
@@ -80,6 +86,7 @@ private:
 	bool CheckAuthenticated() noexcept;
 	bool RemoveAuthentication() noexcept;
 
+	void ResetParser() noexcept;
 	bool CharFromClient(char c) noexcept;
 	void SendFile(const char *_ecv_array nameOfFileToSend, bool isWebFile) noexcept;
 	void SendGCodeReply() noexcept;
@@ -90,12 +97,28 @@ private:
 	void RejectMessage(const char *_ecv_array s, unsigned int code = 500) noexcept;
 	bool SendFileInfo(bool quitEarly) noexcept;
 	void AddCorsHeader() noexcept;
+	bool WantKeepAlive() noexcept;
+	void AddConnectionHeaders(bool keepOpen) noexcept;
+	void CommitResponse(bool keepOpen, bool report = true) noexcept;
+	void ReleasePersistentConnection() noexcept;
+	static void AppendChunk(OutputBuffer *buf, OutputBuffer *chunk, bool isLast) noexcept;
+
+#if SUPPORT_OBJECT_MODEL
+	void StartEventStream() noexcept;
+	bool SendEvents() noexcept;
+	bool AppendEvent() noexcept;
+	void ReleaseEventStream() noexcept;
+#endif
 
 #if HAS_MASS_STORAGE
 	void DoUpload() noexcept;
+	void AddWebCacheHeaders(const char *_ecv_array filename, uint32_t etag) noexcept;
+	bool ClientHasCurrentVersion(uint32_t etag) const noexcept;
+	void SendNotModified(const char *_ecv_array filename, uint32_t etag) noexcept;
 #endif
 
 	const char* GetKeyValue(const char *_ecv_array key) const noexcept;	// return the value of the specified key, or nullptr if not present
+	const char* GetHeaderValue(const char *_ecv_array key) const noexcept;	// return the value of the specified header, or nullptr if not present
 
 	static void RemoveSession(size_t sessionToRemove) noexcept;
 
@@ -120,13 +143,50 @@ private:
 
 	uint32_t postFileLength;
 	uint32_t postFileExpectedCrc;
+	uint32_t transferStartTime;						// when we started receiving the current upload or sending the current download
+	uint32_t downloadLength;						// the length of the file we are sending, or zero if we are not timing a download
 	time_t fileLastModified;
 	bool postFileGotCrc;
 
+	// Persistent connections
+	unsigned int requestsOnConnection;				// the number of requests we have received on this connection
+	bool isPersistent;								// true if this connection counts towards numPersistentConnections
+
+#if SUPPORT_OBJECT_MODEL
+	// rr_model responses that are too large to generate in one go are sent in chunks
+	JsonResumePoint modelResumePoint;				// where to continue the response from
+	const char *_ecv_array _ecv_null modelKey;		// these point into clientMessage, which is not overwritten until we have sent the response
+	const char *_ecv_array _ecv_null modelFlags;
+	const char *_ecv_array _ecv_null modelSeqs;		// the sequence numbers that the client sent if we are sending a merge patch, else nullptr
+
+	// Server-sent events
+	RepRap::ModelSeqs reportedSeqs;					// the sequence numbers that we last sent a patch for
+	RepRap::ModelSeqs pendingSeqs;					// the sequence numbers at the start of the patch that we are sending in chunks
+	JsonResumePoint eventResumePoint;				// where to continue the patch that we are sending in chunks
+	uint32_t lastModelChangeCount;					// the value of the object model change count when we last sent an event
+	uint32_t eventPatchInterval;					// how often we send patches even if the sequence numbers haven't changed, or 0 if we don't
+	uint16_t lastReplySeq;							// the G-code reply sequence number when we last sent an event
+	uint8_t eventFailures;							// how many times in succession we have failed to generate an event
+	bool isEventStream;								// true if this connection counts towards numEventStreams
+	bool eventPatches;								// true if the client wants object model patches as well as the sequence numbers
+#endif
+
 	// Keeping track of HTTP sessions
 	static HttpSession sessions[MaxHttpSessions];
 	static unsigned int numSessions;
 	static unsigned int clientsServed;
+	static unsigned int numPersistentConnections;	// the number of connections that we are keeping open between requests
+#if SUPPORT_OBJECT_MODEL
+	static unsigned int numEventStreams;			// the number of connections that we are sending server-sent events on
+#endif
+
+	// Upload and download throughput since the last diagnostics report
+	static unsigned int numUploadsTimed;
+	static uint32_t uploadBytesTimed;
+	static uint32_t uploadTimeTimed;				// in milliseconds
+	static unsigned int numDownloadsTimed;
+	static uint32_t downloadBytesTimed;
+	static uint32_t downloadTimeTimed;				// in milliseconds
 
 	// Responses from GCodes class
 	static volatile uint16_t seq;					// Sequence number for G-Code replies
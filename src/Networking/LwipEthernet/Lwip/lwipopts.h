@@ -98,6 +98,77 @@
 #define lwip_htonl(_x)			__builtin_bswap32(_x)
 #define SWAP_BYTES_IN_WORD(_x)	__builtin_bswap16(_x)
 
+/*
+   ------------------------------------
+   ---------- Memory profiles ---------
+   ------------------------------------
+*/
+
+/**
+ * LWIP_MEMORY_PROFILE selects how the RAM given to lwIP is shared between TCP windows, send buffers, pbufs and connections.
+ * Define it on the compiler command line to select a profile other than the default:
+ * LWIP_PROFILE_BALANCED: suitable for most users, with larger send buffers than older firmware versions had
+ * LWIP_PROFILE_UPLOAD: large receive windows and send buffers for fast file uploads and downloads, but fewer spare connections
+ * LWIP_PROFILE_MANY_CLIENTS: small windows and more connections, for machines that are monitored by several clients at once
+ * The SAME70 and SAMV71 have more RAM so they get larger values. On those processors the pbuf pool occupies the rest of the
+ * non-cached RAM block, so its size is the same in all profiles and the larger windows come from the spare pbufs.
+ * Each TCP_WND must fit in the pbufs that are not needed for the GMAC receive ring, because received data stays in pbufs until it is read.
+ * Because LWIP_NETIF_TX_SINGLE_PBUF is set, TCP data being sent is copied into the heap, so MEM_SIZE must have room for at least TCP_SND_BUF.
+ */
+#define LWIP_PROFILE_BALANCED			0
+#define LWIP_PROFILE_UPLOAD				1
+#define LWIP_PROFILE_MANY_CLIENTS		2
+
+#ifndef LWIP_MEMORY_PROFILE
+# define LWIP_MEMORY_PROFILE			LWIP_PROFILE_BALANCED
+#endif
+
+#if defined(__SAME70Q20B__) || defined(__SAME70Q21B__) || defined(__SAMV71Q20B__) || defined(__SAMV71Q21B__)
+# define LWIP_EXTRA_POOL_PBUFS			15
+# if LWIP_MEMORY_PROFILE == LWIP_PROFILE_UPLOAD
+#  define LWIP_PROFILE_NAME				"upload"
+#  define LWIP_TCP_WND_SEGMENTS			12
+#  define LWIP_TCP_SND_BUF_SEGMENTS		8
+#  define LWIP_NUM_TCP_PCB				10
+#  define LWIP_MEM_SIZE					16384
+# elif LWIP_MEMORY_PROFILE == LWIP_PROFILE_MANY_CLIENTS
+#  define LWIP_PROFILE_NAME				"many clients"
+#  define LWIP_TCP_WND_SEGMENTS			3
+#  define LWIP_TCP_SND_BUF_SEGMENTS		2
+#  define LWIP_NUM_TCP_PCB				16
+#  define LWIP_MEM_SIZE					12288
+# else
+#  define LWIP_PROFILE_NAME				"balanced"
+#  define LWIP_TCP_WND_SEGMENTS			6
+#  define LWIP_TCP_SND_BUF_SEGMENTS		4
+#  define LWIP_NUM_TCP_PCB				10
+#  define LWIP_MEM_SIZE					12288
+# endif
+#else
+# if LWIP_MEMORY_PROFILE == LWIP_PROFILE_UPLOAD
+#  define LWIP_PROFILE_NAME				"upload"
+#  define LWIP_EXTRA_POOL_PBUFS			20
+#  define LWIP_TCP_WND_SEGMENTS			10
+#  define LWIP_TCP_SND_BUF_SEGMENTS		6
+#  define LWIP_NUM_TCP_PCB				8
+#  define LWIP_MEM_SIZE					16384
+# elif LWIP_MEMORY_PROFILE == LWIP_PROFILE_MANY_CLIENTS
+#  define LWIP_PROFILE_NAME				"many clients"
+#  define LWIP_EXTRA_POOL_PBUFS			12
+#  define LWIP_TCP_WND_SEGMENTS			2
+#  define LWIP_TCP_SND_BUF_SEGMENTS		2
+#  define LWIP_NUM_TCP_PCB				12
+#  define LWIP_MEM_SIZE					12288
+# else
+#  define LWIP_PROFILE_NAME				"balanced"
+#  define LWIP_EXTRA_POOL_PBUFS			12
+#  define LWIP_TCP_WND_SEGMENTS			4
+#  define LWIP_TCP_SND_BUF_SEGMENTS		3
+#  define LWIP_NUM_TCP_PCB				8
+#  define LWIP_MEM_SIZE					12288
+# endif
+#endif
+
 /*
    ------------------------------------
    ---------- Memory options ----------
@@ -115,7 +186,7 @@
  * MEM_SIZE: the size of the heap memory. If the application will send
  * a lot of data that needs to be copied, this should be set high.
  */
-#define MEM_SIZE                		12288		// 8192 works too but then lwip reports mem errors. sadly "max" isn't working
+#define MEM_SIZE                		LWIP_MEM_SIZE		// 8192 works too but then lwip reports mem errors. sadly "max" isn't working
 
 /**
  * MEMP_NUM_UDP_PCB: the number of UDP protocol control blocks. One
@@ -128,11 +199,7 @@
  * MEMP_NUM_TCP_PCB: the number of simultaneously active TCP connections.
  * (requires the LWIP_TCP option)
  */
-#if defined(__SAME70Q20B__) || defined(__SAME70Q21B__) || defined(__SAMV71Q20B__) || defined(__SAMV71Q21B__)
-# define MEMP_NUM_TCP_PCB				10
-#else
-# define MEMP_NUM_TCP_PCB				8
-#endif
+#define MEMP_NUM_TCP_PCB				LWIP_NUM_TCP_PCB
 
 /**
  * MEMP_NUM_TCP_PCB_LISTEN: the number of listening TCP connections.
@@ -147,12 +214,9 @@
 /**
  * MEMP_NUM_TCP_SEG: the number of simultaneously queued TCP segments.
  * (requires the LWIP_TCP option)
+ * Each connection may queue up to TCP_SND_QUEUELEN segments, so allow some more for the other connections.
  */
-#if defined(__SAME70Q20B__) || defined(__SAME70Q21B__) || defined(__SAMV71Q20B__) || defined(__SAMV71Q21B__)
-# define MEMP_NUM_TCP_SEG				10
-#else
-# define MEMP_NUM_TCP_SEG				8
-#endif
+#define MEMP_NUM_TCP_SEG				(TCP_SND_QUEUELEN + 8)
 
 /**
  * MEMP_NUM_REASSDATA: the number of IP packets simultaneously queued for
@@ -191,12 +255,8 @@
 /**
  * PBUF_POOL_SIZE: the number of buffers in the pbuf pool. Needs to be enough for IP packet reassembly.
  */
-#if defined(__SAME70Q20B__) || defined(__SAME70Q21B__) || defined(__SAMV71Q20B__) || defined(__SAMV71Q21B__)
-// We may as well use the remainder of the non-cached RAM block for additional pbufs
-# define PBUF_POOL_SIZE                  (GMAC_RX_BUFFERS + GMAC_TX_BUFFERS + 15)
-#else
-# define PBUF_POOL_SIZE                  (GMAC_RX_BUFFERS + GMAC_TX_BUFFERS + 12)
-#endif
+// On the SAME70 we may as well use the remainder of the non-cached RAM block for additional pbufs
+#define PBUF_POOL_SIZE                  (GMAC_RX_BUFFERS + GMAC_TX_BUFFERS + LWIP_EXTRA_POOL_PBUFS)
 
 /**
  * PBUF_POOL_BUFSIZE: the size of each pbuf in the pbuf pool.
@@ -262,13 +322,13 @@ extern uint32_t random32(void) noexcept;
  * TCP_WND: The size of a TCP window.  This must be at least
  * (2 * TCP_MSS) for things to work well
  */
-#define TCP_WND                 (4 * TCP_MSS)
+#define TCP_WND                 (LWIP_TCP_WND_SEGMENTS * TCP_MSS)
 
 /**
  * TCP_SND_BUF: TCP sender buffer space (bytes).
  * To achieve good performance, this should be at least 2 * TCP_MSS.
  */
-#define TCP_SND_BUF             (2 * TCP_MSS)
+#define TCP_SND_BUF             (LWIP_TCP_SND_BUF_SEGMENTS * TCP_MSS)
 
 /**
  * TCP_SND_QUEUELEN: TCP sender buffer space (pbufs). This must be at least
@@ -517,6 +517,13 @@ void LwipEthernetInterface::Diagnostics(MessageType mtype) noexcept
 		platform.MessageF(mtype, " %d", s->GetState());
 	}
 	platform.Message(mtype, "\n");
+	platform.MessageF(mtype, "lwIP profile %s: TCP window %u, send buffer %u, pbufs %u, TCP PCBs %u\n",
+						LWIP_PROFILE_NAME, (unsigned int)TCP_WND, (unsigned int)TCP_SND_BUF, (unsigned int)PBUF_POOL_SIZE, (unsigned int)MEMP_NUM_TCP_PCB);
+#if MEM_STATS && MEMP_STATS
+	platform.MessageF(mtype, "lwIP heap max used %u of %u, errors %u; pbufs max used %u, errors %u\n",
+						(unsigned int)lwip_stats.mem.max, (unsigned int)MEM_SIZE, (unsigned int)lwip_stats.mem.err,
+						(unsigned int)lwip_stats.memp[MEMP_PBUF_POOL]->max, (unsigned int)lwip_stats.memp[MEMP_PBUF_POOL]->err);
+#endif
 
 #if LWIP_STATS
 	if (reprap.Debug(moduleNetwork))
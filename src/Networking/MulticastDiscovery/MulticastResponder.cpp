@@ -26,33 +26,69 @@ extern Mutex lwipMutex;
 
 static constexpr ip_addr_t ourGroupIpAddr = IPADDR4_INIT_BYTES(239, 255, 2, 3);
 
+// When a PC scans a subnet containing many printers, every printer receives the request at the same time, and each printer may also receive the responses
+// from all the others because they are multicast. So we discard frames that are not for us as soon as they arrive, we delay our responses
+// by an amount that depends on our unique ID so that the printers in a fleet don't all reply at once, and we limit the rate at which we send responses.
+constexpr size_t RxQueueLength = 4;									// the number of received requests we can hold. Each one holds on to a pbuf, so keep this small.
+constexpr uint32_t MaxResponseDelayMillis = 100;					// the maximum delay before we process a request
+constexpr int32_t MaxResponseCredit = 8;							// the maximum number of responses we send in a burst
+constexpr uint32_t ResponseCreditMillis = 10;						// we earn credit for one more response at this interval
+
+struct ReceivedMessage
+{
+	pbuf *pb;
+	uint32_t whenReceived;
+	uint32_t ipAddr;
+	uint16_t port;
+};
+
 static udp_pcb *ourPcb = nullptr;
-static pbuf * volatile receivedPbuf = nullptr;
+static ReceivedMessage rxQueue[RxQueueLength];
+static volatile unsigned int rxQueueIn = 0;							// free-running count of messages added to the queue
+static volatile unsigned int rxQueueOut = 0;						// free-running count of messages taken from the queue
 static pbuf *pbufToFree = nullptr;
-static volatile uint32_t receivedIpAddr;
-static volatile uint16_t receivedPort;
 static uint16_t lastMessageReceivedPort;
 static unsigned int messagesProcessed = 0;
+static unsigned int messagesIgnored = 0;
+static unsigned int messagesDropped = 0;
+static unsigned int maxMessagesQueued = 0;
 static unsigned int responsesSent = 0;
 static FGMCProtocol *fgmcHandler = nullptr;
 static uint32_t ticksToReboot = 0;
 static uint32_t whenRebootScheduled;
+static uint32_t responseDelay = 0;
+static int32_t responseCredit = MaxResponseCredit;
+static uint32_t whenCreditLastEarned;
 
 static bool active = false;
 
 // Receive callback function
 extern "C" void rcvFunc(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) noexcept
 {
-	if (active && receivedPbuf == nullptr)
+	if (!active || !fgmcHandler->isForUs((const uint8_t *)p->payload, p->len))
 	{
-		receivedIpAddr = addr->addr;
-		receivedPort = port;
-		receivedPbuf = p;				// store this one last
+		++messagesIgnored;
+		pbuf_free(p);
 	}
-	else
+	else if (rxQueueIn - rxQueueOut >= RxQueueLength)
 	{
+		++messagesDropped;
 		pbuf_free(p);
 	}
+	else
+	{
+		ReceivedMessage& msg = rxQueue[rxQueueIn % RxQueueLength];
+		msg.pb = p;
+		msg.whenReceived = millis();
+		msg.ipAddr = addr->addr;
+		msg.port = port;
+		rxQueueIn = rxQueueIn + 1;									// do this one last
+		const unsigned int numQueued = rxQueueIn - rxQueueOut;
+		if (numQueued > maxMessagesQueued)
+		{
+			maxMessagesQueued = numQueued;
+		}
+	}
 }
 
 void MulticastResponder::Init() noexcept
@@ -74,20 +110,34 @@ void MulticastResponder::Spin() noexcept
 	}
 	else
 	{
-		pbuf *rxPbuf = receivedPbuf;
-		if (rxPbuf != nullptr)
+		const uint32_t now = millis();
+		const uint32_t intervals = (now - whenCreditLastEarned)/ResponseCreditMillis;
+		if (intervals != 0)
+		{
+			whenCreditLastEarned += intervals * ResponseCreditMillis;
+			responseCredit = min<int32_t>(responseCredit + (int32_t)min<uint32_t>(intervals, MaxResponseCredit), MaxResponseCredit);
+		}
+
+		if (rxQueueOut != rxQueueIn && responseCredit > 0)
 		{
-			lastMessageReceivedPort = receivedPort;
+			const ReceivedMessage& msg = rxQueue[rxQueueOut % RxQueueLength];
+			if (now - msg.whenReceived < responseDelay)
+			{
+				return;
+			}
+
+			pbuf * const rxPbuf = msg.pb;
+			lastMessageReceivedPort = msg.port;
 #if 0
 			debugPrintf("Rx UDP: addr %u.%u.%u.%u port %u data",
-				(unsigned int)(receivedIpAddr & 0xFF), (unsigned int)((receivedIpAddr >> 8) & 0xFF), (unsigned int)((receivedIpAddr >> 16) & 0xFF), (unsigned int)((receivedIpAddr >> 24) & 0xFF), lastMessageReceivedPort);
+				(unsigned int)(msg.ipAddr & 0xFF), (unsigned int)((msg.ipAddr >> 8) & 0xFF), (unsigned int)((msg.ipAddr >> 16) & 0xFF), (unsigned int)((msg.ipAddr >> 24) & 0xFF), lastMessageReceivedPort);
 			for (size_t i = 0; i < rxPbuf->len; ++i)
 			{
 				debugPrintf(" %02x", ((const uint8_t*)(rxPbuf->payload))[i]);
 			}
 			debugPrintf("\n");
 #endif
-			receivedPbuf = nullptr;
+			rxQueueOut = rxQueueOut + 1;							// the queue slot may be reused after this
 			pbufToFree = rxPbuf;
 
 			fgmcHandler->handleStream(0, (const uint8_t *)rxPbuf->payload, rxPbuf->len);
@@ -106,8 +156,13 @@ void MulticastResponder::Spin() noexcept
 
 void MulticastResponder::Diagnostics(MessageType mtype) noexcept
 {
-	reprap.GetPlatform().MessageF(mtype, "=== Multicast handler ===\nResponder is %s, messages received %u, responses %u\n",
-									(active) ? "active" : "inactive", messagesProcessed, responsesSent);
+	reprap.GetPlatform().MessageF(mtype, "=== Multicast handler ===\nResponder is %s, messages received %u, ignored %u, dropped %u, max queued %u, responses %u\n",
+									(active) ? "active" : "inactive", messagesProcessed, messagesIgnored, messagesDropped, maxMessagesQueued, responsesSent);
+	if (fgmcHandler != nullptr)
+	{
+		reprap.GetPlatform().MessageF(mtype, "Network info responses cached %u, rebuilt %u, response delay %" PRIu32 "ms\n",
+										fgmcHandler->getNetInfoCacheHits(), fgmcHandler->getNetInfoRebuilds(), responseDelay);
+	}
 }
 
 void MulticastResponder::Start(TcpPort port) noexcept
@@ -146,8 +201,14 @@ void MulticastResponder::Start(TcpPort port) noexcept
 			}
 		}
 	}
+	// Spread the responses from a fleet of printers over the delay window, using our unique ID to choose where in the window we respond
+	const UniqueId& id = reprap.GetPlatform().GetUniqueId();
+	responseDelay = (id.GetDwords()[0] ^ id.GetDwords()[1] ^ id.GetDwords()[2] ^ id.GetDwords()[3]) % (MaxResponseDelayMillis + 1);
+	responseCredit = MaxResponseCredit;
+	whenCreditLastEarned = millis();
+
 	active = true;
-	messagesProcessed = responsesSent = 0;
+	messagesProcessed = messagesIgnored = messagesDropped = maxMessagesQueued = responsesSent = 0;
 }
 
 void MulticastResponder::Stop() noexcept
@@ -157,6 +218,13 @@ void MulticastResponder::Stop() noexcept
 		MutexLocker lock(lwipMutex);
 		udp_remove(ourPcb);
 		ourPcb = nullptr;
+
+		// Discard any requests we haven't processed
+		while (rxQueueOut != rxQueueIn)
+		{
+			pbuf_free(rxQueue[rxQueueOut % RxQueueLength].pb);
+			rxQueueOut = rxQueueOut + 1;
+		}
 	}
 	active = false;
 }
@@ -187,6 +255,7 @@ void MulticastResponder::SendResponse(uint8_t *data, size_t length) noexcept
 		if (pbuf_take(pb, data, length) == ERR_OK)
 		{
 			const err_t err = udp_sendto(ourPcb, pb, &ourGroupIpAddr, lastMessageReceivedPort);
+			--responseCredit;
 			if (err == ERR_OK)
 			{
 				++responsesSent;
@@ -22,7 +22,10 @@ FGMCProtocol::FGMCProtocol() noexcept
     : iface_id_(0),
       fgmc_device_id_(FGMCHwTypeId::FGMC_DEVICE_ID_ZERO),
       fgmc_application_type_(0),
-      tx_netbuf_{0}
+      tx_netbuf_{0},
+      netInfoFrameValid_(false),
+      netInfoCacheHits_(0),
+      netInfoRebuilds_(0)
 {
 }
 
@@ -55,6 +58,19 @@ void FGMCProtocol::init() noexcept
 	}
 
 	fgmc_device_id_ = FGMCHwTypeId::FGMC_DEVICE_ID_DUET3;
+	netInfoFrameValid_ = false;
+}
+
+bool FGMCProtocol::isForUs(const uint8_t* inputBufferAddress, uint32_t rxLength) const noexcept
+{
+	if (rxLength < static_cast<uint32_t>(sizeof(FGMC_GenericHeader)))
+	{
+		return false;
+	}
+
+	const FGMC_GenericHeader* const pInGenericHeader = reinterpret_cast<const FGMC_GenericHeader*>(inputBufferAddress);
+	return pInGenericHeader->fgmc_destination_id_[0] == '\0'
+		|| strncmp(pInGenericHeader->fgmc_destination_id_, uniqueId, SIZE_FGMC_DEST_ID) == 0;
 }
 
 void FGMCProtocol::handleStream(unsigned int iFaceId, const uint8_t* inputBufferAddress, uint32_t rxLength) noexcept
@@ -163,7 +179,43 @@ void FGMCProtocol::sendGenericHeader(uint8_t* tx_netbuf, FGMCCommand cmd, uint32
 
 void FGMCProtocol::cmdUnetinf(uint32_t inPacketId) noexcept
 {
-	FGMC_ResUploadNetInfoHeader* pOutCmdHeader = reinterpret_cast<FGMC_ResUploadNetInfoHeader*>(tx_netbuf_);
+	if (netInfoFrameIsCurrent())
+	{
+		++netInfoCacheHits_;
+	}
+	else
+	{
+		buildNetInfoFrame();
+		++netInfoRebuilds_;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Generic Multicast Header
+	//-----------------------------------------------------------------------------------
+	sendGenericHeader(netinf_frame_, FGMCCommand::MCD_COMMAND_UNETINF, sizeof(FGMC_ResUploadNetInfoHeader), inPacketId, 0, 1);
+}
+
+// Return true if the cached upload network information frame is still correct
+bool FGMCProtocol::netInfoFrameIsCurrent() const noexcept
+{
+	if (!netInfoFrameValid_)
+	{
+		return false;
+	}
+
+	const FGMC_ResUploadNetInfoHeader* const pCached = reinterpret_cast<const FGMC_ResUploadNetInfoHeader*>(netinf_frame_);
+	const Network& network = reprap.GetNetwork();
+	return pCached->fgmc_ip_address_type_ == ((network.UsingDhcp(iface_id_)) ? 1u : 0u)
+		&& memcmp(pCached->fgmc_mac_address_, network.GetMacAddress(iface_id_).bytes, SIZE_MAC_ADDRESS) == 0
+		&& LoadLE32(pCached->fgmc_ip_v4_address_) == network.GetIPAddress(iface_id_).GetV4LittleEndian()
+		&& LoadLE32(pCached->fgmc_ip_v4_netmask_) == network.GetNetmask(iface_id_).GetV4LittleEndian()
+		&& LoadLE32(pCached->fgmc_ip_v4_gateway_) == network.GetGateway(iface_id_).GetV4LittleEndian()
+		&& strncmp(pCached->fgmc_device_name_, reprap.GetName(), ARRAY_SIZE(pCached->fgmc_device_name_)) == 0;
+}
+
+void FGMCProtocol::buildNetInfoFrame() noexcept
+{
+	FGMC_ResUploadNetInfoHeader* pOutCmdHeader = reinterpret_cast<FGMC_ResUploadNetInfoHeader*>(netinf_frame_);
 	(void)memset(pOutCmdHeader, 0x00, sizeof(FGMC_ResUploadNetInfoHeader));
 
 	//-----------------------------------------------------------------------------------
@@ -247,10 +299,7 @@ void FGMCProtocol::cmdUnetinf(uint32_t inPacketId) noexcept
 	// Device Name
 	strncpy(pOutCmdHeader->fgmc_device_name_, reprap.GetName(), ARRAY_SIZE(pOutCmdHeader->fgmc_device_name_));
 
-	//-----------------------------------------------------------------------------------
-	// Generic Multicast Header
-	//-----------------------------------------------------------------------------------
-	sendGenericHeader(tx_netbuf_, FGMCCommand::MCD_COMMAND_UNETINF, sizeof(FGMC_ResUploadNetInfoHeader), inPacketId, 0, 1);
+	netInfoFrameValid_ = true;
 }
 
 void FGMCProtocol::cmdDnetinf(FGMC_ReqDownloadNetInfoHeader* pInCmdHeader, uint32_t inPacketId) noexcept
@@ -276,6 +325,7 @@ void FGMCProtocol::cmdDnetinf(FGMC_ReqDownloadNetInfoHeader* pInCmdHeader, uint3
 
 	ifData.configuredNetmask.SetV4LittleEndian(LoadLE32(pInCmdHeader->fgmc_ip_v4_static_netmask_));
 	ifData.configuredGateway.SetV4LittleEndian(LoadLE32(pInCmdHeader->fgmc_ip_v4_static_gateway_));
+	netInfoFrameValid_ = false;										// the configured addresses are in the UNETINF response
 
 	// set new device name
 	// filter out " (X19)  / (X18)
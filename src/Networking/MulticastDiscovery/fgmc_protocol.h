@@ -38,6 +38,18 @@ public:
 	/// \param rxLength receive frame length
 	void handleStream(unsigned int iFaceId, const uint8_t* inputBufferAddress, uint32_t rxLength) noexcept;
 
+	/// quick check used to discard frames we would ignore before they are queued, e.g. responses from other devices
+	/// \param inputBufferAddress fgmc frame
+	/// \param rxLength receive frame length
+	/// \return true if the frame is addressed to all devices or to us
+	bool isForUs(const uint8_t* inputBufferAddress, uint32_t rxLength) const noexcept;
+
+	/// number of upload network information responses sent from the cached frame
+	unsigned int getNetInfoCacheHits() const noexcept { return netInfoCacheHits_; }
+
+	/// number of times the upload network information frame was rebuilt
+	unsigned int getNetInfoRebuilds() const noexcept { return netInfoRebuilds_; }
+
 private:
 	/// this functions sends fgmc frame
 	/// \param pOutPointer sciopta network buffer
@@ -77,6 +89,12 @@ private:
 	/// Build the unique ID
 	void BuildUniqueId() noexcept;
 
+	/// build the body of the upload network information response in netinf_frame_
+	void buildNetInfoFrame() noexcept;
+
+	/// check whether the cached upload network information frame still matches the current network settings and device name
+	bool netInfoFrameIsCurrent() const noexcept;
+
 	// connection data pointer
 	unsigned int iface_id_;
 
@@ -104,6 +122,13 @@ private:
 	char uniqueId[SIZE_FGMC_DEST_ID];
 	InterfaceData ifaceData[IP_MAX_IFACES];
 	uint8_t tx_netbuf_[SIZE_FGMC_RES_MAX];
+
+	// Scans of the network send UNETINF to every device, so we keep the encoded response and only rebuild it when something in it changes.
+	// The serial number, device type and NOC code never change; the addresses and device name are compared with the cached copies.
+	uint8_t netinf_frame_[sizeof(FGMC_ResUploadNetInfoHeader)];
+	bool netInfoFrameValid_;
+	unsigned int netInfoCacheHits_;
+	unsigned int netInfoRebuilds_;
 };
 
 #endif	// SUPPORT_MULTICAST_DISCOVERY
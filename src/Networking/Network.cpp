@@ -601,6 +601,10 @@ void Network::Diagnostics(MessageType mtype) noexcept
 	HttpResponder::CommonDiagnostics(mtype);
 #endif
 
+#if SUPPORT_TELNET
+	TelnetResponder::CommonDiagnostics(mtype);
+#endif
+
 	for (NetworkInterface *iface : interfaces)
 	{
 		if (iface != nullptr)
@@ -25,12 +25,16 @@ const size_t MaxNetworkInterfaces = 1;
 #if SAME70
 const size_t NumHttpResponders = 6;		// the number of concurrent HTTP requests we can process
 const size_t NumTelnetResponders = 2;	// the number of concurrent Telnet sessions we support
+const size_t TelnetReplyBufferSize = 4096;	// the size of the reply buffer for each Telnet session, must be a power of 2
 #else
 // Limit the number of HTTP responders to 4 because they take around 2K of memory each
 const size_t NumHttpResponders = 4;		// the number of concurrent HTTP requests we can process
 const size_t NumTelnetResponders = 1;	// the number of concurrent Telnet sessions we support
+const size_t TelnetReplyBufferSize = 2048;	// the size of the reply buffer for each Telnet session, must be a power of 2
 #endif // not SAME70
 
+static_assert(TelnetReplyBufferSize != 0 && (TelnetReplyBufferSize & (TelnetReplyBufferSize - 1)) == 0, "TelnetReplyBufferSize must be a power of 2");
+
 const size_t NumFtpResponders = 1;		// the number of concurrent FTP sessions we support
 
 #define HAS_RESPONDERS	(SUPPORT_HTTP || SUPPORT_FTP || SUPPORT_TELNET)
@@ -48,7 +48,15 @@ void NetworkResponder::SendData() noexcept
 			outBuf = outStack.Pop();
 			if (outBuf == nullptr)
 			{
-				break;
+				if (!GenerateMoreOutput())
+				{
+					break;
+				}
+				outBuf = outStack.Pop();
+				if (outBuf == nullptr)
+				{
+					return;						// more output will follow but it isn't ready yet, so try again later
+				}
 			}
 		}
 		const size_t bytesLeft = outBuf->BytesLeft();
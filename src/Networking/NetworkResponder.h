@@ -44,6 +44,7 @@ protected:
 		// HTTP responder additional states
 		processingRequest,
 		gettingFileInfo,								// getting file info
+		streamingEvents,								// sending server-sent events
 
 		// FTP responder additional states
 		waitingForPasvPort,
@@ -60,6 +61,7 @@ protected:
 
 	void Commit(ResponderState nextState = ResponderState::free, bool report = true) noexcept;
 	virtual void SendData() noexcept;
+	virtual bool GenerateMoreOutput() noexcept { return false; }		// called when we have sent all the output we have, returns true if more output will follow
 	virtual void ConnectionLost() noexcept;
 
 	IPAddress GetRemoteIP() const noexcept;
@@ -14,8 +14,10 @@
 #include <GCodes/GCodes.h>
 #include <Platform/Platform.h>
 
-TelnetResponder::TelnetResponder(NetworkResponder *n) noexcept : NetworkResponder(n)
+TelnetResponder::TelnetResponder(NetworkResponder *n) noexcept
+	: NetworkResponder(n), nextTelnetResponder(telnetResponders), replyHead(0), replyTail(0), receivingReplies(false), messagesDropped(0)
 {
+	telnetResponders = this;
 }
 
 // Ask the responder to accept this connection, returns true if it did
@@ -23,20 +25,22 @@ bool TelnetResponder::Accept(Socket *s, NetworkProtocol protocol) noexcept
 {
 	if (responderState == ResponderState::free && protocol == TelnetProtocol)
 	{
-		// Make sure we can get an output buffer before we accept the connection, or we won't be able to reply
-		if (outBuf != nullptr || OutputBuffer::Allocate(outBuf))
+		// We send everything from our own reply buffer, so we don't need an output buffer to accept the connection
 		{
-			skt = s;
-			clientPointer = 0;
-			responderState = ResponderState::justConnected;
-			connectTime = millis();
-			haveCompleteLine = false;
-			if (reprap.Debug(moduleWebserver))
-			{
-				debugPrintf("Telnet connection accepted\n");
-			}
-			return true;
+			MutexLocker lock(gcodeReplyMutex);
+			replyHead = replyTail = 0;
+			messagesDropped = 0;
+		}
+		skt = s;
+		clientPointer = 0;
+		responderState = ResponderState::justConnected;
+		connectTime = millis();
+		haveCompleteLine = false;
+		if (reprap.Debug(moduleWebserver))
+		{
+			debugPrintf("Telnet connection accepted\n");
 		}
+		return true;
 	}
 	return false;
 }
@@ -52,58 +56,167 @@ void TelnetResponder::Terminate(NetworkProtocol protocol, NetworkInterface *inte
 
 void TelnetResponder::ConnectionLost() noexcept
 {
-	if ((responderState == ResponderState::reading) || (responderState == ResponderState::sending))
+	EndSession();
 	{
 		MutexLocker lock(gcodeReplyMutex);
+		replyHead = replyTail = 0;
+	}
+	NetworkResponder::ConnectionLost();
+}
+
+// Start receiving G-code replies
+void TelnetResponder::StartSession() noexcept
+{
+	MutexLocker lock(gcodeReplyMutex);
+	if (!receivingReplies)
+	{
+		receivingReplies = true;
+		numSessions++;
+	}
+}
 
+// Stop receiving G-code replies
+void TelnetResponder::EndSession() noexcept
+{
+	MutexLocker lock(gcodeReplyMutex);
+	if (receivingReplies)
+	{
+		receivingReplies = false;
 		if (numSessions != 0)
 		{
 			numSessions--;
 		}
-		if (gcodeReply != nullptr && clientsServed > numSessions)
+	}
+}
+
+// Return the length of the data after converting \n to \r\n
+/*static*/ size_t TelnetResponder::ConvertedLength(const char *data, size_t length) noexcept
+{
+	size_t convertedLength = length;
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (data[i] == '\n')
 		{
-			// Make sure the G-code reply is freed after it is sent to all clients
-			OutputBuffer::ReleaseAll(gcodeReply);
-			clientsServed = 0;
+			++convertedLength;
 		}
 	}
-
-	NetworkResponder::ConnectionLost();
+	return convertedLength;
 }
 
-bool TelnetResponder::SendGCodeReply() noexcept
+// Decide whether to queue a reply that needs 'lengthNeeded' bytes of buffer space after converting \n to \r\n, returning true if we should queue it.
+// If the reply would fit in our buffer but there isn't enough room because the client is not reading the earlier replies fast enough, drop it.
+// If it is too long to fit even when the buffer is empty, queue as much of it as will fit once the buffer has emptied.
+// The caller must hold gcodeReplyMutex.
+bool TelnetResponder::BeginReply(size_t lengthNeeded) noexcept
 {
-	MutexLocker lock(gcodeReplyMutex);
+	const size_t bytesQueued = ReplyBytesQueued();
+	if (lengthNeeded <= TelnetReplyBufferSize - bytesQueued || (lengthNeeded > TelnetReplyBufferSize && bytesQueued == 0))
+	{
+		replyStart = replyHead;
+		return true;
+	}
+
+	++messagesDropped;
+	++totalMessagesDropped;
+	totalBytesDropped += lengthNeeded;
+	return false;
+}
 
-	if (gcodeReply != nullptr)
+// Copy data to the reply buffer converting \n to \r\n, stopping if the buffer is full. The caller must hold gcodeReplyMutex.
+void TelnetResponder::StoreReply(const char *data, size_t length) noexcept
+{
+	while (length != 0)
 	{
-		bool clearReply = false;
-		clientsServed++;
-		if (clientsServed < numSessions)
+		const char c = *data++;
+		--length;
+		if (c == '\n')
 		{
-			// Yes - make sure the Network class doesn't discard its buffers yet
-			// NB: This must happen here, because NetworkTransaction::Write() might already release OutputBuffers
-			gcodeReply->IncreaseReferences(1);
+			if (ReplyBytesQueued() + 2 > TelnetReplyBufferSize)
+			{
+				break;
+			}
+			replyBuffer[replyHead++ % TelnetReplyBufferSize] = '\r';
 		}
-		else
+		else if (ReplyBytesQueued() == TelnetReplyBufferSize)
 		{
-			// No - clean up again later
-			clearReply = true;
+			break;
 		}
+		replyBuffer[replyHead++ % TelnetReplyBufferSize] = c;
+	}
+}
 
-		if (reprap.Debug(moduleWebserver))
+// Update the statistics after queuing a reply. The caller must hold gcodeReplyMutex.
+void TelnetResponder::EndReply(size_t lengthNeeded) noexcept
+{
+	const size_t lengthStored = replyHead - replyStart;
+	if (lengthStored < lengthNeeded)
+	{
+		totalBytesDropped += lengthNeeded - lengthStored;
+	}
+	const size_t bytesQueued = ReplyBytesQueued();
+	if (bytesQueued > maxReplyBytesQueued)
+	{
+		maxReplyBytesQueued = bytesQueued;
+	}
+	++totalMessagesQueued;
+}
+
+// Queue a message generated by this responder
+void TelnetResponder::QueueText(const char *text) noexcept
+{
+	MutexLocker lock(gcodeReplyMutex);
+	const size_t length = strlen(text);
+	const size_t lengthNeeded = ConvertedLength(text, length);
+	if (BeginReply(lengthNeeded))
+	{
+		StoreReply(text, length);
+		EndReply(lengthNeeded);
+	}
+}
+
+// Send as much of the queued reply data as we can using a single socket write, returning true if we did anything significant.
+// We don't hold gcodeReplyMutex while we write to the socket. Other tasks only store data beyond replyHead and never overwrite unsent data,
+// so the data between replyTail and replyHead stays valid until we advance replyTail.
+bool TelnetResponder::SendReplyData() noexcept
+{
+	size_t tail, bytesToSend;
+	{
+		MutexLocker lock(gcodeReplyMutex);
+
+		const size_t bytesQueued = ReplyBytesQueued();
+		if (bytesQueued == 0)
 		{
-			GetPlatform().MessageF(UsbMessage, "Sending G-Code reply to Telnet client %d of %d (length %u)\n", clientsServed, numSessions, gcodeReply->DataLength());
+			return false;
 		}
 
-		// Send the whole G-Code reply as plain text to the client
-		outStack.Push(gcodeReply);
+		// Send the data up to the end of the buffer, any data that has wrapped round to the start will be sent next time
+		tail = replyTail;
+		bytesToSend = min<size_t>(bytesQueued, TelnetReplyBufferSize - (tail % TelnetReplyBufferSize));
+	}
+
+	const size_t sent = skt->Send(reinterpret_cast<const uint8_t *>(replyBuffer + (tail % TelnetReplyBufferSize)), bytesToSend);
+	if (sent != 0)
+	{
+		{
+			MutexLocker lock(gcodeReplyMutex);
+			if (replyTail == tail && ReplyBytesQueued() >= sent)		// in case the buffer was reset by Disable() while we were sending
+			{
+				replyTail += sent;
+			}
+			++totalSocketWrites;
+		}
+		skt->Send();							// tell the socket to send the data now
+		return true;
+	}
 
-		// Possibly clean up the G-code reply once again
-		if (clearReply)
+	// Check whether the connection has been closed
+	if (!skt->CanSend())
+	{
+		if (reprap.Debug(moduleWebserver))
 		{
-			gcodeReply = nullptr;
+			debugPrintf("Can't send anymore\n");
 		}
+		ConnectionLost();
 		return true;
 	}
 	return false;
@@ -133,20 +246,28 @@ bool TelnetResponder::Spin() noexcept
 		{
 			// Don't send a login prompt if no password is set, so we don't mess up Pronterface
 			responderState = ResponderState::reading;
-			numSessions++;
+			StartSession();
 		}
 		else
 		{
-			outBuf->copy(	"RepRapFirmware Telnet interface\r\n\r\n"
-							"Please enter your password:\r\n"
-							"> "
-						);
-			Commit(ResponderState::authenticating);
+			QueueText(	"RepRapFirmware Telnet interface\r\n\r\n"
+						"Please enter your password:\r\n"
+						"> "
+					 );
+			responderState = ResponderState::authenticating;
 		}
 		return true;
 
 	case ResponderState::authenticating:
+	case ResponderState::reading:
 		{
+			const bool didSomething = SendReplyData();
+			if (responderState == ResponderState::free)
+			{
+				return true;					// we lost the connection while sending
+			}
+
+			// See if we can read anything
 			bool readSomething = false;
 			char c;
 			while (!haveCompleteLine && skt->ReadChar(c))
@@ -161,66 +282,44 @@ bool TelnetResponder::Spin() noexcept
 				return true;
 			}
 
-			if (haveCompleteLine && (outBuf != nullptr || OutputBuffer::Allocate(outBuf)))
+			if (haveCompleteLine)
 			{
-				haveCompleteLine = false;
-				clientPointer = 0;
-				if (reprap.CheckPassword(clientMessage))
+				if (responderState == ResponderState::reading)
 				{
-					numSessions++;
-					outBuf->copy("Log in successful!\r\n");
-					Commit(ResponderState::reading);
+					ProcessLine();
 				}
 				else
 				{
-					outBuf->copy("Invalid password.\r\n> ");
-					Commit(ResponderState::authenticating);
+					haveCompleteLine = false;
+					clientPointer = 0;
+					if (reprap.CheckPassword(clientMessage))
+					{
+						StartSession();
+						QueueText("Log in successful!\r\n");
+						responderState = ResponderState::reading;
+					}
+					else
+					{
+						QueueText("Invalid password.\r\n> ");
+					}
 				}
 				return true;
 			}
-			return readSomething;
+			return didSomething || readSomething;
 		}
 
-	case ResponderState::reading:
-		if (outBuf != nullptr && outBuf->BytesLeft() != 0)
-		{
-			// We have a gcode reply to send
-			Commit(ResponderState::reading);
-			return true;
-		}
+	case ResponderState::sending:
+		// We are closing the session, so send any remaining data and then close the connection
+		if (!SendReplyData() && responderState == ResponderState::sending)
 		{
-			// See if we can read anything
-			bool readSomething = false;
-			char c;
-			while (!haveCompleteLine && skt->ReadChar(c))
-			{
-				CharFromClient(c);
-				readSomething = true;
-			}
-
-			if (!readSomething && !skt->CanRead())
-			{
-				ConnectionLost();
-				return true;
-			}
-
-			if (haveCompleteLine)
-			{
-				ProcessLine();
-				return true;
-			}
-
-			// Try to send the G-code reply (if any)
-			if (SendGCodeReply())
+			MutexLocker lock(gcodeReplyMutex);
+			if (ReplyBytesQueued() == 0)
 			{
-				Commit(ResponderState::reading);
+				skt->Close();
+				skt = nullptr;
+				responderState = ResponderState::free;
 			}
-			return readSomething;
 		}
-
-	case ResponderState::sending:
-		SendGCodeReply();
-		SendData();
 		return true;
 	}
 }
@@ -272,15 +371,11 @@ void TelnetResponder::ProcessLine() noexcept
 	// Special commands for Telnet
 	if (StringEqualsIgnoreCase(clientMessage, "exit") || StringEqualsIgnoreCase(clientMessage, "quit"))
 	{
-		if (outBuf != nullptr || OutputBuffer::Allocate(outBuf))
-		{
-			haveCompleteLine = false;
-			clientPointer = 0;
-			numSessions--;
-
-			outBuf->copy("Goodbye.\r\n");
-			Commit();
-		}
+		haveCompleteLine = false;
+		clientPointer = 0;
+		EndSession();
+		QueueText("Goodbye.\r\n");
+		responderState = ResponderState::sending;
 	}
 	else if (reprap.GetGCodes().GetTelnetInput()->BufferSpaceLeft() >= clientPointer + 1)
 	{
@@ -302,97 +397,105 @@ void TelnetResponder::ProcessLine() noexcept
 {
 	MutexLocker lock(gcodeReplyMutex);
 
-	clientsServed = 0;
 	numSessions = 0;
-	OutputBuffer::ReleaseAll(gcodeReply);
+	for (TelnetResponder *r = telnetResponders; r != nullptr; r = r->nextTelnetResponder)
+	{
+		r->receivingReplies = false;
+		r->replyHead = r->replyTail = 0;
+	}
 }
 
+// Queue a G-code reply to each logged-in client
 /*static*/ void TelnetResponder::HandleGCodeReply(const char *reply) noexcept
 {
 	if (reply != nullptr && numSessions > 0)
 	{
 		MutexLocker lock(gcodeReplyMutex);
 
-		// We need a valid OutputBuffer to start the conversion from NL to CRNL
-		if (gcodeReply == nullptr && !OutputBuffer::Allocate(gcodeReply))
-		{
-			// No more space available to store this reply, stop here
-			return;
-		}
-
-		// Write entire content to new output buffers, but this time with \r\n instead of \n
-		while (*reply != 0)
+		const size_t length = strlen(reply);
+		const size_t lengthNeeded = ConvertedLength(reply, length);
+		for (TelnetResponder *r = telnetResponders; r != nullptr; r = r->nextTelnetResponder)
 		{
-			if (*reply == '\n' && gcodeReply->cat('\r') == 0)
-			{
-				// No more space available, stop here
-				return;
-			}
-			if (gcodeReply->cat(*reply) == 0)
+			if (r->receivingReplies && r->BeginReply(lengthNeeded))
 			{
-				// No more space available, stop here
-				return;
+				r->StoreReply(reply, length);
+				r->EndReply(lengthNeeded);
 			}
-			reply++;
 		}
-
-		// Send it to the clients
-		clientsServed = 0;
 	}
 }
 
+// Queue a G-code reply to each logged-in client. The reply is copied, so we release the output buffers straight away.
 /*static*/ void TelnetResponder::HandleGCodeReply(OutputBuffer *reply) noexcept
 {
 	if (reply != nullptr && numSessions > 0)
 	{
 		MutexLocker lock(gcodeReplyMutex);
 
-		// We need a valid OutputBuffer to start the conversion from NL to CRNL
-		if (gcodeReply == nullptr && !OutputBuffer::Allocate(gcodeReply))
+		// Work out how much space the whole reply needs, so that we drop or keep each reply in its entirety
+		size_t lengthNeeded = 0;
+		for (const OutputBuffer *buf = reply; buf != nullptr; buf = buf->Next())
 		{
-			OutputBuffer::Truncate(reply, OUTPUT_BUFFER_SIZE);
-			if (!OutputBuffer::Allocate(gcodeReply))
-			{
-				// If we're really short on memory, release the G-Code reply instantly
-				OutputBuffer::ReleaseAll(reply);
-				return;
-			}
+			lengthNeeded += ConvertedLength(buf->Data(), buf->DataLength());
 		}
 
-		// Write entire content to new output buffers, but this time with \r\n instead of \n
-		do {
-			const char *data = reply->Data();
-			for(size_t i = 0; i < reply->DataLength(); i++)
+		for (TelnetResponder *r = telnetResponders; r != nullptr; r = r->nextTelnetResponder)
+		{
+			if (r->receivingReplies && r->BeginReply(lengthNeeded))
 			{
-				if (*data == '\n')
+				for (const OutputBuffer *buf = reply; buf != nullptr; buf = buf->Next())
 				{
-					gcodeReply->cat('\r');
+					r->StoreReply(buf->Data(), buf->DataLength());
 				}
-				gcodeReply->cat(*data);
-				data++;
+				r->EndReply(lengthNeeded);
 			}
-			reply = OutputBuffer::Release(reply);
-		} while (reply != nullptr);
-
-		// Send it to the clients
-		clientsServed = 0;
+		}
 	}
-	else
+
+	// Don't store buffers that may be needed elsewhere
+	OutputBuffer::ReleaseAll(reply);
+}
+
+/*static*/ void TelnetResponder::CommonDiagnostics(MessageType mtype) noexcept
+{
+	uint32_t messagesQueued, messagesDropped, bytesDropped, socketWrites;
+	size_t maxQueued;
+	unsigned int sessions;
 	{
-		// Don't store buffers that may never get released...
-		OutputBuffer::ReleaseAll(reply);
+		MutexLocker lock(gcodeReplyMutex);
+		sessions = numSessions;
+		messagesQueued = totalMessagesQueued;
+		messagesDropped = totalMessagesDropped;
+		bytesDropped = totalBytesDropped;
+		socketWrites = totalSocketWrites;
+		maxQueued = maxReplyBytesQueued;
+		totalMessagesQueued = totalMessagesDropped = totalBytesDropped = totalSocketWrites = 0;
+		maxReplyBytesQueued = 0;
 	}
+	GetPlatform().MessageF(mtype, "Telnet sessions: %u of %u, replies queued %" PRIu32 " dropped %" PRIu32 " (%" PRIu32 " bytes), socket writes %" PRIu32 ", max buffer use %u of %u\n",
+							sessions, (unsigned int)NumTelnetResponders, messagesQueued, messagesDropped, bytesDropped, socketWrites, (unsigned int)maxQueued, (unsigned int)TelnetReplyBufferSize);
 }
 
 void TelnetResponder::Diagnostics(MessageType mt) const noexcept
 {
-	GetPlatform().MessageF(mt, " Telnet(%d)", (int)responderState);
+	if (messagesDropped != 0)
+	{
+		GetPlatform().MessageF(mt, " Telnet(%d, dropped %" PRIu32 ")", (int)responderState, messagesDropped);
+	}
+	else
+	{
+		GetPlatform().MessageF(mt, " Telnet(%d)", (int)responderState);
+	}
 }
 
+TelnetResponder *TelnetResponder::telnetResponders = nullptr;
 unsigned int TelnetResponder::numSessions = 0;
-unsigned int TelnetResponder::clientsServed = 0;
-OutputBuffer *TelnetResponder::gcodeReply = nullptr;
 Mutex TelnetResponder::gcodeReplyMutex;
+uint32_t TelnetResponder::totalMessagesQueued = 0;
+uint32_t TelnetResponder::totalMessagesDropped = 0;
+uint32_t TelnetResponder::totalBytesDropped = 0;
+uint32_t TelnetResponder::totalSocketWrites = 0;
+size_t TelnetResponder::maxReplyBytesQueued = 0;
 
 #endif
 
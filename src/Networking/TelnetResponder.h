@@ -9,6 +9,7 @@
 #define SRC_NETWORKING_TELNETRESPONDER_H_
 
 #include "NetworkResponder.h"
+#include "Network.h"
 
 class TelnetResponder : public NetworkResponder
 {
@@ -22,6 +23,7 @@ public:
 	static void Disable() noexcept;
 	static void HandleGCodeReply(const char *reply) noexcept;
 	static void HandleGCodeReply(OutputBuffer *reply) noexcept;
+	static void CommonDiagnostics(MessageType mtype) noexcept;
 	void Diagnostics(MessageType mtype) const noexcept override;
 
 private:
@@ -29,18 +31,44 @@ private:
 	void ProcessLine() noexcept;
 	void ConnectionLost() noexcept override;
 
-	bool SendGCodeReply() noexcept;
+	void StartSession() noexcept;
+	void EndSession() noexcept;
+	void QueueText(const char *text) noexcept;
+	bool BeginReply(size_t lengthNeeded) noexcept;
+	void StoreReply(const char *data, size_t length) noexcept;
+	void EndReply(size_t lengthNeeded) noexcept;
+	bool SendReplyData() noexcept;
+	size_t ReplyBytesQueued() const noexcept { return replyHead - replyTail; }
 
+	static size_t ConvertedLength(const char *data, size_t length) noexcept;
+
+	// Each session has its own reply buffer, so that a slow client can't hold on to output buffers needed by other channels.
+	// Replies are queued here with \n converted to \r\n and sent using at most one socket write per call to Spin.
+	// replyHead and replyTail are free-running counters, so TelnetReplyBufferSize must be a power of 2 for them to work when they wrap round.
+	// They are only accessed with gcodeReplyMutex held.
+	TelnetResponder *nextTelnetResponder;
+	size_t replyHead;
+	size_t replyTail;
+	size_t replyStart;											// the value of replyHead when we started to store the current reply
+	bool receivingReplies;
 	bool haveCompleteLine;
 	char clientMessage[MaxGCodeLength];
 	size_t clientPointer;
 	uint32_t connectTime;
+	uint32_t messagesDropped;									// the number of replies dropped during this session because the client was not reading them fast enough
+	char replyBuffer[TelnetReplyBufferSize];
 
+	static TelnetResponder *telnetResponders;
 	static unsigned int numSessions;
-	static unsigned int clientsServed;
-	static OutputBuffer *gcodeReply;
 	static Mutex gcodeReplyMutex;
 
+	// Statistics reported by M122, all protected by gcodeReplyMutex
+	static uint32_t totalMessagesQueued;
+	static uint32_t totalMessagesDropped;
+	static uint32_t totalBytesDropped;
+	static uint32_t totalSocketWrites;
+	static size_t maxReplyBytesQueued;
+
 	static const uint32_t TelnetSetupDuration = 4000;	// ignore the first Telnet request within this duration (in ms)
 };
 
@@ -8,6 +8,7 @@
 #include "UploadingNetworkResponder.h"
 #include "Socket.h"
 #include <Platform/Platform.h>
+#include "WebFileCache.h"
 
 UploadingNetworkResponder::UploadingNetworkResponder(NetworkResponder *n) noexcept : NetworkResponder(n)
 #if HAS_MASS_STORAGE
@@ -127,6 +128,9 @@ void UploadingNetworkResponder::FinishUpload(uint32_t fileLength, time_t fileLas
 
 				// Rename the uploaded file to it's original name
 				MassStorage::Rename(uploadFilename, origFilename.c_str(), true, true);
+#if SUPPORT_HTTP
+				WebFileCache::Invalidate();										// we may have replaced a web file
+#endif
 
 				if (fileLastModified != 0)
 				{
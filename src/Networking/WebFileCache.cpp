@@ -0,0 +1,153 @@
+/*
+ * WebFileCache.cpp
+ */
+
+#include "WebFileCache.h"
+
+#if SUPPORT_HTTP && HAS_MASS_STORAGE
+
+#include <Platform/Platform.h>
+#include <Storage/MassStorage.h>
+#include <Storage/CRC32.h>
+
+/*static*/ WebFileCache::Entry WebFileCache::entries[WebFileCacheEntries] = { };
+/*static*/ uint32_t WebFileCache::useCounter = 0;
+/*static*/ uint32_t WebFileCache::hits = 0;
+/*static*/ uint32_t WebFileCache::misses = 0;
+/*static*/ uint32_t WebFileCache::notModified = 0;
+/*static*/ uint32_t WebFileCache::lastHits = 0;
+/*static*/ uint32_t WebFileCache::lastMisses = 0;
+/*static*/ uint32_t WebFileCache::lastNotModified = 0;
+
+// FNV-1a hash of the name
+/*static*/ uint32_t WebFileCache::Hash(const char *_ecv_array name) noexcept
+{
+	uint32_t hash = 2166136261u;
+	while (*name != 0)
+	{
+		hash = (hash ^ (uint8_t)*name++) * 16777619u;
+	}
+	return hash;
+}
+
+// Look for a cached entry for the requested name, returning nullptr if there is none or it is too old to trust
+/*static*/ const WebFileCache::Entry *_ecv_null WebFileCache::Find(const char *_ecv_array requestedName) noexcept
+{
+	const uint32_t hash = Hash(requestedName);
+	for (Entry& e : entries)
+	{
+		if (e.requestedName[0] != 0 && e.hash == hash && strcmp(e.requestedName, requestedName) == 0)
+		{
+			if (millis() - e.whenCached < MaxAge)
+			{
+				e.lastUsed = ++useCounter;
+				++hits;
+				return &e;
+			}
+			ReleaseEntry(e);
+			break;
+		}
+	}
+	++misses;
+	return nullptr;
+}
+
+// Add an entry for a file that we have opened. If zip is true then the file we opened is fileName with .gz appended. If the cache is full, replace the least recently used entry.
+// The ETag is a CRC of the file path, length and last modified time, so it changes when the file is replaced.
+/*static*/ const WebFileCache::Entry *_ecv_null WebFileCache::Add(const char *_ecv_array requestedName, const char *_ecv_array fileName, FilePosition length, bool zip) noexcept
+{
+	const size_t requestedNameLength = strlen(requestedName);
+	const size_t fileNameLength = strlen(fileName);
+	if (requestedNameLength > WebFileCacheNameLength || fileNameLength > WebFileCacheNameLength)
+	{
+		return nullptr;
+	}
+
+	String<MaxFilenameLength> path;
+	if (!MassStorage::CombineName(path.GetRef(), Platform::GetWebDir(), fileName) || (zip && path.cat(".gz")))
+	{
+		return nullptr;
+	}
+	const time_t lastModified = MassStorage::GetLastModifiedTime(path.c_str());
+
+	Entry *victim = &entries[0];
+	for (Entry& e : entries)
+	{
+		if (e.requestedName[0] == 0)
+		{
+			victim = &e;
+			break;
+		}
+		if ((int32_t)(e.lastUsed - victim->lastUsed) < 0)
+		{
+			victim = &e;
+		}
+	}
+
+	memcpy(victim->requestedName, requestedName, requestedNameLength + 1);
+	memcpy(victim->fileName, fileName, fileNameLength + 1);
+
+	CRC32 crc;
+	crc.Update(path.c_str(), path.strlen());
+	crc.Update(reinterpret_cast<const char *>(&length), sizeof(length));
+	crc.Update(reinterpret_cast<const char *>(&lastModified), sizeof(lastModified));
+	victim->etag = crc.Get();
+	victim->hash = Hash(requestedName);
+	victim->length = length;
+	victim->zip = zip;
+	victim->whenCached = millis();
+	victim->lastUsed = ++useCounter;
+	return victim;
+}
+
+// Remove an entry, e.g. because we could no longer open the file
+/*static*/ void WebFileCache::Remove(const Entry *entry) noexcept
+{
+	for (Entry& e : entries)
+	{
+		if (&e == entry)
+		{
+			ReleaseEntry(e);
+			break;
+		}
+	}
+}
+
+// Clear the cache. Called when files may have been changed.
+/*static*/ void WebFileCache::Invalidate() noexcept
+{
+	for (Entry& e : entries)
+	{
+		ReleaseEntry(e);
+	}
+}
+
+/*static*/ void WebFileCache::ReleaseEntry(Entry& e) noexcept
+{
+	e.requestedName[0] = 0;
+	e.fileName[0] = 0;
+}
+
+/*static*/ void WebFileCache::Diagnostics(MessageType mtype, Platform& p) noexcept
+{
+	unsigned int numUsed = 0;
+	for (const Entry& e : entries)
+	{
+		if (e.requestedName[0] != 0)
+		{
+			++numUsed;
+		}
+	}
+
+	// The counters are incremented by the Network task, so rather than resetting them we report how much they have changed since last time
+	const uint32_t nowHits = hits, nowMisses = misses, nowNotModified = notModified;
+	p.MessageF(mtype, "Web file cache: entries %u/%u, hits %" PRIu32 ", misses %" PRIu32 ", not modified %" PRIu32 "\n",
+				numUsed, (unsigned int)WebFileCacheEntries, nowHits - lastHits, nowMisses - lastMisses, nowNotModified - lastNotModified);
+	lastHits = nowHits;
+	lastMisses = nowMisses;
+	lastNotModified = nowNotModified;
+}
+
+#endif
+
+// End
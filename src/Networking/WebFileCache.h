@@ -0,0 +1,58 @@
+/*
+ * WebFileCache.h
+ *
+ * Cache of the web files that we have served recently. For each file requested we remember which file we sent (e.g. the gzipped version, or the index page),
+ * its length and its ETag. This lets us answer conditional requests with 304 Not Modified without accessing the SD card,
+ * and open the right file directly instead of trying several alternatives.
+ * This is only accessed by the Network task, apart from Diagnostics() which is called from M122 and only reads it.
+ */
+
+#ifndef SRC_NETWORKING_WEBFILECACHE_H_
+#define SRC_NETWORKING_WEBFILECACHE_H_
+
+#include <RepRapFirmware.h>
+
+#if SUPPORT_HTTP && HAS_MASS_STORAGE
+
+class WebFileCache
+{
+public:
+	struct Entry
+	{
+		char requestedName[WebFileCacheNameLength + 1];	// copy of the name requested, or empty if the entry is unused
+		char fileName[WebFileCacheNameLength + 1];		// copy of the name of the file we found relative to the web directory, without the .gz extension if it is gzipped
+		uint32_t hash;
+		uint32_t etag;
+		uint32_t whenCached;
+		uint32_t lastUsed;
+		FilePosition length;
+		bool zip;									// true if the file is gzipped
+	};
+
+	static const Entry *_ecv_null Find(const char *_ecv_array requestedName) noexcept;
+	static const Entry *_ecv_null Add(const char *_ecv_array requestedName, const char *_ecv_array fileName, FilePosition length, bool zip) noexcept;
+	static void Remove(const Entry *entry) noexcept;
+	static void Invalidate() noexcept;
+	static void NoteNotModified() noexcept { ++notModified; }
+	static void Diagnostics(MessageType mtype, Platform& p) noexcept;
+
+private:
+	// Files may be changed other than by uploading them over the network, so we check cached entries again after this long
+	static constexpr uint32_t MaxAge = 60000;
+
+	static uint32_t Hash(const char *_ecv_array name) noexcept;
+	static void ReleaseEntry(Entry& e) noexcept;
+
+	static Entry entries[WebFileCacheEntries];
+	static uint32_t useCounter;
+	static uint32_t hits;
+	static uint32_t misses;
+	static uint32_t notModified;
+	static uint32_t lastHits;							// the counts when we last reported them, only accessed by Diagnostics()
+	static uint32_t lastMisses;
+	static uint32_t lastNotModified;
+};
+
+#endif
+
+#endif /* SRC_NETWORKING_WEBFILECACHE_H_ */
@@ -0,0 +1,75 @@
+/*
+ * CborEncoder.cpp
+ */
+
+#include "CborEncoder.h"
+
+// Write the initial byte of a data item and its argument, using the shortest encoding. Multi-byte arguments are big-endian.
+/*static*/ void CborEncoder::WriteHead(OutputBuffer *buf, uint8_t majorType, uint64_t val) noexcept
+{
+	char head[9];
+	size_t numArgBytes;
+	uint8_t additionalInfo;
+	if (val < 24)
+	{
+		additionalInfo = (uint8_t)val;
+		numArgBytes = 0;
+	}
+	else if (val <= 0xFF)
+	{
+		additionalInfo = 24;
+		numArgBytes = 1;
+	}
+	else if (val <= 0xFFFF)
+	{
+		additionalInfo = 25;
+		numArgBytes = 2;
+	}
+	else if (val <= 0xFFFFFFFF)
+	{
+		additionalInfo = 26;
+		numArgBytes = 4;
+	}
+	else
+	{
+		additionalInfo = 27;
+		numArgBytes = 8;
+	}
+
+	head[0] = (char)((majorType << 5) | additionalInfo);
+	for (size_t i = numArgBytes; i != 0; --i)
+	{
+		head[i] = (char)(uint8_t)val;
+		val >>= 8;
+	}
+	buf->cat(head, numArgBytes + 1);
+}
+
+/*static*/ void CborEncoder::WriteSigned(OutputBuffer *buf, int32_t val) noexcept
+{
+	if (val < 0)
+	{
+		WriteHead(buf, MajorTypeNegative, (uint64_t)(-(val + 1)));		// a negative integer n is encoded as -1 - n
+	}
+	else
+	{
+		WriteHead(buf, MajorTypeUnsigned, (uint64_t)val);
+	}
+}
+
+/*static*/ void CborEncoder::WriteFloat(OutputBuffer *buf, float val) noexcept
+{
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	const char data[5] = { (char)SinglePrecisionFloat, (char)(bits >> 24), (char)(bits >> 16), (char)(bits >> 8), (char)bits };
+	buf->cat(data, sizeof(data));
+}
+
+// Write a text string. Unlike JSON, no characters need to be escaped.
+/*static*/ void CborEncoder::WriteString(OutputBuffer *buf, const char *_ecv_array s, size_t len) noexcept
+{
+	WriteHead(buf, MajorTypeText, len);
+	buf->cat(s, len);
+}
+
+// End
@@ -0,0 +1,48 @@
+/*
+ * CborEncoder.h
+ *
+ * Functions to write values in Concise Binary Object Representation (RFC 8949).
+ * This is used to send the object model to the SBC in a form that is smaller than JSON and doesn't require floating point numbers to be formatted or parsed.
+ * Objects and arrays are written with indefinite length, because we don't know in advance how many members or elements we will report.
+ */
+
+#ifndef SRC_OBJECTMODEL_CBORENCODER_H_
+#define SRC_OBJECTMODEL_CBORENCODER_H_
+
+#include <RepRapFirmware.h>
+#include <Platform/OutputMemory.h>
+
+class CborEncoder
+{
+public:
+	static void WriteUnsigned(OutputBuffer *buf, uint64_t val) noexcept { WriteHead(buf, MajorTypeUnsigned, val); }
+	static void WriteSigned(OutputBuffer *buf, int32_t val) noexcept;
+	static void WriteFloat(OutputBuffer *buf, float val) noexcept;
+	static void WriteBool(OutputBuffer *buf, bool val) noexcept { buf->cat((char)((val) ? SimpleTrue : SimpleFalse)); }
+	static void WriteNull(OutputBuffer *buf) noexcept { buf->cat((char)SimpleNull); }
+	static void WriteString(OutputBuffer *buf, const char *_ecv_array s, size_t len) noexcept;
+	static void WriteString(OutputBuffer *buf, const char *_ecv_array s) noexcept { WriteString(buf, s, strlen(s)); }
+
+	static void StartMap(OutputBuffer *buf) noexcept { buf->cat((char)StartIndefiniteMap); }
+	static void StartArray(OutputBuffer *buf) noexcept { buf->cat((char)StartIndefiniteArray); }
+	static void WriteEmptyMap(OutputBuffer *buf) noexcept { buf->cat((char)EmptyMap); }
+	static void EndMapOrArray(OutputBuffer *buf) noexcept { buf->cat((char)Break); }
+
+private:
+	static constexpr uint8_t MajorTypeUnsigned = 0;
+	static constexpr uint8_t MajorTypeNegative = 1;
+	static constexpr uint8_t MajorTypeText = 3;
+
+	static constexpr uint8_t EmptyMap = 0xA0;
+	static constexpr uint8_t StartIndefiniteArray = 0x9F;
+	static constexpr uint8_t StartIndefiniteMap = 0xBF;
+	static constexpr uint8_t SimpleFalse = 0xF4;
+	static constexpr uint8_t SimpleTrue = 0xF5;
+	static constexpr uint8_t SimpleNull = 0xF6;
+	static constexpr uint8_t SinglePrecisionFloat = 0xFA;
+	static constexpr uint8_t Break = 0xFF;
+
+	static void WriteHead(OutputBuffer *buf, uint8_t majorType, uint64_t val) noexcept;
+};
+
+#endif /* SRC_OBJECTMODEL_CBORENCODER_H_ */
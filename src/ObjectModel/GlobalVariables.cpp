@@ -7,6 +7,7 @@
 
 #include "GlobalVariables.h"
 #include <Platform/OutputMemory.h>
+#include "CborEncoder.h"
 
 // This function is not used in this class
 const ObjectModelClassDescriptor *GlobalVariables::GetObjectModelClassDescriptor() const noexcept { return nullptr; }
@@ -17,14 +18,29 @@ const ObjectModelClassDescriptor *GlobalVariables::GetObjectModelClassDescriptor
 void GlobalVariables::ReportAsJson(OutputBuffer *buf, ObjectExplorationContext& context, const ObjectModelClassDescriptor * null classDescriptor, uint8_t tableNumber, const char *filter) const noexcept
 		THROWS(GCodeException)
 {
-	buf->cat('{');
+	const bool cbor = context.WantCbor();
+	if (cbor)
+	{
+		CborEncoder::StartMap(buf);
+	}
+	else
+	{
+		buf->cat('{');
+	}
 	if (context.IncreaseDepth())
 	{
 		{
 			ReadLocker locker(lock);			// make sure that no other task modifies the list while we are traversing it
-			vars.IterateWhile([this, buf, &context, classDescriptor, filter](unsigned int index, const Variable& v) noexcept -> bool
+			vars.IterateWhile([this, buf, &context, classDescriptor, filter, cbor](unsigned int index, const Variable& v) noexcept -> bool
 								{
-									buf->catf((index != 0) ? ",\"%s\":" : "\"%s\":", v.GetName().Ptr());
+									if (cbor)
+									{
+										CborEncoder::WriteString(buf, v.GetName().Ptr());
+									}
+									else
+									{
+										buf->catf((index != 0) ? ",\"%s\":" : "\"%s\":", v.GetName().Ptr());
+									}
 									ReportItemAsJsonFull(buf, context, classDescriptor, v.GetValue(), filter);
 									return true;
 								}
@@ -32,7 +48,14 @@ void GlobalVariables::ReportAsJson(OutputBuffer *buf, ObjectExplorationContext&
 		}
 		context.DecreaseDepth();
 	}
-	buf->cat('}');
+	if (cbor)
+	{
+		CborEncoder::EndMapOrArray(buf);
+	}
+	else
+	{
+		buf->cat('}');
+	}
 }
 
 ReadLockedPointer<const VariableSet> GlobalVariables::GetForReading() noexcept
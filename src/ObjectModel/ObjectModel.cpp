@@ -6,6 +6,7 @@
  */
 
 #include "ObjectModel.h"
+#include "CborEncoder.h"
 
 #if SUPPORT_OBJECT_MODEL
 
@@ -24,6 +25,62 @@ namespace StackUsage
 	constexpr uint32_t GetObjectValue_withTable = 48;
 }
 
+// Helper functions to write the parts of a report that differ between JSON and CBOR
+static void ReportNull(OutputBuffer *buf, bool cbor) noexcept
+{
+	if (cbor)
+	{
+		CborEncoder::WriteNull(buf);
+	}
+	else
+	{
+		buf->cat("null");
+	}
+}
+
+static void ReportOpenContainer(OutputBuffer *buf, bool isArray, bool cbor) noexcept
+{
+	if (cbor)
+	{
+		if (isArray)
+		{
+			CborEncoder::StartArray(buf);
+		}
+		else
+		{
+			CborEncoder::StartMap(buf);
+		}
+	}
+	else
+	{
+		buf->cat((isArray) ? '[' : '{');
+	}
+}
+
+static void ReportCloseContainer(OutputBuffer *buf, bool isArray, bool cbor) noexcept
+{
+	if (cbor)
+	{
+		CborEncoder::EndMapOrArray(buf);
+	}
+	else
+	{
+		buf->cat((isArray) ? ']' : '}');
+	}
+}
+
+static void ReportEmptyObject(OutputBuffer *buf, bool cbor) noexcept
+{
+	if (cbor)
+	{
+		CborEncoder::WriteEmptyMap(buf);
+	}
+	else
+	{
+		buf->cat("{}");
+	}
+}
+
 ExpressionValue::ExpressionValue(const MacAddress& mac) noexcept : type((uint32_t)TypeCode::MacAddress_tc), param(mac.HighWord()), uVal(mac.LowWord())
 {
 }
@@ -46,19 +103,35 @@ void ExpressionValue::AppendAsString(const StringRef& str) const noexcept
 		break;
 
 	case TypeCode::Float:
-		str.catf(GetFloatFormatString(), (double)fVal);
+		{
+			char temp[MaxFormattedFloatLength];
+			FormatFloat(temp, fVal, param);
+			str.cat(temp);
+		}
 		break;
 
 	case TypeCode::Uint32:
-		str.catf("%" PRIu32, uVal);			// convert unsigned integer to string
+		{
+			char temp[MaxFormattedIntegerLength];
+			FormatUnsigned(temp, uVal);			// convert unsigned integer to string
+			str.cat(temp);
+		}
 		break;
 
 	case TypeCode::Uint64:
-		str.catf("%" PRIu64, ((uint64_t)param << 32) | uVal);	// convert unsigned integer to string
+		{
+			char temp[MaxFormattedIntegerLength];
+			FormatUnsigned(temp, ((uint64_t)param << 32) | uVal);	// convert unsigned integer to string
+			str.cat(temp);
+		}
 		break;
 
 	case TypeCode::Int32:
-		str.catf("%" PRIi32, uVal);			// convert signed integer to string
+		{
+			char temp[MaxFormattedIntegerLength];
+			FormatSigned(temp, (int32_t)uVal);	// convert signed integer to string
+			str.cat(temp);
+		}
 		break;
 
 	case TypeCode::Bool:
@@ -324,11 +397,11 @@ ObjectModel::ObjectModel() noexcept
 // Constructor used when reporting the OM as JSON
 ObjectExplorationContext::ObjectExplorationContext(const GCodeBuffer *_ecv_null gbp, bool wal, const char *reportFlags, unsigned int initialMaxDepth, size_t initialBufferOffset) noexcept
 	: startMillis(millis()), initialBufOffset(initialBufferOffset), maxDepth(initialMaxDepth), currentDepth(0), startElement(0), nextElement(-1), numIndicesProvided(0), numIndicesCounted(0),
-	  line(-1), column(-1), gb(gbp),
+	  line(-1), column(-1), gb(gbp), resumePoint(nullptr), maxChunkLength(0), jsonLevel(0), resumeLevelsEntered(0), currentArrayLevels(0),
 	  shortForm(false), wantArrayLength(wal), wantExists(false),
 	  includeNonLive(true), includeImportant(false), includeNulls(false),
 	  excludeVerbose(true), excludeObsolete(true),
-	  obsoleteFieldQueried(false)
+	  obsoleteFieldQueried(false), resuming(false), suspended(false), completeArrays(false), cbor(false)
 {
 	while (true)
 	{
@@ -370,6 +443,7 @@ ObjectExplorationContext::ObjectExplorationContext(const GCodeBuffer *_ecv_null
 				++reportFlags;
 			}
 			break;
+		case 'b':							// binary encoding requested by the SBC, handled by the caller
 		case ' ':
 		case ',':
 			break;
@@ -383,11 +457,11 @@ ObjectExplorationContext::ObjectExplorationContext(const GCodeBuffer *_ecv_null
 // Constructor when evaluating expressions
 ObjectExplorationContext::ObjectExplorationContext(const GCodeBuffer *_ecv_null gbp, bool wal, bool wex, int p_line, int p_col) noexcept
 	: startMillis(millis()), initialBufOffset(0), maxDepth(99), currentDepth(0), startElement(0), nextElement(-1), numIndicesProvided(0), numIndicesCounted(0),
-	  line(p_line), column(p_col), gb(gbp),
+	  line(p_line), column(p_col), gb(gbp), resumePoint(nullptr), maxChunkLength(0), jsonLevel(0), resumeLevelsEntered(0), currentArrayLevels(0),
 	  shortForm(false), wantArrayLength(wal), wantExists(wex),
 	  includeNonLive(true), includeImportant(false), includeNulls(false),
 	  excludeVerbose(false), excludeObsolete(false),
-	  obsoleteFieldQueried(false)
+	  obsoleteFieldQueried(false), resuming(false), suspended(false), completeArrays(false), cbor(false)
 {
 }
 
@@ -419,6 +493,17 @@ bool ObjectExplorationContext::ShouldReport(const ObjectModelEntryFlags f) const
 		&& (!excludeObsolete || ((uint8_t)f & (uint8_t)ObjectModelEntryFlags::obsolete) == 0);
 }
 
+// If we are reporting only live values but arrays must be complete, start reporting non-live values too and return true
+bool ObjectExplorationContext::StartCompleteArray() noexcept
+{
+	if (completeArrays && !includeNonLive)
+	{
+		includeNonLive = true;
+		return true;
+	}
+	return false;
+}
+
 GCodeException ObjectExplorationContext::ConstructParseException(const char *msg) const noexcept
 {
 	return GCodeException(line, column, msg);
@@ -449,13 +534,125 @@ void ObjectExplorationContext::CheckStack(uint32_t calledFunctionStackUsage) con
 	SoftwareReset(SoftwareResetReason::stackOverflow, (const uint32_t *)stackPtr);
 }
 
+// Set up to generate a JSON report in chunks. If the resume point says that an earlier call suspended the report, we skip everything reported before that point.
+void ObjectExplorationContext::SetResumePoint(JsonResumePoint& rp, size_t pMaxChunkLength) noexcept
+{
+	resumePoint = &rp;
+	maxChunkLength = pMaxChunkLength;
+	resuming = rp.IsSuspended();
+}
+
+// Record that we are starting to report an object or array, returning true if we are continuing one that was partly reported in an earlier chunk
+bool ObjectExplorationContext::EnterJsonContainer(bool isArray) noexcept
+{
+	if (jsonLevel < JsonResumePoint::MaxDepth)
+	{
+		if (isArray)
+		{
+			currentArrayLevels |= (uint8_t)(1u << jsonLevel);
+		}
+		else
+		{
+			currentArrayLevels &= (uint8_t)~(1u << jsonLevel);
+		}
+	}
+	++jsonLevel;
+
+	if (resuming && jsonLevel <= resumePoint->depth)
+	{
+		resumeLevelsEntered = jsonLevel;
+		return true;
+	}
+	return false;
+}
+
+// Decide what to do with the member or element at 'position' in the current object or array
+JsonItemAction ObjectExplorationContext::StartJsonItem(OutputBuffer *buf, size_t position, bool haveReportedItems) noexcept
+{
+	const unsigned int level = jsonLevel - 1;
+	if (level >= JsonResumePoint::MaxDepth)
+	{
+		return JsonItemAction::report;						// too deeply nested to suspend or resume here
+	}
+	currentPositions[level] = (uint16_t)position;
+
+	if (resuming)
+	{
+		const size_t resumePosition = resumePoint->positions[level];
+		if (position < resumePosition)
+		{
+			return JsonItemAction::skip;
+		}
+		if (position == resumePosition && level + 1 < resumePoint->depth)
+		{
+			return JsonItemAction::report;					// this is the partly-reported object or array that we need to continue
+		}
+		AbandonResume(buf);									// we have reached the resume point, or the item we were part way through has gone
+		return JsonItemAction::report;
+	}
+
+	if (maxChunkLength != 0 && haveReportedItems && buf->Length() >= maxChunkLength)
+	{
+		for (unsigned int i = 0; i <= level; ++i)
+		{
+			resumePoint->positions[i] = currentPositions[i];
+		}
+		resumePoint->positions[level] = (uint16_t)position;
+		resumePoint->arrayLevels = currentArrayLevels;
+		resumePoint->depth = level + 1;
+		suspended = true;
+		return JsonItemAction::suspend;
+	}
+	return JsonItemAction::report;
+}
+
+// Record that we have finished reporting an object or array. The caller writes the closing bracket if the report has not been suspended.
+void ObjectExplorationContext::ExitJsonContainer(OutputBuffer *buf) noexcept
+{
+	if (resuming)
+	{
+		AbandonResume(buf);									// the object or array was shorter than when we suspended the report
+	}
+	--jsonLevel;
+}
+
+// When resuming a report, check whether a value at the resume position is still the same kind of object or array that was partly reported
+bool ObjectExplorationContext::CanContinueInto(const ExpressionValue& val, const char *_ecv_array filter) const noexcept
+{
+	const bool wantArray = resumeLevelsEntered < JsonResumePoint::MaxDepth && (resumePoint->arrayLevels & (1u << resumeLevelsEntered)) != 0;
+	switch (val.GetType())
+	{
+	case TypeCode::ObjectModel_tc:
+		return val.omVal != nullptr && (*filter == '.' || (*filter == 0 && !wantArray));
+
+	case TypeCode::Array:
+		return (*filter == '[') ? (filter[1] != ']' || wantArray) : (*filter == 0 && wantArray);
+
+	default:
+		return false;
+	}
+}
+
+// Stop resuming a report. Close any objects and arrays that were partly reported in an earlier chunk that we have not re-entered, because they have disappeared.
+void ObjectExplorationContext::AbandonResume(OutputBuffer *buf) noexcept
+{
+	for (unsigned int level = resumePoint->depth; level > resumeLevelsEntered; )
+	{
+		--level;
+		ReportCloseContainer(buf, (resumePoint->arrayLevels & (1u << level)) != 0, cbor);
+	}
+	resuming = false;
+}
+
 // Report this object
 void ObjectModel::ReportAsJson(OutputBuffer* buf, ObjectExplorationContext& context, const ObjectModelClassDescriptor * null classDescriptor,
 								uint8_t tableNumber, const char *_ecv_array filter) const THROWS(GCodeException)
 {
 	if (context.IncreaseDepth())
 	{
-		bool added = false;
+		const bool reportingAll = (filter[0] == 0);
+		bool added = reportingAll && context.EnterJsonContainer(false);		// if we are continuing an object that we started in an earlier chunk then we already sent the opening brace
+		size_t position = 0;
 		if (classDescriptor == nullptr)
 		{
 			classDescriptor = GetObjectModelClassDescriptor();
@@ -463,67 +660,128 @@ void ObjectModel::ReportAsJson(OutputBuffer* buf, ObjectExplorationContext& cont
 
 		while (classDescriptor != nullptr)
 		{
-			const uint8_t * const descriptor = classDescriptor->omd;
-			if (tableNumber < descriptor[0])
+			if (filter[0] != 0 && filter[0] != '*')
 			{
-				const ObjectModelTableEntry *tbl = classDescriptor->omt;
-				for (size_t i = 0; i < tableNumber; ++i)
+				// The filter selects a single field, so look it up instead of scanning the whole table
+				const ObjectModelTableEntry * const e = FindObjectModelTableEntry(classDescriptor, tableNumber, filter);
+				if (e != nullptr && context.ShouldReport(e->flags))
 				{
-					tbl += descriptor[i + 1];
+					if (e->ReportAsJson(buf, context, classDescriptor, this, filter, !added))
+					{
+						added = true;
+					}
 				}
-
-				size_t numEntries = descriptor[tableNumber + 1];
-				while (numEntries != 0)
+			}
+			else
+			{
+				const uint8_t * const descriptor = classDescriptor->omd;
+				if (tableNumber < descriptor[0])
 				{
-					if (tbl->Matches(filter, context))
+					const ObjectModelTableEntry *tbl = classDescriptor->omt;
+					for (size_t i = 0; i < tableNumber; ++i)
+					{
+						tbl += descriptor[i + 1];
+					}
+
+					size_t numEntries = descriptor[tableNumber + 1];
+					while (numEntries != 0)
 					{
-						if (tbl->ReportAsJson(buf, context, classDescriptor, this, filter, !added))
+						const JsonItemAction action = (reportingAll) ? context.StartJsonItem(buf, position, added) : JsonItemAction::report;
+						if (action == JsonItemAction::suspend)
 						{
-							added = true;
+							break;
 						}
+						if (action == JsonItemAction::report && tbl->Matches(filter, context))
+						{
+							if (tbl->ReportAsJson(buf, context, classDescriptor, this, filter, !added))
+							{
+								added = true;
+							}
+							if (context.IsSuspended())
+							{
+								break;
+							}
+						}
+						++position;
+						--numEntries;
+						++tbl;
 					}
-					--numEntries;
-					++tbl;
 				}
 			}
-			if (tableNumber != 0)
+			if (tableNumber != 0 || context.IsSuspended())
 			{
 				break;
 			}
 			classDescriptor = classDescriptor->parent;			// do parent table too
 		}
 
-		if (added)
+		if (reportingAll)
 		{
-			if (*filter == 0)
-			{
-				buf->cat('}');
-			}
+			context.ExitJsonContainer(buf);
 		}
-		else
+
+		if (!context.IsSuspended())						// if we suspended the report then we leave the object open and continue it in the next chunk
 		{
-			buf->cat((*filter == 0) ? "{}" : "null");
+			if (added)
+			{
+				if (*filter == 0)
+				{
+					ReportCloseContainer(buf, false, context.WantCbor());
+				}
+			}
+			else if (*filter == 0)
+			{
+				ReportEmptyObject(buf, context.WantCbor());
+			}
+			else
+			{
+				ReportNull(buf, context.WantCbor());
+			}
 		}
 		context.DecreaseDepth();
 	}
 	else
 	{
-		buf->cat("{}");
+		ReportEmptyObject(buf, context.WantCbor());
 	}
 }
 
 // Construct a JSON representation of those parts of the object model requested by the user. This version is called on the root of the tree.
 void ObjectModel::ReportAsJson(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *_ecv_array filter, const char *_ecv_array reportFlags, bool wantArrayLength) const THROWS(GCodeException)
+{
+	JsonResumePoint resumePoint;
+	ReportAsJson(gb, buf, filter, reportFlags, wantArrayLength, resumePoint, 0);
+}
+
+// Construct part of a JSON representation of those parts of the object model requested by the user, continuing from the resume point
+void ObjectModel::ReportAsJson(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *_ecv_array filter, const char *_ecv_array reportFlags, bool wantArrayLength,
+								JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException)
 {
 	const unsigned int defaultMaxDepth = (wantArrayLength) ? 99 : (filter[0] == 0) ? 1 : 99;
 	ObjectExplorationContext context(gb, wantArrayLength, reportFlags, defaultMaxDepth, buf->Length());
+	context.SetResumePoint(resumePoint, maxChunkLength);
 	ReportAsJson(buf, context, nullptr, 0, filter);
-	if (context.GetNextElement() >= 0)
+	if (!context.IsSuspended())
 	{
-		buf->catf(",\"next\":%d", context.GetNextElement());
+		if (context.GetNextElement() >= 0)
+		{
+			buf->catf(",\"next\":%d", context.GetNextElement());
+		}
+		resumePoint.SetComplete();
 	}
 }
 
+// Construct a CBOR representation of those parts of the object model requested by the user. This version is called on the root of the tree.
+// Return the index of the next array element to report if we reported only part of a root array, else -1. The caller adds this to the response envelope.
+int ObjectModel::ReportAsCbor(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *_ecv_array filter, const char *_ecv_array reportFlags, bool wantArrayLength) const THROWS(GCodeException)
+{
+	const unsigned int defaultMaxDepth = (wantArrayLength) ? 99 : (filter[0] == 0) ? 1 : 99;
+	ObjectExplorationContext context(gb, wantArrayLength, reportFlags, defaultMaxDepth, buf->Length());
+	context.SetCborEncoding();
+	ReportAsJson(buf, context, nullptr, 0, filter);
+	return context.GetNextElement();
+}
+
 // Function to report a value or object as JSON
 // This function is recursive, so keep its stack usage low.
 // Most recursive calls are for non-array object values, so handle object values inline to reduce stack usage.
@@ -531,7 +789,11 @@ void ObjectModel::ReportAsJson(const GCodeBuffer *_ecv_null gb, OutputBuffer *bu
 inline void ObjectModel::ReportItemAsJson(OutputBuffer *buf, ObjectExplorationContext& context, const ObjectModelClassDescriptor *classDescriptor,
 											const ExpressionValue& val, const char *_ecv_array filter) const THROWS(GCodeException)
 {
-	if (context.WantArrayLength() && *filter == 0)
+	if (context.IsResuming() && !context.CanContinueInto(val, filter))
+	{
+		context.AbandonResume(buf);					// the value we were part way through reporting in the previous chunk has changed type
+	}
+	else if (context.WantArrayLength() && *filter == 0)
 	{
 		ReportArrayLengthAsJson(buf, context, val);
 	}
@@ -541,7 +803,7 @@ inline void ObjectModel::ReportItemAsJson(OutputBuffer *buf, ObjectExplorationCo
 			|| val.omVal == nullptr					// OM arrays may contain null entries, so we need to handle them here
 		   )
 		{
-			buf->cat("null");
+			ReportNull(buf, context.WantCbor());
 		}
 		else
 		{
@@ -560,33 +822,35 @@ inline void ObjectModel::ReportItemAsJson(OutputBuffer *buf, ObjectExplorationCo
 
 void ObjectModel::ReportArrayLengthAsJson(OutputBuffer *buf, ObjectExplorationContext& context, const ExpressionValue& val) const noexcept
 {
+	size_t length;
 	switch (val.GetType())
 	{
 	case TypeCode::Array:
-		buf->catf("%u", val.omadVal->GetNumElements(this, context));
+		length = val.omadVal->GetNumElements(this, context);
 		break;
 
 	case TypeCode::Bitmap16:
 	case TypeCode::Bitmap32:
-		buf->catf("%u", Bitmap<uint32_t>::MakeFromRaw(val.uVal).CountSetBits());
+		length = Bitmap<uint32_t>::MakeFromRaw(val.uVal).CountSetBits();
 		break;
 
 	case TypeCode::Bitmap64:
-		buf->catf("%u", Bitmap<uint64_t>::MakeFromRaw(val.Get56BitValue()).CountSetBits());
+		length = Bitmap<uint64_t>::MakeFromRaw(val.Get56BitValue()).CountSetBits();
 		break;
 
 	case TypeCode::CString:
-		buf->catf("%u", strlen(val.sVal));
+		length = strlen(val.sVal);
 		break;
 
 	case TypeCode::HeapString:
-		buf->catf("%u", val.shVal.GetLength());
+		length = val.shVal.GetLength();
 		break;
 
 	default:
-		buf->cat("null");
-		break;
+		ReportNull(buf, context.WantCbor());
+		return;
 	}
+	ReportUnsigned(buf, length, context.WantCbor());
 }
 
 // Function to report a value or object as JSON
@@ -594,6 +858,34 @@ void ObjectModel::ReportArrayLengthAsJson(OutputBuffer *buf, ObjectExplorationCo
 void ObjectModel::ReportItemAsJsonFull(OutputBuffer *buf, ObjectExplorationContext& context, const ObjectModelClassDescriptor *null classDescriptor,
 										const ExpressionValue& val, const char *filter) const THROWS(GCodeException)
 {
+	const bool cbor = context.WantCbor();
+	if (cbor)
+	{
+		// Handle the types that CBOR represents differently from JSON, other than numbers and strings which we pass the encoding to
+		switch (val.GetType())
+		{
+		case TypeCode::Bool:
+			CborEncoder::WriteBool(buf, val.bVal);
+			return;
+
+		case TypeCode::Char:
+		case TypeCode::IPAddress_tc:
+		case TypeCode::DateTime_tc:
+		case TypeCode::DriverId_tc:
+		case TypeCode::MacAddress_tc:
+		case TypeCode::Port:
+		case TypeCode::UniqueId_tc:
+#if SUPPORT_CAN_EXPANSION
+		case TypeCode::CanExpansionBoardDetails:
+#endif
+			ReportAsCborString(buf, val);
+			return;
+
+		default:
+			break;
+		}
+	}
+
 	switch (val.GetType())
 	{
 	case TypeCode::Array:
@@ -610,12 +902,12 @@ void ObjectModel::ReportItemAsJsonFull(OutputBuffer *buf, ObjectExplorationConte
 				const int32_t index = StrToI32(filter, &endptr);
 				if (endptr == filter || *endptr != ']' || index < 0 || (size_t)index >= val.omadVal->GetNumElements(this, context))
 				{
-					buf->cat("null");					// avoid returning badly-formed JSON
+					ReportNull(buf, cbor);				// avoid returning badly-formed JSON
 					break;								// invalid syntax, or index out of range
 				}
 				if (*filter == 0)
 				{
-					buf->cat('[');
+					ReportOpenContainer(buf, true, cbor);
 				}
 				context.AddIndex(index);
 				{
@@ -627,7 +919,7 @@ void ObjectModel::ReportItemAsJsonFull(OutputBuffer *buf, ObjectExplorationConte
 				context.RemoveIndex();
 				if (*filter == 0)
 				{
-					buf->cat(']');
+					ReportCloseContainer(buf, true, cbor);
 				}
 			}
 		}
@@ -637,32 +929,32 @@ void ObjectModel::ReportItemAsJsonFull(OutputBuffer *buf, ObjectExplorationConte
 		}
 		else
 		{
-			buf->cat("null");
+			ReportNull(buf, cbor);
 		}
 		break;
 
 	case TypeCode::Float:
-		ReportFloat(buf, val);
+		ReportFloat(buf, val, cbor);
 		break;
 
 	case TypeCode::Uint32:
-		buf->catf("%" PRIu32, val.uVal);
+		ReportUnsigned(buf, val.uVal, cbor);
 		break;
 
 	case TypeCode::Uint64:
-		buf->catf("%" PRIu64, ((uint64_t)val.param << 32) | val.uVal);	// convert unsigned integer to string
+		ReportUnsigned(buf, ((uint64_t)val.param << 32) | val.uVal, cbor);
 		break;
 
 	case TypeCode::Int32:
-		buf->catf("%" PRIi32, val.iVal);
+		ReportSigned(buf, val.iVal, cbor);
 		break;
 
 	case TypeCode::CString:
-		buf->catf("\"%.s\"", val.sVal);
+		ReportString(buf, val.sVal, cbor);
 		break;
 
 	case TypeCode::HeapString:
-		buf->catf("\"%.s\"", val.shVal.Get().Ptr());
+		ReportString(buf, val.shVal.Get().Ptr(), cbor);
 		break;
 
 #if SUPPORT_CAN_EXPANSION
@@ -688,21 +980,21 @@ void ObjectModel::ReportItemAsJsonFull(OutputBuffer *buf, ObjectExplorationConte
 				int bitNumber;
 				if (endptr == filter || *endptr != ']' || index < 0 || (bitNumber = bm.GetSetBitNumber(index)) < 0)
 				{
-					buf->cat("null");				// avoid returning badly-formed JSON
+					ReportNull(buf, cbor);			// avoid returning badly-formed JSON
 					break;							// invalid syntax, or index out of range
 				}
-				buf->catf("%d", bitNumber);
+				ReportUnsigned(buf, (unsigned int)bitNumber, cbor);
 				break;
 			}
 		}
 		else if (context.ShortFormReport())
 		{
-			buf->catf("%" PRIu32, val.uVal);
+			ReportUnsigned(buf, val.uVal, cbor);
 			break;
 		}
 
 		// If we get here then we want a long form report
-		ReportBitmap1632Long(buf, val);
+		ReportBitmap1632Long(buf, val, cbor);
 		break;
 
 	case TypeCode::Bitmap64:
@@ -721,31 +1013,31 @@ void ObjectModel::ReportItemAsJsonFull(OutputBuffer *buf, ObjectExplorationConte
 				int bitNumber;
 				if (endptr == filter || *endptr != ']' || index < 0 || (bitNumber = bm.GetSetBitNumber(index)) < 0)
 				{
-					buf->cat("null");				// avoid returning badly-formed JSON
+					ReportNull(buf, cbor);			// avoid returning badly-formed JSON
 					break;							// invalid syntax, or index out of range
 				}
-				buf->catf("%d", bitNumber);
+				ReportUnsigned(buf, (unsigned int)bitNumber, cbor);
 				break;
 			}
 		}
 		else if (context.ShortFormReport())
 		{
-			buf->catf("%" PRIu64, val.Get56BitValue());
+			ReportUnsigned(buf, val.Get56BitValue(), cbor);
 			break;
 		}
 
 		// If we get here then we want a long form report
-		ReportBitmap64Long(buf, val);
+		ReportBitmap64Long(buf, val, cbor);
 		break;
 
 	case TypeCode::Enum32:
 		if (context.ShortFormReport())
 		{
-			buf->catf("%" PRIu32, val.uVal);
+			ReportUnsigned(buf, val.uVal, cbor);
 		}
 		else
 		{
-			buf->cat("\"unimplemented\"");
+			ReportString(buf, "unimplemented", cbor);
 			// TODO append the real name
 		}
 		break;
@@ -796,14 +1088,14 @@ void ObjectModel::ReportItemAsJsonFull(OutputBuffer *buf, ObjectExplorationConte
 		switch ((ExpressionValue::SpecialType)val.param)
 		{
 		case ExpressionValue::SpecialType::sysDir:
-			buf->catf("\"%.s\"", reprap.GetPlatform().GetSysDir().Ptr());
+			ReportString(buf, reprap.GetPlatform().GetSysDir().Ptr(), cbor);
 			break;
 		}
 #endif
 		break;
 
 	case TypeCode::None:
-		buf->cat("null");
+		ReportNull(buf, cbor);
 		break;
 
 	case TypeCode::Port:
@@ -835,35 +1127,81 @@ void ObjectModel::ReportPinNameAsJson(OutputBuffer *buf, const ExpressionValue&
 void ObjectModel::ReportArrayAsJson(OutputBuffer *buf, ObjectExplorationContext& context, const ObjectModelClassDescriptor *null classDescriptor,
 										const ObjectModelArrayDescriptor *omad, const char *_ecv_array filter) const THROWS(GCodeException)
 {
-	const bool isRootArray = (buf->Length() == context.GetInitialBufferOffset());		// it's a root array if we haven't started writing to the buffer yet
+	// It's a root array if we are not inside another object or array and we haven't started writing to the buffer yet
+	const bool isRootArray = (context.GetJsonLevel() == 0 && buf->Length() == context.GetInitialBufferOffset());
 	ReadLocker lock(omad->lockPointer);
 
-	buf->cat('[');
+	bool added = context.EnterJsonContainer(true);		// if we are continuing an array that we started in an earlier chunk then we already sent the opening bracket
+	if (!added)
+	{
+		ReportOpenContainer(buf, true, context.WantCbor());
+	}
+	const bool reportingComplete = context.StartCompleteArray();
 	const size_t count = omad->GetNumElements(this, context);
 	const size_t startElement = (isRootArray) ? context.GetStartElement() : 0;
 	for (size_t i = startElement; i < count; ++i)
 	{
+		const JsonItemAction action = context.StartJsonItem(buf, i, added);
+		if (action == JsonItemAction::skip)
+		{
+			continue;
+		}
+		if (action == JsonItemAction::suspend)
+		{
+			break;
+		}
+
 		// Support retrieving just part of the array in case it is too large to write all of it to the buffer
-		if (i != startElement)
+		if (added)
 		{
-			if (isRootArray && buf->Length() >= (OUTPUT_BUFFER_SIZE * (OUTPUT_BUFFER_COUNT - RESERVED_OUTPUT_BUFFERS))/2)
+			if (isRootArray && buf->Length() >= (OUTPUT_BUFFER_TOTAL_SIZE - (OUTPUT_BUFFER_SIZE * RESERVED_OUTPUT_BUFFERS))/2)
 			{
 				// We've used half the buffer space already, so stop reporting
 				context.SetNextElement(i);
 				break;
 			}
-			buf->cat(',');
+			if (!context.WantCbor())
+			{
+				buf->cat(',');
+			}
 		}
+		added = true;
 		context.AddIndex(i);
 		const ExpressionValue element = omad->GetElement(this, context);
 		ReportItemAsJson(buf, context, classDescriptor, element, filter);
 		context.RemoveIndex();
+		if (context.IsSuspended())
+		{
+			break;
+		}
 	}
-	if (isRootArray && context.GetNextElement() < 0)
+	context.EndCompleteArray(reportingComplete);
+	context.ExitJsonContainer(buf);
+	if (!context.IsSuspended())
+	{
+		if (isRootArray && context.GetNextElement() < 0)
+		{
+			context.SetNextElement(0);
+		}
+		ReportCloseContainer(buf, true, context.WantCbor());
+	}
+}
+
+// Cache of the results of object model table lookups, indexed by a hash of the table address and the field name.
+// The tables are constant, so an entry never becomes invalid. We check that a cached entry belongs to the table being searched and has the requested name,
+// so hash collisions and concurrent updates from different tasks can only cause cache misses, not wrong results.
+static const ObjectModelTableEntry *_ecv_null objectModelLookupCache[ObjectModelLookupCacheSize] = { 0 };
+static_assert((ObjectModelLookupCacheSize & (ObjectModelLookupCacheSize - 1)) == 0);
+
+// Hash the table address and the first element of the ID string (FNV-1a)
+static size_t GetLookupCacheSlot(const ObjectModelTableEntry *tbl, const char *_ecv_array idString) noexcept
+{
+	uint32_t hash = 2166136261u ^ reinterpret_cast<uint32_t>(tbl);
+	while (*idString != 0 && *idString != '.' && *idString != '[' && *idString != '^')
 	{
-		context.SetNextElement(0);
+		hash = (hash ^ (uint8_t)*idString++) * 16777619u;
 	}
-	buf->cat(']');
+	return (hash ^ (hash >> 16)) & (ObjectModelLookupCacheSize - 1);
 }
 
 // Find the requested entry
@@ -882,6 +1220,20 @@ const ObjectModelTableEntry* ObjectModel::FindObjectModelTableEntry(const Object
 	}
 
 	const size_t numEntries = descriptor[tableNumber + 1];
+
+	// An empty or wildcard ID matches any entry, so don't use the cache for those
+	const bool useCache = (idString[0] != 0 && idString[0] != '*');
+	size_t cacheSlot = 0;
+	if (useCache)
+	{
+		cacheSlot = GetLookupCacheSlot(tbl, idString);
+		const ObjectModelTableEntry *_ecv_null const cached = objectModelLookupCache[cacheSlot];
+		if (cached != nullptr && cached >= tbl && cached < tbl + numEntries && cached->IdCompare(idString) == 0)
+		{
+			return cached;
+		}
+	}
+
 	size_t low = 0, high = numEntries;
 	while (high > low)
 	{
@@ -889,6 +1241,10 @@ const ObjectModelTableEntry* ObjectModel::FindObjectModelTableEntry(const Object
 		const int t = tbl[mid].IdCompare(idString);
 		if (t == 0)
 		{
+			if (useCache)
+			{
+				objectModelLookupCache[cacheSlot] = &tbl[mid];
+			}
 			return &tbl[mid];
 		}
 		if (t > 0)
@@ -902,6 +1258,10 @@ const ObjectModelTableEntry* ObjectModel::FindObjectModelTableEntry(const Object
 	}
 	if (low < numEntries && tbl[low].IdCompare(idString) == 0)
 	{
+		if (useCache)
+		{
+			objectModelLookupCache[cacheSlot] = &tbl[low];
+		}
 		return &tbl[low];
 	}
 	return nullptr;
@@ -930,15 +1290,31 @@ bool ObjectModelTableEntry::ReportAsJson(OutputBuffer* buf, ObjectExplorationCon
 	// The latter is so that field state.messageBox gets reported to PanelDue even if null when the "important" flag is set, so that PanelDue knows when a message has been cleared.
 	if (val.GetType() != TypeCode::None || context.ShouldIncludeNulls() || (context.ShouldIncludeImportant() && ((uint8_t)flags & (uint8_t)ObjectModelEntryFlags::important)))
 	{
-		if (*filter == 0)
+		if (*filter == 0 && !context.IsResuming())		// if we are continuing a value that we started in an earlier chunk then we already sent its name
 		{
-			buf->cat((first) ? "{\"" : ",\"");
-			buf->cat(name);
-			buf->cat("\":");
+			if (context.WantCbor())
+			{
+				if (first)
+				{
+					CborEncoder::StartMap(buf);
+				}
+				CborEncoder::WriteString(buf, name);
+			}
+			else
+			{
+				buf->cat((first) ? "{\"" : ",\"");
+				buf->cat(name);
+				buf->cat("\":");
+			}
 		}
 		self->ReportItemAsJson(buf, context, classDescriptor, val, nextElement);
 		return true;
 	}
+	if (context.IsResuming())
+	{
+		context.AbandonResume(buf);						// the value we were part way through reporting in the previous chunk has gone
+		return true;
+	}
 	return false;
 }
 
@@ -1212,54 +1588,129 @@ void ObjectModel::ReportDateTime(OutputBuffer *buf, const ExpressionValue& val)
 }
 
 // Separate function to avoid a recursive function saving all the FP registers
-void ObjectModel::ReportFloat(OutputBuffer *buf, const ExpressionValue& val) noexcept
+void ObjectModel::ReportFloat(OutputBuffer *buf, const ExpressionValue& val, bool cbor) noexcept
 {
 	if (val.fVal == 0.0)
 	{
-		buf->cat('0');							// replace 0.000... in JSON by 0. This is mostly to save space when writing workplace coordinates.
+		// Replace 0.000... in JSON by 0. This is mostly to save space when writing workplace coordinates.
+		if (cbor)
+		{
+			CborEncoder::WriteUnsigned(buf, 0);
+		}
+		else
+		{
+			buf->cat('0');
+		}
 	}
 	else if (std::isnan(val.fVal) || std::isinf(val.fVal))
 	{
-		buf->cat("null");						// avoid generating bad JSON if the value is a NaN or infinity
+		ReportNull(buf, cbor);					// avoid generating bad JSON if the value is a NaN or infinity
+	}
+	else if (cbor)
+	{
+		CborEncoder::WriteFloat(buf, val.fVal);	// the receiver rounds the value to the number of decimal places it wants to display
 	}
 	else
 	{
-		buf->catf(val.GetFloatFormatString(), (double)val.fVal);
+		char temp[MaxFormattedFloatLength];
+		buf->cat(temp, FormatFloat(temp, val.fVal, val.param));
 	}
 }
 
-void ObjectModel::ReportBitmap1632Long(OutputBuffer *buf, const ExpressionValue& val) noexcept
+// Separate functions to keep the conversion buffers off the stack of the recursive functions
+void ObjectModel::ReportUnsigned(OutputBuffer *buf, uint64_t val, bool cbor) noexcept
+{
+	if (cbor)
+	{
+		CborEncoder::WriteUnsigned(buf, val);
+	}
+	else
+	{
+		char temp[MaxFormattedIntegerLength];
+		buf->cat(temp, FormatUnsigned(temp, val));
+	}
+}
+
+void ObjectModel::ReportSigned(OutputBuffer *buf, int32_t val, bool cbor) noexcept
+{
+	if (cbor)
+	{
+		CborEncoder::WriteSigned(buf, val);
+	}
+	else
+	{
+		char temp[MaxFormattedIntegerLength];
+		buf->cat(temp, FormatSigned(temp, val));
+	}
+}
+
+void ObjectModel::ReportString(OutputBuffer *buf, const char *_ecv_array s, bool cbor) noexcept
+{
+	if (cbor)
+	{
+		CborEncoder::WriteString(buf, s);
+	}
+	else
+	{
+		buf->catf("\"%.s\"", s);				// the %.s format specifier forces JSON escaping
+	}
+}
+
+// Report a value that JSON represents as a string but which doesn't have a string representation that we can pass directly to the CBOR encoder
+// This is a separate function to avoid having a string buffer on the stack of a recursive function
+void ObjectModel::ReportAsCborString(OutputBuffer *buf, const ExpressionValue& val) noexcept
+{
+	String<StringLength50> str;
+	val.AppendAsString(str.GetRef());
+	CborEncoder::WriteString(buf, str.c_str(), str.strlen());
+}
+
+void ObjectModel::ReportBitmap1632Long(OutputBuffer *buf, const ExpressionValue& val, bool cbor) noexcept
 {
 	const auto bm = Bitmap<uint32_t>::MakeFromRaw(val.uVal);
-	buf->cat('[');
+	ReportOpenContainer(buf, true, cbor);
 	bm.Iterate
-		([buf](unsigned int bn, unsigned int count) noexcept
+		([buf, cbor](unsigned int bn, unsigned int count) noexcept
 			{
-				if (count != 0)
+				if (cbor)
 				{
-					buf->cat(',');
+					CborEncoder::WriteUnsigned(buf, bn);
+				}
+				else
+				{
+					if (count != 0)
+					{
+						buf->cat(',');
+					}
+					buf->catf("%u", bn);
 				}
-				buf->catf("%u", bn);
 			}
 		);
-	buf->cat(']');
+	ReportCloseContainer(buf, true, cbor);
 }
 
-void ObjectModel::ReportBitmap64Long(OutputBuffer *buf, const ExpressionValue& val) noexcept
+void ObjectModel::ReportBitmap64Long(OutputBuffer *buf, const ExpressionValue& val, bool cbor) noexcept
 {
 	const auto bm = Bitmap<uint64_t>::MakeFromRaw(val.Get56BitValue());
-	buf->cat('[');
+	ReportOpenContainer(buf, true, cbor);
 	bm.Iterate
-		([buf](unsigned int bn, unsigned int count) noexcept
+		([buf, cbor](unsigned int bn, unsigned int count) noexcept
 			{
-				if (count != 0)
+				if (cbor)
 				{
-					buf->cat(',');
+					CborEncoder::WriteUnsigned(buf, bn);
+				}
+				else
+				{
+					if (count != 0)
+					{
+						buf->cat(',');
+					}
+					buf->catf("%u", bn);
 				}
-				buf->catf("%u", bn);
 			}
 		);
-	buf->cat(']');
+	ReportCloseContainer(buf, true, cbor);
 }
 
 #if SUPPORT_CAN_EXPANSION
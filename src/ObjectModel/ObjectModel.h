@@ -207,6 +207,37 @@ enum class ObjectModelEntryFlags : uint8_t
 	obsolete = 8				// entry is deprecated and should not be used any more
 };
 
+// Class to record where a JSON report that was suspended part way through should continue from, so that a large report can be generated and sent in chunks.
+// Each level holds the position of the next member or element to report in an object or array that was still open when the report was suspended, starting with the outermost one.
+class JsonResumePoint
+{
+public:
+	static constexpr size_t MaxDepth = 8;				// max depth of object and array nesting at which we can suspend a report
+
+	JsonResumePoint() noexcept { Reset(); }
+
+	void Reset() noexcept { depth = 0; complete = false; }
+	void SetComplete() noexcept { depth = 0; complete = true; }
+	bool IsSuspended() const noexcept { return depth != 0; }
+	bool IsComplete() const noexcept { return complete; }
+
+private:
+	friend class ObjectExplorationContext;
+
+	uint16_t positions[MaxDepth];
+	uint8_t arrayLevels;								// bitmap of the levels that are arrays rather than objects
+	uint8_t depth;										// the number of valid entries in 'positions', or zero if we are at the start or the end of the report
+	bool complete;
+};
+
+// Action to take for the next member or element of an object or array when reporting it as JSON
+enum class JsonItemAction : uint8_t
+{
+	report,							// report this item
+	skip,							// skip this item because it was reported in an earlier chunk
+	suspend							// stop here, because we have generated enough output for this chunk
+};
+
 // Context passed to object model functions
 class ObjectExplorationContext
 {
@@ -243,6 +274,27 @@ public:
 	bool ObsoleteFieldQueried() const noexcept { return obsoleteFieldQueried; }
 	void SetObsoleteFieldQueried() noexcept { obsoleteFieldQueried = true; }
 
+	// Functions to support generating large JSON reports in chunks
+	void SetResumePoint(JsonResumePoint& rp, size_t pMaxChunkLength) noexcept;
+	bool EnterJsonContainer(bool isArray) noexcept;
+	JsonItemAction StartJsonItem(OutputBuffer *buf, size_t position, bool haveReportedItems) noexcept;
+	void ExitJsonContainer(OutputBuffer *buf) noexcept;
+	bool CanContinueInto(const ExpressionValue& val, const char *_ecv_array filter) const noexcept;
+	void AbandonResume(OutputBuffer *buf) noexcept;
+	unsigned int GetJsonLevel() const noexcept { return jsonLevel; }
+	bool IsResuming() const noexcept { return resuming; }
+	bool IsSuspended() const noexcept { return suspended; }
+
+	// Functions to support reporting merge patches. In a merge patch an array replaces the client's copy completely, so arrays must always be reported in full.
+	void SetCompleteArrays() noexcept { completeArrays = true; }
+	void SetLiveOnly(bool liveOnly) noexcept { includeNonLive = !liveOnly; }
+	bool StartCompleteArray() noexcept;
+	void EndCompleteArray(bool started) noexcept { if (started) { includeNonLive = false; } }
+
+	// Functions to support reporting in CBOR instead of JSON
+	void SetCborEncoding() noexcept { cbor = true; }
+	bool WantCbor() const noexcept { return cbor; }
+
 	GCodeException ConstructParseException(const char *msg) const noexcept;
 	GCodeException ConstructParseException(const char *msg, const char *sparam) const noexcept;
 	void CheckStack(uint32_t calledFunctionStackUsage) const THROWS(GCodeException);
@@ -262,6 +314,12 @@ private:
 	int line;
 	int column;
 	const GCodeBuffer *_ecv_null gb;
+	JsonResumePoint *_ecv_null resumePoint;			// where to resume from and where we suspended, or nullptr if we are not generating a report in chunks
+	size_t maxChunkLength;							// the buffer length at which we suspend a report, or zero to never suspend it
+	unsigned int jsonLevel;							// the number of JSON objects and arrays that we are inside
+	unsigned int resumeLevelsEntered;				// when resuming a report, the number of levels of partly-reported objects and arrays that we have re-entered
+	uint16_t currentPositions[JsonResumePoint::MaxDepth];
+	uint8_t currentArrayLevels;						// bitmap of the levels in currentPositions that are arrays
 	unsigned int shortForm : 1,
 				wantArrayLength : 1,
 				wantExists : 1,
@@ -270,7 +328,11 @@ private:
 				includeNulls : 1,
 				excludeVerbose : 1,
 				excludeObsolete : 1,
-				obsoleteFieldQueried : 1;
+				obsoleteFieldQueried : 1,
+				resuming : 1,
+				suspended : 1,
+				completeArrays : 1,						// true to report all the members of objects in arrays even if we are reporting only live values
+				cbor : 1;								// true to report in CBOR, false to report in JSON
 };
 
 // Entry to describe an array of objects or values. These must be brace-initializable into flash memory.
@@ -294,6 +356,14 @@ public:
 	// Construct a JSON representation of those parts of the object model requested by the user. This version is called only on the root of the tree.
 	void ReportAsJson(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *_ecv_array filter, const char *_ecv_array reportFlags, bool wantArrayLength) const THROWS(GCodeException);
 
+	// As above but stop at the end of an object member or array element once the buffer holds at least maxChunkLength characters, updating the resume point.
+	// Call it again with the same resume point to continue the report, until resumePoint.IsComplete() returns true.
+	void ReportAsJson(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *_ecv_array filter, const char *_ecv_array reportFlags, bool wantArrayLength,
+						JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException);
+
+	// Construct a CBOR representation of those parts of the object model requested by the user. This walks the object model in the same way as ReportAsJson.
+	int ReportAsCbor(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *_ecv_array filter, const char *_ecv_array reportFlags, bool wantArrayLength) const THROWS(GCodeException);
+
 	// Get the value of an object via the table
 	ExpressionValue GetObjectValueUsingTableNumber(ObjectExplorationContext& context, const ObjectModelClassDescriptor * null classDescriptor, const char *_ecv_array idString, uint8_t tableNumber) const THROWS(GCodeException);
 
@@ -326,9 +396,13 @@ private:
 	// These functions have been separated from ReportItemAsJson to avoid high stack usage in the recursive functions, therefore they must not be inlined
 	__attribute__ ((noinline)) void ReportArrayLengthAsJson(OutputBuffer *buf, ObjectExplorationContext& context, const ExpressionValue& val) const noexcept;
 	__attribute__ ((noinline)) static void ReportDateTime(OutputBuffer *buf, const ExpressionValue& val) noexcept;
-	__attribute__ ((noinline)) static void ReportFloat(OutputBuffer *buf, const ExpressionValue& val) noexcept;
-	__attribute__ ((noinline)) static void ReportBitmap1632Long(OutputBuffer *buf, const ExpressionValue& val) noexcept;
-	__attribute__ ((noinline)) static void ReportBitmap64Long(OutputBuffer *buf, const ExpressionValue& val) noexcept;
+	__attribute__ ((noinline)) static void ReportFloat(OutputBuffer *buf, const ExpressionValue& val, bool cbor) noexcept;
+	__attribute__ ((noinline)) static void ReportUnsigned(OutputBuffer *buf, uint64_t val, bool cbor) noexcept;
+	__attribute__ ((noinline)) static void ReportSigned(OutputBuffer *buf, int32_t val, bool cbor) noexcept;
+	__attribute__ ((noinline)) static void ReportString(OutputBuffer *buf, const char *_ecv_array s, bool cbor) noexcept;
+	__attribute__ ((noinline)) static void ReportAsCborString(OutputBuffer *buf, const ExpressionValue& val) noexcept;
+	__attribute__ ((noinline)) static void ReportBitmap1632Long(OutputBuffer *buf, const ExpressionValue& val, bool cbor) noexcept;
+	__attribute__ ((noinline)) static void ReportBitmap64Long(OutputBuffer *buf, const ExpressionValue& val, bool cbor) noexcept;
 	__attribute__ ((noinline)) static void ReportPinNameAsJson(OutputBuffer *buf, const ExpressionValue& val) noexcept;
 
 #if SUPPORT_CAN_EXPANSION
@@ -8,7 +8,7 @@
 #include "Variable.h"
 #include <Platform/OutputMemory.h>
 
-Variable::Variable(const char *str, ExpressionValue pVal, int8_t pScope) noexcept : name(str), val(pVal), scope(pScope)
+Variable::Variable(const char *str, ExpressionValue pVal, int8_t pScope) noexcept : name(str), val(pVal), nameHash(HashName(str)), scope(pScope)
 {
 }
 
@@ -18,43 +18,140 @@ Variable::~Variable()
 	val.Release();
 }
 
-Variable* VariableSet::Lookup(const char *str) noexcept
+// Calculate the hash of a variable name. This is the FNV-1a hash.
+/*static*/ uint32_t Variable::HashName(const char *_ecv_array str) noexcept
 {
-	LinkedVariable *lv;
-	for (lv = root; lv != nullptr; lv = lv->next)
+	uint32_t hash = 2166136261u;
+	while (*str != 0)
+	{
+		hash = (hash ^ (uint8_t)*str++) * 16777619u;
+	}
+	return hash;
+}
+
+// Find the most recently created variable with the specified name
+VariableSet::LinkedVariable *VariableSet::FindVariable(const char *str) const noexcept
+{
+	const uint32_t hash = Variable::HashName(str);
+	if (index != nullptr)
+	{
+		const size_t mask = indexSize - 1;
+		for (size_t slot = hash & mask; index[slot] != nullptr; slot = (slot + 1) & mask)
+		{
+			LinkedVariable * const lv = index[slot];
+			if (lv->v.GetNameHash() == hash)
+			{
+				auto vname = lv->v.GetName();
+				if (strcmp(vname.Ptr(), str) == 0)
+				{
+					return lv;
+				}
+			}
+		}
+	}
+	else
 	{
-		auto vname = lv->v.GetName();
-		if (strcmp(vname.Ptr(), str) == 0)
+		for (LinkedVariable *lv = root; lv != nullptr; lv = lv->next)
 		{
-			return &(lv->v);
+			if (lv->v.GetNameHash() == hash)
+			{
+				auto vname = lv->v.GetName();
+				if (strcmp(vname.Ptr(), str) == 0)
+				{
+					return lv;
+				}
+			}
 		}
 	}
 	return nullptr;
 }
 
-const Variable* VariableSet::Lookup(const char *str) const noexcept
+// Add a variable to the hash index. If there is already a variable with the same name in the index then replace it if 'replaceSameName' is true, else leave it.
+void VariableSet::AddToIndex(LinkedVariable *lv, bool replaceSameName) noexcept
 {
-	const LinkedVariable *lv;
-	for (lv = root; lv != nullptr; lv = lv->next)
+	const uint32_t hash = lv->v.GetNameHash();
+	const size_t mask = indexSize - 1;
+	size_t slot = hash & mask;
+	while (index[slot] != nullptr)
 	{
-		auto vname = lv->v.GetName();
-		if (strcmp(vname.Ptr(), str) == 0)
+		if (index[slot]->v.GetNameHash() == hash)
 		{
-			return &(lv->v);
+			auto name1 = lv->v.GetName();
+			auto name2 = index[slot]->v.GetName();
+			if (strcmp(name1.Ptr(), name2.Ptr()) == 0)
+			{
+				if (replaceSameName)
+				{
+					index[slot] = lv;
+				}
+				return;
+			}
 		}
+		slot = (slot + 1) & mask;
 	}
-	return nullptr;
+	index[slot] = lv;
+}
+
+// Discard the hash index and create a new one if there are enough variables to make it worthwhile.
+// We do this after variables have been removed instead of using deletion markers, because removing variables is much less common than looking them up.
+void VariableSet::RebuildIndex() noexcept
+{
+	delete[] index;
+	index = nullptr;
+	indexSize = 0;
+	if (numVariables >= MinVariablesToIndex)
+	{
+		size_t newSize = MinIndexSize;
+		while (newSize < 2 * (size_t)numVariables)
+		{
+			newSize <<= 1;
+		}
+		index = new LinkedVariable *[newSize];
+		for (size_t i = 0; i < newSize; ++i)
+		{
+			index[i] = nullptr;
+		}
+		indexSize = newSize;
+
+		// The list is ordered newest first, so don't let older variables with the same name replace newer ones
+		for (LinkedVariable *lv = root; lv != nullptr; lv = lv->next)
+		{
+			AddToIndex(lv, false);
+		}
+	}
+}
+
+Variable* VariableSet::Lookup(const char *str) noexcept
+{
+	LinkedVariable * const lv = FindVariable(str);
+	return (lv == nullptr) ? nullptr : &(lv->v);
+}
+
+const Variable* VariableSet::Lookup(const char *str) const noexcept
+{
+	const LinkedVariable * const lv = FindVariable(str);
+	return (lv == nullptr) ? nullptr : &(lv->v);
 }
 
 void VariableSet::InsertNew(const char *str, ExpressionValue pVal, int8_t pScope) noexcept
 {
 	LinkedVariable * const toInsert = new LinkedVariable(str, pVal, pScope, root);
 	root = toInsert;
+	++numVariables;
+	if (2 * (size_t)numVariables > indexSize)
+	{
+		RebuildIndex();
+	}
+	else
+	{
+		AddToIndex(toInsert, true);
+	}
 }
 
 // Remove all variables with a scope greater than the parameter
 void VariableSet::EndScope(uint8_t blockNesting) noexcept
 {
+	bool removedAny = false;
 	LinkedVariable *prev = nullptr;
 	for (LinkedVariable *lv = root; lv != nullptr; )
 	{
@@ -71,6 +168,8 @@ void VariableSet::EndScope(uint8_t blockNesting) noexcept
 				prev->next = lv;
 			}
 			delete temp;
+			--numVariables;
+			removedAny = true;
 		}
 		else
 		{
@@ -78,28 +177,42 @@ void VariableSet::EndScope(uint8_t blockNesting) noexcept
 			lv = lv->next;
 		}
 	}
+
+	if (removedAny && index != nullptr)
+	{
+		RebuildIndex();
+	}
 }
 
 void VariableSet::Delete(const char *str) noexcept
 {
-	LinkedVariable *prev = nullptr;
-	for (LinkedVariable *lv = root; lv != nullptr; lv = lv->next)
+	LinkedVariable * const toDelete = FindVariable(str);
+	if (toDelete != nullptr)
 	{
-		auto vname = lv->v.GetName();
-		if (strcmp(vname.Ptr(), str) == 0)
+		LinkedVariable *prev = nullptr;
+		for (LinkedVariable *lv = root; lv != nullptr; lv = lv->next)
 		{
-			if (prev == nullptr)
+			if (lv == toDelete)
 			{
-				root = lv->next;
+				if (prev == nullptr)
+				{
+					root = lv->next;
+				}
+				else
+				{
+					prev->next = lv->next;
+				}
+				delete lv;
+				--numVariables;
+				break;
 			}
-			else
-			{
-				prev->next = lv->next;
-			}
-			delete lv;
-			break;
+			prev = lv;
+		}
+
+		if (index != nullptr)
+		{
+			RebuildIndex();
 		}
-		prev = lv;
 	}
 }
 
@@ -111,6 +224,10 @@ void VariableSet::Clear() noexcept
 		root = lv->next;
 		delete lv;
 	}
+	numVariables = 0;
+	delete[] index;
+	index = nullptr;
+	indexSize = 0;
 }
 
 VariableSet::~VariableSet()
@@ -123,7 +240,13 @@ void VariableSet::AssignFrom(VariableSet& other) noexcept
 {
 	Clear();
 	root = other.root;
+	index = other.index;
+	indexSize = other.indexSize;
+	numVariables = other.numVariables;
 	other.root = nullptr;
+	other.index = nullptr;
+	other.indexSize = 0;
+	other.numVariables = 0;
 }
 
 void VariableSet::IterateWhile(function_ref<bool(unsigned int, const Variable&) /*noexcept*/ > func) const noexcept
@@ -22,22 +22,27 @@ public:
 	~Variable();
 
 	ReadLockedPointer<const char> GetName() const noexcept { return name.Get(); }
+	uint32_t GetNameHash() const noexcept { return nameHash; }
 	ExpressionValue GetValue() const noexcept { return val; }
 	int8_t GetScope() const noexcept { return scope; }
 	void Assign(ExpressionValue ev) noexcept { val = ev; }
 
+	static uint32_t HashName(const char *_ecv_array str) noexcept;
+
 private:
 	StringHandle name;
 	ExpressionValue val;
+	uint32_t nameHash;							// hash of the name, so that we rarely need to lock the string heap to compare names
 	int8_t scope;								// -1 for a parameter, else the block nesting level when it was created
 };
 
 // Class to represent a collection of variables.
-// For now this is just a linked list, but it could be changed to a hash table for faster lookup and insertion.
+// The variables are held in a linked list with the most recently created one first. When the set holds more than a few variables,
+// we also maintain an open addressing hash table of pointers to the list entries to speed up lookup.
 class VariableSet
 {
 public:
-	VariableSet() noexcept : root(nullptr) { }
+	VariableSet() noexcept : root(nullptr), index(nullptr), indexSize(0), numVariables(0) { }
 	~VariableSet();
 	VariableSet(const VariableSet&) = delete;
 	VariableSet& operator=(const VariableSet& other) = delete;
@@ -65,7 +70,17 @@ private:
 		Variable v;
 	};
 
+	static constexpr size_t MinVariablesToIndex = 8;			// we don't build a hash index for sets smaller than this
+	static constexpr size_t MinIndexSize = 16;					// must be a power of 2
+
+	LinkedVariable * null FindVariable(const char *_ecv_array str) const noexcept;
+	void AddToIndex(LinkedVariable *lv, bool replaceSameName) noexcept;
+	void RebuildIndex() noexcept;
+
 	LinkedVariable * null root;
+	LinkedVariable * null *_ecv_array null index;				// hash table of pointers into the linked list, or nullptr if there are too few variables
+	uint16_t indexSize;											// number of entries in the hash table, always a power of 2 and at least twice the number of variables
+	uint16_t numVariables;
 };
 
 #endif /* SRC_GCODES_VARIABLE_H_ */
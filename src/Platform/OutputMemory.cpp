@@ -10,13 +10,26 @@
 #include "RepRap.h"
 #include <cstdarg>
 
-/*static*/ OutputBuffer * volatile OutputBuffer::freeOutputBuffers = nullptr;		// Messages may also be sent by ISRs,
-/*static*/ volatile size_t OutputBuffer::usedOutputBuffers = 0;						// so make these volatile.
-/*static*/ volatile size_t OutputBuffer::maxUsedOutputBuffers = 0;
+/*static*/ const uint16_t OutputBuffer::sizeClassCapacities[NumSizeClasses] = { OUTPUT_BUFFER_SMALL_SIZE, OUTPUT_BUFFER_SIZE, OUTPUT_BUFFER_LARGE_SIZE };
+/*static*/ const uint16_t OutputBuffer::sizeClassCounts[NumSizeClasses] = { OUTPUT_BUFFER_SMALL_COUNT, OUTPUT_BUFFER_COUNT, OUTPUT_BUFFER_LARGE_COUNT };
+
+/*static*/ OutputBuffer * volatile OutputBuffer::freeOutputBuffers[NumSizeClasses] = { 0 };	// Messages may also be sent by ISRs,
+/*static*/ volatile size_t OutputBuffer::usedOutputBuffers[NumSizeClasses] = { 0 };			// so make these volatile.
+/*static*/ volatile size_t OutputBuffer::maxUsedOutputBuffers[NumSizeClasses] = { 0 };
+/*static*/ volatile size_t OutputBuffer::sizeClassMisses[NumSizeClasses] = { 0 };
+/*static*/ volatile size_t OutputBuffer::freeBytes = 0;
+
+static_assert(OUTPUT_BUFFER_SMALL_SIZE < OUTPUT_BUFFER_SIZE && OUTPUT_BUFFER_SIZE < OUTPUT_BUFFER_LARGE_SIZE, "Output buffer size classes must be in increasing order of size");
+static_assert(OUTPUT_BUFFER_LARGE_SIZE <= 65535, "Output buffer capacity must fit in 16 bits");
 
 //*************************************************************************************************
 // OutputBuffer class implementation
 
+OutputBuffer::OutputBuffer(OutputBuffer *null n, unsigned int sc, char *_ecv_array pData) noexcept
+	: next(n), data(pData), capacity(sizeClassCapacities[sc]), sizeClass((uint8_t)sc)
+{
+}
+
 void OutputBuffer::Append(OutputBuffer *other) noexcept
 {
 	if (other != nullptr)
@@ -173,11 +186,11 @@ size_t OutputBuffer::copy(const char *_ecv_array src, size_t len) noexcept
 size_t OutputBuffer::cat(const char c) noexcept
 {
 	// See if we can append a char
-	if (last->dataLength == OUTPUT_BUFFER_SIZE)
+	if (last->dataLength == last->capacity)
 	{
 		// No - allocate a new item and copy the data
 		OutputBuffer *nextBuffer;
-		if (!Allocate(nextBuffer))
+		if (!Allocate(nextBuffer, last->NextSizeClass()))
 		{
 			// We cannot store any more data
 			hadOverflow = true;
@@ -216,11 +229,11 @@ size_t OutputBuffer::cat(const char *_ecv_array src, size_t len) noexcept
 	size_t copied = 0;
 	while (copied < len)
 	{
-		if (last->dataLength == OUTPUT_BUFFER_SIZE)
+		if (last->dataLength == last->capacity)
 		{
 			// The last buffer is full
 			OutputBuffer *nextBuffer;
-			if (!Allocate(nextBuffer))
+			if (!Allocate(nextBuffer, last->NextSizeClass()))
 			{
 				// We cannot store any more data, stop here
 				hadOverflow = true;
@@ -235,7 +248,7 @@ size_t OutputBuffer::cat(const char *_ecv_array src, size_t len) noexcept
 				item = item->Next();
 			} while (item != nextBuffer);
 		}
-		const size_t copyLength = min<size_t>(len - copied, OUTPUT_BUFFER_SIZE - last->dataLength);
+		const size_t copyLength = min<size_t>(len - copied, last->capacity - last->dataLength);
 		memcpy(last->data + last->dataLength, src + copied, copyLength);
 		last->dataLength += copyLength;
 		copied += copyLength;
@@ -351,28 +364,60 @@ bool OutputBuffer::WriteToFile(FileData& f) const noexcept
 // Initialise the output buffers manager
 /*static*/ void OutputBuffer::Init() noexcept
 {
-	freeOutputBuffers = nullptr;
-	for (size_t i = 0; i < OUTPUT_BUFFER_COUNT; i++)
+	// Allocate the data for all the buffers in a single block, to avoid the overhead of many small heap allocations
+	char *_ecv_array pData = new char[OUTPUT_BUFFER_TOTAL_SIZE];
+	freeBytes = 0;
+	for (unsigned int sc = 0; sc < NumSizeClasses; ++sc)
 	{
-		freeOutputBuffers = new OutputBuffer(freeOutputBuffers);
+		freeOutputBuffers[sc] = nullptr;
+		for (size_t i = 0; i < sizeClassCounts[sc]; i++)
+		{
+			freeOutputBuffers[sc] = new OutputBuffer(freeOutputBuffers[sc], sc, pData);
+			pData += sizeClassCapacities[sc];
+		}
+		freeBytes += sizeClassCapacities[sc] * sizeClassCounts[sc];
 	}
 }
 
 // Allocates an output buffer instance which can be used for (large) string outputs. This must be thread safe. Not safe to call from interrupts!
+// A new output buffer is a small one. When it fills up, cat() extends the chain with progressively larger buffers.
 /*static*/ bool OutputBuffer::Allocate(OutputBuffer *&buf) noexcept
+{
+	return Allocate(buf, 0);
+}
+
+// Allocate an output buffer of the preferred size class if there is one free, else the next larger class that has one free, else the largest smaller class that has one free
+/*static*/ bool OutputBuffer::Allocate(OutputBuffer *&buf, unsigned int preferredSizeClass) noexcept
 {
 	{
 		TaskCriticalSectionLocker lock;
 
-		buf = freeOutputBuffers;
+		unsigned int sc = preferredSizeClass;
+		buf = freeOutputBuffers[sc];
+		if (buf == nullptr)
+		{
+			++sizeClassMisses[sc];
+			while (buf == nullptr && sc + 1 < NumSizeClasses)
+			{
+				buf = freeOutputBuffers[++sc];
+			}
+			sc = preferredSizeClass;
+			while (buf == nullptr && sc != 0)
+			{
+				buf = freeOutputBuffers[--sc];
+			}
+		}
+
 		if (buf != nullptr)
 		{
-			freeOutputBuffers = buf->next;
-			usedOutputBuffers++;
-			if (usedOutputBuffers > maxUsedOutputBuffers)
+			sc = buf->sizeClass;
+			freeOutputBuffers[sc] = buf->next;
+			usedOutputBuffers[sc]++;
+			if (usedOutputBuffers[sc] > maxUsedOutputBuffers[sc])
 			{
-				maxUsedOutputBuffers = usedOutputBuffers;
+				maxUsedOutputBuffers[sc] = usedOutputBuffers[sc];
 			}
+			freeBytes -= buf->capacity;
 
 			// Initialise the buffer before we release the lock in case another task uses it immediately
 			buf->next = nullptr;
@@ -394,16 +439,17 @@ bool OutputBuffer::WriteToFile(FileData& f) const noexcept
 // Get the number of bytes left for continuous writing
 /*static*/ size_t OutputBuffer::GetBytesLeft(const OutputBuffer *writingBuffer) noexcept
 {
-	const size_t freeBuffers = OUTPUT_BUFFER_COUNT - usedOutputBuffers;
-	const size_t bytesLeft = OUTPUT_BUFFER_SIZE - writingBuffer->last->DataLength();
+	const size_t bytesFree = freeBytes;
+	const size_t bytesLeft = writingBuffer->last->capacity - writingBuffer->last->DataLength();
+	constexpr size_t ReservedBytes = RESERVED_OUTPUT_BUFFERS * OUTPUT_BUFFER_SIZE;
 
-	if (freeBuffers < RESERVED_OUTPUT_BUFFERS)
+	if (bytesFree < ReservedBytes)
 	{
 		// Keep some space left to encapsulate the responses (e.g. via an HTTP header)
 		return bytesLeft;
 	}
 
-	return bytesLeft + (freeBuffers - RESERVED_OUTPUT_BUFFERS) * OUTPUT_BUFFER_SIZE;
+	return bytesLeft + (bytesFree - ReservedBytes);
 }
 
 // Truncate an output buffer to free up more memory. Returns the number of released bytes.
@@ -431,8 +477,8 @@ bool OutputBuffer::WriteToFile(FileData& f) const noexcept
 		}
 
 		// Unlink and free the last entry
+		releasedBytes += lastItem->capacity;
 		ReleaseAll(previousItem->next);
-		releasedBytes += OUTPUT_BUFFER_SIZE;
 	} while (previousItem != buffer && releasedBytes < bytesNeeded);
 
 	// Update all the references to the last item
@@ -457,10 +503,12 @@ bool OutputBuffer::WriteToFile(FileData& f) const noexcept
 	}
 	else
 	{
-		// Otherwise prepend it to the list of free output buffers again
-		buf->next = freeOutputBuffers;
-		freeOutputBuffers = buf;
-		usedOutputBuffers--;
+		// Otherwise prepend it to the list of free output buffers of its size class again
+		const unsigned int sc = buf->sizeClass;
+		buf->next = freeOutputBuffers[sc];
+		freeOutputBuffers[sc] = buf;
+		usedOutputBuffers[sc]--;
+		freeBytes += buf->capacity;
 	}
 	return nextBuffer;
 }
@@ -475,8 +523,13 @@ bool OutputBuffer::WriteToFile(FileData& f) const noexcept
 
 /*static*/ void OutputBuffer::Diagnostics(MessageType mtype) noexcept
 {
-	reprap.GetPlatform().MessageF(mtype, "Used output buffers: %d of %d (%d max)\n",
-			usedOutputBuffers, OUTPUT_BUFFER_COUNT, maxUsedOutputBuffers);
+	for (unsigned int sc = 0; sc < NumSizeClasses; ++sc)
+	{
+		reprap.GetPlatform().MessageF(mtype, "Used %u-byte output buffers: %u of %u (%u max), misses %u\n",
+				(unsigned int)sizeClassCapacities[sc], (unsigned int)usedOutputBuffers[sc], (unsigned int)sizeClassCounts[sc],
+				(unsigned int)maxUsedOutputBuffers[sc], (unsigned int)sizeClassMisses[sc]);
+		sizeClassMisses[sc] = 0;
+	}
 }
 
 //*************************************************************************************************
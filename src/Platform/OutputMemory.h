@@ -21,7 +21,10 @@ const size_t OUTPUT_STACK_DEPTH = 4;	// Number of OutputBuffer chains that can b
 class OutputBuffer
 {
 public:
-	explicit OutputBuffer(OutputBuffer *null n) noexcept : next(n) { }
+	// Output buffers come in several size classes, see Configuration.h
+	static constexpr unsigned int NumSizeClasses = 3;
+
+	OutputBuffer(OutputBuffer *null n, unsigned int sc, char *_ecv_array pData) noexcept;
 	OutputBuffer(const OutputBuffer&) = delete;
 
 	void Append(OutputBuffer *other) noexcept;
@@ -33,6 +36,7 @@ public:
 	const char *_ecv_array Data() const noexcept { return data; }
 	const char *_ecv_array UnreadData() const noexcept { return data + bytesRead; }
 	size_t DataLength() const noexcept { return dataLength; }	// How many bytes have been written to this instance?
+	size_t Capacity() const noexcept { return capacity; }		// How many bytes can this instance hold?
 	size_t Length() const noexcept;								// How many bytes have been written to the whole chain?
 
 	char operator[](size_t index) const noexcept;
@@ -90,9 +94,16 @@ public:
 
 	static void Diagnostics(MessageType mtype) noexcept;
 
-	static unsigned int GetFreeBuffers() noexcept { return OUTPUT_BUFFER_COUNT - usedOutputBuffers; }
+	// Get the amount of free buffer space, in units of the standard buffer size OUTPUT_BUFFER_SIZE
+	static unsigned int GetFreeBuffers() noexcept { return freeBytes/OUTPUT_BUFFER_SIZE; }
 
 private:
+	// Allocate an unused OutputBuffer instance, preferably of the specified size class
+	static bool Allocate(OutputBuffer *&buf, unsigned int preferredSizeClass) noexcept;
+
+	// Get the size class to use to extend a chain of buffers whose last buffer is this one. Skip the next class if the board has no buffers of that class.
+	unsigned int NextSizeClass() const noexcept { return (sizeClass + 1 < NumSizeClasses && sizeClassCounts[sizeClass + 1] != 0) ? sizeClass + 1 : sizeClass; }
+
 	void Clear() noexcept;
 
 	OutputBuffer *null next;
@@ -100,16 +111,23 @@ private:
 
 	uint32_t whenQueued;									// milliseconds timer when this buffer was filled in
 
-	char data[OUTPUT_BUFFER_SIZE];
+	char *_ecv_array data;
 	size_t dataLength, bytesRead;
+	uint16_t capacity;
+	uint8_t sizeClass;
 
 	bool isReferenced;
 	bool hadOverflow;
 	volatile size_t references;
 
-	static OutputBuffer * volatile freeOutputBuffers;		// Messages may be sent by multiple tasks
-	static volatile size_t usedOutputBuffers;				// so make these volatile.
-	static volatile size_t maxUsedOutputBuffers;
+	static const uint16_t sizeClassCapacities[NumSizeClasses];
+	static const uint16_t sizeClassCounts[NumSizeClasses];
+
+	static OutputBuffer * volatile freeOutputBuffers[NumSizeClasses];	// Messages may be sent by multiple tasks
+	static volatile size_t usedOutputBuffers[NumSizeClasses];			// so make these volatile.
+	static volatile size_t maxUsedOutputBuffers[NumSizeClasses];
+	static volatile size_t sizeClassMisses[NumSizeClasses];				// how many times we wanted a buffer of this class but there was none free
+	static volatile size_t freeBytes;
 };
 
 inline uint32_t OutputBuffer::GetAge() const noexcept
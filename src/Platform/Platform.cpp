@@ -43,6 +43,7 @@
 #include <Hardware/I2C.h>
 #include <Hardware/NonVolatileMemory.h>
 #include <Storage/CRC32.h>
+#include <ObjectModel/Variable.h>
 #include <Accelerometers/Accelerometers.h>
 
 #if SAM4E || SAM4S || SAME70
@@ -426,7 +427,7 @@ Platform::Platform() noexcept :
 #endif
 	board(DEFAULT_BOARD_TYPE), active(false), errorCodeBits(0),
 	nextDriveToPoll(0),
-	lastFanCheckTime(0),
+	lastFanCheckTime(0), heldOutputDestination(NoDestinationMessage),
 #if SUPPORT_PANELDUE_FLASH
 	panelDueUpdater(nullptr),
 #endif
@@ -484,6 +485,7 @@ void Platform::Init() noexcept
 	baudRates[0] = MAIN_BAUD_RATE;
 	commsParams[0] = 0;
 	usbMutex.Create("USB");
+	heldOutputMutex.Create("HeldOutput");
 #if SAME5x
     SERIAL_MAIN_DEVICE.Start();
 #elif defined(__LPC17xx__)
@@ -909,6 +911,7 @@ void Platform::Exit() noexcept
 	// Close down USB and serial ports and release output buffers
 	SERIAL_MAIN_DEVICE.end();
 	usbOutput.ReleaseAll();
+	heldOutput.ReleaseAll();
 
 #if HAS_AUX_DEVICES
 	for (AuxDevice& dev : auxDevices)
@@ -2265,24 +2268,46 @@ GCodeResult Platform::DiagnosticTest(GCodeBuffer& gb, const StringRef& reply, Ou
 	case (unsigned int)DiagnosticTestType::TimeCRC32:
 		{
 			const size_t length = (gb.Seen('S')) ? gb.GetUIValue() : 1024;
+#if SAME5x
+			const char *_ecv_array const data = reinterpret_cast<const char *_ecv_array>(HSRAM_ADDR);
+#else
+			const char *_ecv_array const data = reinterpret_cast<const char *_ecv_array>(IRAM_ADDR);	// for the SAME70 this is in the non-cacheable RAM, which is the usual case when computing a CRC
+#endif
 			CRC32 crc;
 			IrqDisable();
 			asm volatile("":::"memory");
 			uint32_t now1 = SysTick->VAL;
-			crc.Update(
-#if SAME5x
-						reinterpret_cast<const char *_ecv_array>(HSRAM_ADDR),
-#else
-						reinterpret_cast<const char *_ecv_array>(IRAM_ADDR),		// for the SAME70 this is in the non-cacheable RAM, which is the usual case when computing a CRC
-#endif
-						length);
+			crc.Update(data, length);
 			uint32_t now2 = SysTick->VAL;
 			asm volatile("":::"memory");
 			IrqEnable();
 			now1 &= 0x00FFFFFF;
 			now2 &= 0x00FFFFFF;
-			uint32_t tim1 = ((now1 > now2) ? now1 : now1 + (SysTick->LOAD & 0x00FFFFFF) + 1) - now2;
-			reply.printf("CRC of %u bytes took %.2fus", length, (double)((1'000'000.0f * (float)tim1)/(float)SystemCoreClock));
+			const uint32_t tim1 = ((now1 > now2) ? now1 : now1 + (SysTick->LOAD & 0x00FFFFFF) + 1) - now2;
+
+			// Time the simple byte-at-a-time table algorithm for comparison, and check that it gives the same result
+			CRC32 crcBytewise;
+			IrqDisable();
+			asm volatile("":::"memory");
+			now1 = SysTick->VAL;
+			for (size_t i = 0; i < length; ++i)
+			{
+				crcBytewise.Update(data[i]);
+			}
+			now2 = SysTick->VAL;
+			asm volatile("":::"memory");
+			IrqEnable();
+			now1 &= 0x00FFFFFF;
+			now2 &= 0x00FFFFFF;
+			const uint32_t tim2 = ((now1 > now2) ? now1 : now1 + (SysTick->LOAD & 0x00FFFFFF) + 1) - now2;
+
+			reply.printf("CRC of %u bytes took %.2fus, byte-wise %.2fus", length,
+							(double)((1'000'000.0f * (float)tim1)/(float)SystemCoreClock), (double)((1'000'000.0f * (float)tim2)/(float)SystemCoreClock));
+			if (crc.Get() != crcBytewise.Get())
+			{
+				reply.catf(", results differ (%08" PRIx32 " vs %08" PRIx32 ")", crc.Get(), crcBytewise.Get());
+				return GCodeResult::error;
+			}
 		}
 		break;
 
@@ -2332,6 +2357,118 @@ GCodeResult Platform::DiagnosticTest(GCodeBuffer& gb, const StringRef& reply, Ou
 #endif
 		break;
 
+	case (unsigned int)DiagnosticTestType::TimeVariableLookup:
+		{
+			// Time looking up every variable in a set of S variables, or of 10, 100 and 500 variables if S is not given.
+			// The list entries come from a freelist so they are never returned to the heap, therefore we limit S and check that there is enough RAM first.
+			static constexpr unsigned int DefaultSetSizes[] = { 10, 100, 500 };
+			static constexpr unsigned int MaxSetSize = 500;
+			unsigned int setSizes[ARRAY_SIZE(DefaultSetSizes)];
+			size_t numSetSizes;
+			if (gb.Seen('S'))
+			{
+				setSizes[0] = gb.GetLimitedUIValue('S', 1, MaxSetSize + 1);
+				numSetSizes = 1;
+			}
+			else
+			{
+				memcpy(setSizes, DefaultSetSizes, sizeof(setSizes));
+				numSetSizes = ARRAY_SIZE(DefaultSetSizes);
+			}
+
+			reply.copy("Variable lookups per second:");
+			for (size_t i = 0; i < numSetSizes; ++i)
+			{
+				const unsigned int numVariables = setSizes[i];
+
+				// Allow for the list entry, up to 4 index entries while the index grows, and the name in the string heap
+				const ptrdiff_t memoryNeeded = numVariables * (sizeof(Variable) + 5 * sizeof(void*) + 16) + 1024;
+				const ptrdiff_t memoryAvailable = Tasks::GetNeverUsedRam();
+				if (memoryNeeded >= memoryAvailable)
+				{
+					reply.catf(" %u vars insufficient RAM (available %d, needed %d)", numVariables, memoryAvailable, memoryNeeded);
+					break;
+				}
+
+				VariableSet vars;
+				String<StringLength20> varName;
+				for (unsigned int j = 0; j < numVariables; ++j)
+				{
+					varName.printf("var%u", j);
+					vars.InsertNew(varName.c_str(), ExpressionValue((int32_t)j), 0);
+				}
+
+				constexpr unsigned int Passes = 4;
+				unsigned int numFound = 0;
+				uint32_t totalTicks = 0;
+				for (unsigned int pass = 0; pass < Passes; ++pass)
+				{
+					for (unsigned int j = 0; j < numVariables; ++j)
+					{
+						varName.printf("var%u", j);
+						const uint32_t startTicks = StepTimer::GetTimerTicks();
+						const bool found = (vars.Lookup(varName.c_str()) != nullptr);
+						totalTicks += StepTimer::GetTimerTicks() - startTicks;
+						if (found)
+						{
+							++numFound;
+						}
+					}
+				}
+				reply.catf(" %u vars %.0f%s", numVariables, (double)((float)(numVariables * Passes) * (float)StepClockRate/(float)max<uint32_t>(totalTicks, 1)),
+							(numFound == numVariables * Passes) ? "" : " ERROR");
+			}
+		}
+		break;
+
+	case (unsigned int)DiagnosticTestType::TimeNumberFormatting:
+		{
+			// Format S pseudo-random values (default 1000) using both FormatFloat and printf, check that the results match, and compare the times taken
+			const unsigned int numValues = (gb.Seen('S')) ? gb.GetLimitedUIValue('S', 1, 100001) : 1000;
+			uint32_t seed = 12345;
+			unsigned int numMismatches = 0;
+			uint32_t fastTicks = 0, printfTicks = 0;
+			for (unsigned int i = 0; i < numValues; ++i)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				const float val = (float)(int32_t)seed * ((i & 1) ? 1.0e-6f : 1.0e-3f);
+				const unsigned int numDigits = i % (MaxFloatDigitsDisplayedAfterPoint + 1);
+				char fastText[MaxFormattedFloatLength], printfText[MaxFormattedFloatLength];
+				const uint32_t startTicks = StepTimer::GetTimerTicks();
+				FormatFloat(fastText, val, numDigits);
+				const uint32_t midTicks = StepTimer::GetTimerTicks();
+				SafeSnprintf(printfText, sizeof(printfText), GetFloatFormatString(val, numDigits), (double)val);
+				const uint32_t endTicks = StepTimer::GetTimerTicks();
+				fastTicks += midTicks - startTicks;
+				printfTicks += endTicks - midTicks;
+				if (strcmp(fastText, printfText) != 0)
+				{
+					if (numMismatches == 0)
+					{
+						reply.printf("Mismatch: %s vs. %s\n", fastText, printfText);
+					}
+					++numMismatches;
+				}
+			}
+			reply.catf("Formatted %u floats: %u mismatches, fast %.1fus, printf %.1fus each", numValues, numMismatches,
+						(double)((float)fastTicks * (1'000'000.0f/(float)StepClockRate)/(float)numValues), (double)((float)printfTicks * (1'000'000.0f/(float)StepClockRate)/(float)numValues));
+
+			// Time a full object model report, which is dominated by number formatting
+			const uint32_t startTicks = StepTimer::GetTimerTicks();
+			OutputBuffer *modelBuf = reprap.GetModelResponse(nullptr, "", "d99vn");
+			const uint32_t modelTicks = StepTimer::GetTimerTicks() - startTicks;
+			if (modelBuf == nullptr)
+			{
+				reply.cat(", object model report failed: no buffers");
+			}
+			else
+			{
+				reply.catf(", object model report %u bytes in %.2fms", modelBuf->Length(), (double)((float)modelTicks * (1000.0f/(float)StepClockRate)));
+				OutputBuffer::ReleaseAll(modelBuf);
+			}
+		}
+		break;
+
 #if HAS_VOLTAGE_MONITOR
 	case (unsigned int)DiagnosticTestType::UndervoltageEvent:
 		reprap.GetGCodes().LowVoltagePause();
@@ -3259,6 +3396,7 @@ void Platform::RawMessage(MessageType type, const char *_ecv_array message) noex
 #endif
 
 	// Send the message to the destinations
+	type = (MessageType)(type & ~DeferMessage(type, message));
 	if ((type & ImmediateAuxMessage) != 0)
 	{
 		SendPanelDueMessage(0, message);
@@ -3339,21 +3477,27 @@ void Platform::Message(const MessageType type, OutputBuffer *buffer) noexcept
 	}
 #endif
 
-	// Now send the message to all the destinations
+	DeliverMessage(type, buffer, DeferMessage(type, buffer));
+}
+
+// Send a message in an OutputBuffer to all its destinations except the ones that we have deferred it for
+void Platform::DeliverMessage(MessageType type, OutputBuffer *buffer, MessageType deferred) noexcept
+{
+	const MessageType destinations = (MessageType)(type & ~deferred);
 	size_t numDestinations = 0;
-	if ((type & (AuxMessage | ImmediateAuxMessage)) != 0)
+	if ((destinations & (AuxMessage | ImmediateAuxMessage)) != 0)
 	{
 		++numDestinations;
 	}
-	if ((type & (UsbMessage | BlockingUsbMessage)) != 0)
+	if ((destinations & (UsbMessage | BlockingUsbMessage)) != 0)
 	{
 		++numDestinations;
 	}
-	if ((type & HttpMessage) != 0)
+	if ((destinations & HttpMessage) != 0)
 	{
 		++numDestinations;
 	}
-	if ((type & TelnetMessage) != 0)
+	if ((destinations & TelnetMessage) != 0)
 	{
 		++numDestinations;
 	}
@@ -3364,7 +3508,7 @@ void Platform::Message(const MessageType type, OutputBuffer *buffer) noexcept
 	}
 #endif
 #ifdef SERIAL_AUX2_DEVICE
-	if ((type & Aux2Message) != 0)
+	if ((destinations & Aux2Message) != 0)
 	{
 		++numDestinations;
 	}
@@ -3378,27 +3522,27 @@ void Platform::Message(const MessageType type, OutputBuffer *buffer) noexcept
 	{
 		buffer->IncreaseReferences(numDestinations - 1);
 
-		if ((type & (AuxMessage | ImmediateAuxMessage)) != 0)
+		if ((destinations & (AuxMessage | ImmediateAuxMessage)) != 0)
 		{
-			AppendAuxReply(0, buffer, ((*buffer)[0] == '{') || (type & RawMessageFlag) != 0);
+			AppendAuxReply(0, buffer, ((*buffer)[0] == '{') || (destinations & RawMessageFlag) != 0);
 		}
 
-		if ((type & HttpMessage) != 0)
+		if ((destinations & HttpMessage) != 0)
 		{
 			reprap.GetNetwork().HandleHttpGCodeReply(buffer);
 		}
 
-		if ((type & TelnetMessage) != 0)
+		if ((destinations & TelnetMessage) != 0)
 		{
 			reprap.GetNetwork().HandleTelnetGCodeReply(buffer);
 		}
 
-		if ((type & Aux2Message) != 0)
+		if ((destinations & Aux2Message) != 0)
 		{
-			AppendAuxReply(1, buffer, ((*buffer)[0] == '{') || (type & RawMessageFlag) != 0);
+			AppendAuxReply(1, buffer, ((*buffer)[0] == '{') || (destinations & RawMessageFlag) != 0);
 		}
 
-		if ((type & (UsbMessage | BlockingUsbMessage)) != 0)
+		if ((destinations & (UsbMessage | BlockingUsbMessage)) != 0)
 		{
 			AppendUsbReply(buffer);
 		}
@@ -3412,6 +3556,95 @@ void Platform::Message(const MessageType type, OutputBuffer *buffer) noexcept
 	}
 }
 
+// Hold back messages to a single destination from everywhere except SendHeldOutput until ReleaseOutput is called, so that nothing gets between the parts of a long reply.
+// Return false if we can't hold messages to this destination, or another reply is already holding output.
+bool Platform::HoldOutput(MessageType destination) noexcept
+{
+	if (destination != HttpMessage && destination != TelnetMessage && destination != UsbMessage)
+	{
+		return false;
+	}
+
+	MutexLocker lock(heldOutputMutex);
+	if (heldOutputDestination != NoDestinationMessage)
+	{
+		return false;
+	}
+	heldOutputDestination = destination;
+	return true;
+}
+
+// Send part of a long reply to the destination whose messages we are holding back
+void Platform::SendHeldOutput(MessageType destination, OutputBuffer *buffer) noexcept
+{
+	DeliverMessage(destination, buffer);
+}
+
+// Stop holding back messages to the destination and send the ones we held. We don't keep the mutex while sending them, because the destinations may lock other mutexes.
+void Platform::ReleaseOutput(MessageType destination) noexcept
+{
+	OutputStack messages;
+	{
+		MutexLocker lock(heldOutputMutex);
+		if (heldOutputDestination != destination)
+		{
+			return;
+		}
+		heldOutputDestination = NoDestinationMessage;
+		messages.Append(heldOutput);
+		heldOutput.Clear();
+	}
+
+	while (!messages.IsEmpty())
+	{
+		const MessageType type = messages.GetFirstItemType();
+		DeliverMessage(type, messages.Pop());
+	}
+}
+
+// If we are holding back messages to any of the destinations of this message, keep a copy of it to send later. Return the destinations that we deferred it for.
+MessageType Platform::DeferMessage(MessageType type, const char *_ecv_array message) noexcept
+{
+	if (heldOutputDestination != NoDestinationMessage)			// test first to see if we can avoid getting the mutex
+	{
+		MutexLocker lock(heldOutputMutex);
+		if ((type & heldOutputDestination) != 0)
+		{
+			// Ensure we have a valid buffer to write to that isn't referenced for other destinations
+			OutputBuffer *buf = heldOutput.GetLastItem();
+			if (buf == nullptr || buf->IsReferenced())
+			{
+				if (OutputBuffer::Allocate(buf) && heldOutput.Push(buf, heldOutputDestination))
+				{
+					buf->cat(message);
+				}
+				// else the message buffer has been released, so discard the message
+			}
+			else
+			{
+				buf->cat(message);
+			}
+			return heldOutputDestination;
+		}
+	}
+	return NoDestinationMessage;
+}
+
+MessageType Platform::DeferMessage(MessageType type, OutputBuffer *buffer) noexcept
+{
+	if (heldOutputDestination != NoDestinationMessage)
+	{
+		MutexLocker lock(heldOutputMutex);
+		if ((type & heldOutputDestination) != 0)
+		{
+			buffer->IncreaseReferences(1);
+			heldOutput.Push(buffer, heldOutputDestination);
+			return heldOutputDestination;
+		}
+	}
+	return NoDestinationMessage;
+}
+
 void Platform::MessageV(MessageType type, const char *_ecv_array fmt, va_list vargs) noexcept
 {
 	String<FormatStringLength> formatString;
@@ -173,6 +173,8 @@ enum class DiagnosticTestType : unsigned int
 	TimeCRC32 = 107,				// time how long it takes to calculate CRC32
 	TimeGetTimerTicks = 108,		// time now long it takes to read the step clock
 	UndervoltageEvent = 109,		// pretend an undervoltage condition has occurred
+	TimeVariableLookup = 110,		// time how long it takes to look up variables in sets of various sizes
+	TimeNumberFormatting = 111,		// check and time conversion of numbers to text, and time a full object model report
 
 #ifdef __LPC17xx__
 	PrintBoardConfiguration = 200,	// Prints out all pin/values loaded from SDCard to configure board
@@ -434,6 +436,11 @@ public:
 	void MessageV(MessageType type, const char *_ecv_array fmt, va_list vargs) noexcept;
 	void DebugMessage(const char *_ecv_array fmt, va_list vargs) noexcept;
 	bool FlushMessages() noexcept;								// Flush messages to USB and aux, returning true if there is more to send
+
+	// Holding back other messages to a destination while a long reply is sent to it in several parts
+	bool HoldOutput(MessageType destination) noexcept;
+	void SendHeldOutput(MessageType destination, OutputBuffer *buffer) noexcept;
+	void ReleaseOutput(MessageType destination) noexcept;
 	void SendAlert(MessageType mt, const char *_ecv_array message, const char *_ecv_array title, int sParam, float tParam, AxesBitmap controls) noexcept;
 	void StopLogging() noexcept;
 
@@ -696,6 +703,9 @@ private:
 	const char *_ecv_array InternalGetSysDir() const noexcept;  				// where the system files are - not thread-safe!
 
 	void RawMessage(MessageType type, const char *_ecv_array message) noexcept;	// called by Message after handling error/warning flags
+	void DeliverMessage(MessageType type, OutputBuffer *buffer, MessageType deferred = NoDestinationMessage) noexcept;
+	MessageType DeferMessage(MessageType type, const char *_ecv_array message) noexcept;
+	MessageType DeferMessage(MessageType type, OutputBuffer *buffer) noexcept;
 
 	float GetCpuTemperature() const noexcept;
 
@@ -870,6 +880,11 @@ private:
 	volatile OutputStack usbOutput;
 	Mutex usbMutex;
 
+	// Messages held back while a reply is sent in several parts
+	volatile OutputStack heldOutput;
+	Mutex heldOutputMutex;
+	MessageType heldOutputDestination;				// the destination that we are holding messages for, or NoDestinationMessage
+
 #if HAS_AUX_DEVICES
 	AuxDevice auxDevices[NumSerialChannels - 1];
 #endif
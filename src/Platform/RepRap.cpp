@@ -18,10 +18,12 @@
 #include "Endstops/ZProbe.h"
 #include "Tasks.h"
 #include <Cache.h>
+#include <General/SafeStrtod.h>
 #include "Fans/FansManager.h"
 #include <Hardware/SoftwareReset.h>
 #include <Hardware/ExceptionHandlers.h>
 #include <Accelerometers/Accelerometers.h>
+#include <ObjectModel/CborEncoder.h>
 #include "Version.h"
 
 #ifdef DUET_NG
@@ -367,7 +369,7 @@ constexpr ObjectModelTableEntry RepRap::objectModelTable[] =
 	{ "timeout",				OBJECT_MODEL_FUNC((int32_t)self->mbox.timeout),							ObjectModelEntryFlags::important },
 	{ "title",					OBJECT_MODEL_FUNC(self->mbox.title.c_str()),							ObjectModelEntryFlags::important },
 
-	// 6. MachineModel.seqs
+	// 6. MachineModel.seqs (this must be table SeqsTableNumber)
 	{ "boards",					OBJECT_MODEL_FUNC((int32_t)self->boardsSeq),							ObjectModelEntryFlags::live },
 #if HAS_MASS_STORAGE || HAS_EMBEDDED_FILES || HAS_SBC_INTERFACE
 	{ "directories",			OBJECT_MODEL_FUNC((int32_t)self->directoriesSeq),						ObjectModelEntryFlags::live },
@@ -427,6 +429,7 @@ ReadWriteLock RepRap::toolListLock;
 RepRap::RepRap() noexcept
 	: boardsSeq(0), directoriesSeq(0), fansSeq(0), heatSeq(0), inputsSeq(0), jobSeq(0), moveSeq(0), globalSeq(0),
 	  networkSeq(0), scannerSeq(0), sensorsSeq(0), spindlesSeq(0), stateSeq(0), toolsSeq(0), volumesSeq(0),
+	  modelChangeCount(0),
 	  toolList(nullptr), currentTool(nullptr), lastWarningMillis(0),
 	  activeExtruders(0), activeToolHeaters(0), numToolsToReport(0),
 	  ticksInSpinState(0), heatTaskIdleTicks(0),
@@ -2557,7 +2560,8 @@ void RepRap::AppendFloatArray(OutputBuffer *buf, const char *name, size_t numVal
 			buf->cat(',');
 		}
 		const float fVal = HideNan(func(i));
-		buf->catf(GetFloatFormatString(fVal, numDecimalDigits), (double)fVal);
+		char temp[MaxFormattedFloatLength];
+		buf->cat(temp, FormatFloat(temp, fVal, numDecimalDigits));
 	}
 	buf->cat(']');
 }
@@ -2603,6 +2607,15 @@ void RepRap::AppendStringArray(OutputBuffer *buf, const char *name, size_t numVa
 // Return a query into the object model, or return nullptr if no buffer available
 // We append a newline to help PanelDue resync after receiving corrupt or incomplete data. DWC ignores it.
 OutputBuffer *RepRap::GetModelResponse(const GCodeBuffer *_ecv_null gb, const char *key, const char *flags) const THROWS(GCodeException)
+{
+	JsonResumePoint resumePoint;
+	return GetModelResponseChunk(gb, key, flags, resumePoint, 0);
+}
+
+// Get the next part of an object model response. Call this repeatedly with the same key, flags and resume point until resumePoint.IsComplete() returns true.
+// Each part except the last one stops at the end of an object member or array element once it holds at least maxChunkLength characters, or never if maxChunkLength is zero.
+// Returns nullptr if we ran out of buffers, in which case the resume point is not changed so the caller may try again later.
+OutputBuffer *RepRap::GetModelResponseChunk(const GCodeBuffer *_ecv_null gb, const char *key, const char *flags, JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException)
 {
 	OutputBuffer *outBuf;
 	if (OutputBuffer::Allocate(outBuf))
@@ -2610,26 +2623,141 @@ OutputBuffer *RepRap::GetModelResponse(const GCodeBuffer *_ecv_null gb, const ch
 		if (key == nullptr) { key = ""; }
 		if (flags == nullptr) { flags = ""; }
 
-		outBuf->printf("{\"key\":\"%.s\",\"flags\":\"%.s\",\"result\":", key, flags);
+		if (!resumePoint.IsSuspended())
+		{
+			outBuf->printf("{\"key\":\"%.s\",\"flags\":\"%.s\",\"result\":", key, flags);
+		}
 
 		const bool wantArrayLength = (*key == '#');
 		if (wantArrayLength)
 		{
 			++key;
+			maxChunkLength = 0;										// the response is short
+		}
+		else if (strchr(key, '*') != nullptr)
+		{
+			maxChunkLength = 0;										// we don't support resuming reports that use wildcards
+		}
+
+		const JsonResumePoint originalResumePoint = resumePoint;
+		try
+		{
+			reprap.ReportAsJson(gb, outBuf, key, flags, wantArrayLength, resumePoint, maxChunkLength);
+			if (resumePoint.IsComplete())
+			{
+				outBuf->cat("}\n");
+			}
+			if (outBuf->HadOverflow())
+			{
+				OutputBuffer::ReleaseAll(outBuf);
+				resumePoint = originalResumePoint;
+			}
+		}
+		catch (...)
+		{
+			OutputBuffer::ReleaseAll(outBuf);
+			resumePoint = originalResumePoint;
+			throw;
+		}
+	}
+
+	return outBuf;
+}
+
+// Return a query into the object model encoded as CBOR instead of JSON, or return nullptr if no buffer available.
+// The envelope is a map with the same members as the JSON response from GetModelResponse.
+OutputBuffer *RepRap::GetModelResponseCbor(const GCodeBuffer *_ecv_null gb, const char *key, const char *flags) const THROWS(GCodeException)
+{
+	OutputBuffer *outBuf;
+	if (OutputBuffer::Allocate(outBuf))
+	{
+		if (key == nullptr) { key = ""; }
+		if (flags == nullptr) { flags = ""; }
+
+		CborEncoder::StartMap(outBuf);
+		CborEncoder::WriteString(outBuf, "key");
+		CborEncoder::WriteString(outBuf, key);
+		CborEncoder::WriteString(outBuf, "flags");
+		CborEncoder::WriteString(outBuf, flags);
+		CborEncoder::WriteString(outBuf, "result");
+
+		const bool wantArrayLength = (*key == '#');
+		if (wantArrayLength)
+		{
+			++key;
+		}
+
+		try
+		{
+			const int nextElement = reprap.ReportAsCbor(gb, outBuf, key, flags, wantArrayLength);
+			if (nextElement >= 0)
+			{
+				CborEncoder::WriteString(outBuf, "next");
+				CborEncoder::WriteUnsigned(outBuf, (unsigned int)nextElement);
+			}
+			CborEncoder::EndMapOrArray(outBuf);
+			if (outBuf->HadOverflow())
+			{
+				OutputBuffer::ReleaseAll(outBuf);
+			}
+		}
+		catch (...)
+		{
+			OutputBuffer::ReleaseAll(outBuf);
+			throw;
+		}
+	}
+
+	return outBuf;
+}
+
+// Get the next part of a JSON merge patch that brings a client's copy of the whole object model up to date.
+// 'clientSeqs' is a list of name:value pairs separated by commas, giving the values of the members of 'seqs' that the client last saw.
+// Call this repeatedly with the same arguments until resumePoint.IsComplete() returns true, as for GetModelResponseChunk.
+OutputBuffer *RepRap::GetModelPatchResponseChunk(const GCodeBuffer *_ecv_null gb, const char *flags, const char *clientSeqs, JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException)
+{
+	return GetModelPatchResponseChunk(gb, flags, clientSeqs, nullptr, resumePoint, maxChunkLength);
+}
+
+// Get the next part of a JSON merge patch that brings a client's copy of the whole object model up to date, given the sequence numbers we recorded when we last sent it a patch
+OutputBuffer *RepRap::GetModelPatchResponseChunk(const GCodeBuffer *_ecv_null gb, const char *flags, const ModelSeqs& clientSeqs, JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException)
+{
+	return GetModelPatchResponseChunk(gb, flags, nullptr, &clientSeqs, resumePoint, maxChunkLength);
+}
+
+// Get the next part of a JSON merge patch using either a list of sequence numbers that the client sent us or the ones we recorded. If we have neither, the patch contains the whole object model.
+// Returns nullptr if we ran out of buffers, in which case the resume point is not changed so the caller may try again later.
+OutputBuffer *RepRap::GetModelPatchResponseChunk(const GCodeBuffer *_ecv_null gb, const char *flags, const char *_ecv_array _ecv_null clientSeqs, const ModelSeqs *_ecv_null clientSeqValues,
+													JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException)
+{
+	OutputBuffer *outBuf;
+	if (OutputBuffer::Allocate(outBuf))
+	{
+		if (flags == nullptr) { flags = ""; }
+
+		if (!resumePoint.IsSuspended())
+		{
+			outBuf->cat("{\"key\":\"\",\"patch\":true,\"result\":");
 		}
 
+		const JsonResumePoint originalResumePoint = resumePoint;
 		try
 		{
-			reprap.ReportAsJson(gb, outBuf, key, flags, wantArrayLength);
-			outBuf->cat("}\n");
+			ReportModelPatchAsJson(gb, outBuf, flags, clientSeqs, clientSeqValues, resumePoint, maxChunkLength);
+			if (resumePoint.IsComplete())
+			{
+				outBuf->cat("}\n");
+			}
 			if (outBuf->HadOverflow())
 			{
 				OutputBuffer::ReleaseAll(outBuf);
+				resumePoint = originalResumePoint;
 			}
 		}
 		catch (...)
 		{
 			OutputBuffer::ReleaseAll(outBuf);
+			resumePoint = originalResumePoint;
 			throw;
 		}
 	}
@@ -2637,6 +2765,126 @@ OutputBuffer *RepRap::GetModelResponse(const GCodeBuffer *_ecv_null gb, const ch
 	return outBuf;
 }
 
+// Report the object model as a merge patch, stopping at the end of a member or array element once the buffer holds at least maxChunkLength characters.
+// We can't track changes to individual values, so we use the sequence numbers to find which top-level keys may have changed.
+// Keys whose sequence number differs from the client's are reported in full. Other keys are reported with their live values only,
+// and keys with no live values are omitted. Arrays are always reported in full, because an array in a merge patch replaces the client's copy. Keys that have no sequence number because they never change are reported only if the client supplied no sequence numbers.
+// Null values are always included, because in a merge patch a missing member leaves the client's value unchanged whereas null removes it.
+void RepRap::ReportModelPatchAsJson(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *flags, const char *_ecv_array _ecv_null clientSeqs, const ModelSeqs *_ecv_null clientSeqValues,
+										JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException)
+{
+	String<StringLength20> patchFlags;
+	if (patchFlags.copy(flags) || patchFlags.cat('n'))
+	{
+		throw GCodeException(-1, -1, "flags string too long");
+	}
+	const bool liveOnlyRequested = (strchr(flags, 'f') != nullptr);
+	ObjectExplorationContext context(gb, false, patchFlags.c_str(), 99, buf->Length());
+	context.SetResumePoint(resumePoint, maxChunkLength);
+	context.SetCompleteArrays();
+	static_assert(SeqsTableNumber < objectModelTableDescriptor[0]);
+
+	const ObjectModelClassDescriptor * const classDescriptor = GetObjectModelClassDescriptor();
+	const ObjectModelTableEntry * const seqsTable = objectModelTable + ArraySum(objectModelTableDescriptor + 1, SeqsTableNumber);
+	const bool haveClientSeqs = (clientSeqValues != nullptr) ? clientSeqValues->valid : (clientSeqs != nullptr && clientSeqs[0] != 0);
+	bool added = context.EnterJsonContainer(false);			// if we are continuing the patch from an earlier chunk then we already sent the opening brace
+	for (size_t i = 0; i < objectModelTableDescriptor[1]; ++i)
+	{
+		const JsonItemAction action = context.StartJsonItem(buf, i, added);
+		if (action == JsonItemAction::suspend)
+		{
+			break;
+		}
+		if (action == JsonItemAction::skip)
+		{
+			continue;
+		}
+
+		const ObjectModelTableEntry& e = objectModelTable[i];
+		bool wanted = true;
+		bool liveOnly = liveOnlyRequested;
+		if (haveClientSeqs)
+		{
+			const ObjectModelTableEntry * const seqEntry = FindObjectModelTableEntry(classDescriptor, SeqsTableNumber, e.GetName());
+			if (seqEntry == nullptr)
+			{
+				wanted = (strcmp(e.GetName(), "seqs") == 0);
+				liveOnly = true;
+			}
+			else
+			{
+				int32_t clientSeq;
+				const ExpressionValue seqVal = seqEntry->func(this, context);
+				if (   seqVal.GetType() == TypeCode::Int32
+					&& ((clientSeqValues != nullptr)
+						? clientSeqValues->values[seqEntry - seqsTable] == (uint16_t)seqVal.iVal
+						: GetClientSeq(clientSeqs, e.GetName(), clientSeq) && clientSeq == seqVal.iVal)
+				   )
+				{
+					liveOnly = true;
+				}
+			}
+		}
+
+		context.SetLiveOnly(liveOnly);
+		if (wanted && context.ShouldReport(e.flags) && context.IncreaseDepth())
+		{
+			if (e.ReportAsJson(buf, context, classDescriptor, this, "", !added))
+			{
+				added = true;
+			}
+			context.DecreaseDepth();
+			if (context.IsSuspended())
+			{
+				break;
+			}
+		}
+	}
+	context.ExitJsonContainer(buf);
+
+	if (!context.IsSuspended())								// if we suspended the report then we leave the object open and continue it in the next chunk
+	{
+		buf->cat((added) ? "}" : "{}");
+		resumePoint.SetComplete();
+	}
+}
+
+// Record the current sequence numbers so that we can later generate a patch that brings a client up to date from this point
+void RepRap::GetModelSeqs(ModelSeqs& seqs) const noexcept
+{
+	static_assert(objectModelTableDescriptor[SeqsTableNumber + 1] <= ModelSeqs::MaxSeqs);
+	ObjectExplorationContext context(nullptr, false, "f", 99, 0);
+	const ObjectModelTableEntry * const tbl = objectModelTable + ArraySum(objectModelTableDescriptor + 1, SeqsTableNumber);
+	for (size_t i = 0; i < objectModelTableDescriptor[SeqsTableNumber + 1]; ++i)
+	{
+		const ExpressionValue val = tbl[i].func(this, context);
+		seqs.values[i] = (val.GetType() == TypeCode::Int32) ? (uint16_t)val.iVal : 0;
+	}
+	seqs.valid = true;
+}
+
+// Find the value of the named sequence number in the list that the client sent
+/*static*/ bool RepRap::GetClientSeq(const char *clientSeqs, const char *name, int32_t& seq) noexcept
+{
+	const size_t nameLength = strlen(name);
+	while (*clientSeqs != 0)
+	{
+		if (strncmp(clientSeqs, name, nameLength) == 0 && clientSeqs[nameLength] == ':')
+		{
+			const char *endp;
+			seq = StrToI32(clientSeqs + nameLength + 1, &endp);
+			return endp != clientSeqs + nameLength + 1;
+		}
+		clientSeqs = strchr(clientSeqs, ',');
+		if (clientSeqs == nullptr)
+		{
+			break;
+		}
+		++clientSeqs;
+	}
+	return false;
+}
+
 #endif
 
 // Send a beep. We send it to both PanelDue and the web interface.
@@ -160,6 +160,21 @@ public:
 
 #if SUPPORT_OBJECT_MODEL
 	OutputBuffer *GetModelResponse(const GCodeBuffer *_ecv_null gb, const char *key, const char *flags) const THROWS(GCodeException);
+	OutputBuffer *GetModelResponseChunk(const GCodeBuffer *_ecv_null gb, const char *key, const char *flags, JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException);
+	OutputBuffer *GetModelResponseCbor(const GCodeBuffer *_ecv_null gb, const char *key, const char *flags) const THROWS(GCodeException);
+	OutputBuffer *GetModelPatchResponseChunk(const GCodeBuffer *_ecv_null gb, const char *flags, const char *clientSeqs, JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException);
+
+	// The values of the members of MachineModel.seqs in table order, used to generate patches for clients whose state we keep track of
+	struct ModelSeqs
+	{
+		static constexpr size_t MaxSeqs = 16;
+
+		uint16_t values[MaxSeqs];
+		bool valid;										// false if the client doesn't have a copy of the object model yet
+	};
+
+	OutputBuffer *GetModelPatchResponseChunk(const GCodeBuffer *_ecv_null gb, const char *flags, const ModelSeqs& clientSeqs, JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException);
+	void GetModelSeqs(ModelSeqs& seqs) const noexcept;
 #endif
 
 	void Beep(unsigned int freq, unsigned int ms) noexcept;
@@ -191,21 +206,22 @@ public:
 
 	void KickHeatTaskWatchdog() noexcept { heatTaskIdleTicks = 0; }
 
-	void BoardsUpdated() noexcept { ++boardsSeq; }
-	void DirectoriesUpdated() noexcept { ++directoriesSeq; }
-	void FansUpdated() noexcept { ++fansSeq; }
-	void GlobalUpdated() noexcept { ++globalSeq; }
-	void HeatUpdated() noexcept { ++heatSeq; }
-	void InputsUpdated() noexcept { ++inputsSeq; }
-	void JobUpdated() noexcept { ++jobSeq; }
-	void MoveUpdated() noexcept { ++moveSeq; }
-	void NetworkUpdated() noexcept { ++networkSeq; }
-	void ScannerUpdated() noexcept { ++scannerSeq; }
-	void SensorsUpdated() noexcept { ++sensorsSeq; }
-	void SpindlesUpdated() noexcept { ++spindlesSeq; }
-	void StateUpdated() noexcept { ++stateSeq; }
-	void ToolsUpdated() noexcept { ++toolsSeq; }
-	void VolumesUpdated() noexcept { ++volumesSeq; }
+	void BoardsUpdated() noexcept { ++boardsSeq; ++modelChangeCount; }
+	void DirectoriesUpdated() noexcept { ++directoriesSeq; ++modelChangeCount; }
+	void FansUpdated() noexcept { ++fansSeq; ++modelChangeCount; }
+	void GlobalUpdated() noexcept { ++globalSeq; ++modelChangeCount; }
+	void HeatUpdated() noexcept { ++heatSeq; ++modelChangeCount; }
+	void InputsUpdated() noexcept { ++inputsSeq; ++modelChangeCount; }
+	void JobUpdated() noexcept { ++jobSeq; ++modelChangeCount; }
+	void MoveUpdated() noexcept { ++moveSeq; ++modelChangeCount; }
+	void NetworkUpdated() noexcept { ++networkSeq; ++modelChangeCount; }
+	void ScannerUpdated() noexcept { ++scannerSeq; ++modelChangeCount; }
+	void SensorsUpdated() noexcept { ++sensorsSeq; ++modelChangeCount; }
+	void SpindlesUpdated() noexcept { ++spindlesSeq; ++modelChangeCount; }
+	void StateUpdated() noexcept { ++stateSeq; ++modelChangeCount; }
+	void ToolsUpdated() noexcept { ++toolsSeq; ++modelChangeCount; }
+	void VolumesUpdated() noexcept { ++volumesSeq; ++modelChangeCount; }
+	uint32_t GetModelChangeCount() const noexcept { return modelChangeCount; }	// this changes whenever any of the above sequence numbers changes
 
 	ReadLockedPointer<const VariableSet> GetGlobalVariablesForReading() noexcept { return globalVariables.GetForReading(); }
 	WriteLockedPointer<VariableSet> GetGlobalVariablesForWriting() noexcept { return globalVariables.GetForWriting(); }
@@ -234,6 +250,16 @@ private:
 	void ReportToolTemperatures(const StringRef& reply, const Tool *tool, bool includeNumber) const noexcept;
 	bool RunStartupFile(const char *filename, bool isMainConfigFile) noexcept;
 
+#if SUPPORT_OBJECT_MODEL
+	static constexpr unsigned int SeqsTableNumber = 6;		// the number of the object model table for MachineModel.seqs
+
+	OutputBuffer *GetModelPatchResponseChunk(const GCodeBuffer *_ecv_null gb, const char *flags, const char *_ecv_array _ecv_null clientSeqs, const ModelSeqs *_ecv_null clientSeqValues,
+												JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException);
+	void ReportModelPatchAsJson(const GCodeBuffer *_ecv_null gb, OutputBuffer *buf, const char *flags, const char *_ecv_array _ecv_null clientSeqs, const ModelSeqs *_ecv_null clientSeqValues,
+									JsonResumePoint& resumePoint, size_t maxChunkLength) const THROWS(GCodeException);
+	static bool GetClientSeq(const char *clientSeqs, const char *name, int32_t& seq) noexcept;
+#endif
+
 	static constexpr uint32_t MaxTicksInSpinState = 20000;	// timeout before we reset the processor
 	static constexpr uint32_t HighTicksInSpinState = 16000;	// how long before we warn that timeout is approaching
 
@@ -272,6 +298,7 @@ private:
 
 	uint16_t boardsSeq, directoriesSeq, fansSeq, heatSeq, inputsSeq, jobSeq, moveSeq, globalSeq;
 	uint16_t networkSeq, scannerSeq, sensorsSeq, spindlesSeq, stateSeq, toolsSeq, volumesSeq;
+	volatile uint32_t modelChangeCount;
 
 	GlobalVariables globalVariables;
 
@@ -171,12 +171,9 @@ Licence: GPL
 
 RepRap reprap;
 
-// Get the format string to use for printing a floating point number to the specified number of decimal digits. Zero means the maximum sensible number.
-const char *_ecv_array GetFloatFormatString(float val, unsigned int numDigitsAfterPoint) noexcept
+// Get the number of decimal digits to print after the point for a floating point number. Zero means the maximum sensible number.
+static unsigned int GetNumFloatDigits(float val, unsigned int numDigitsAfterPoint) noexcept
 {
-	static constexpr const char *_ecv_array FormatStrings[] = { "%.7f", "%.1f", "%.2f", "%.3f", "%.4f", "%.5f", "%.6f", "%.7f" };
-	static_assert(ARRAY_SIZE(FormatStrings) == MaxFloatDigitsDisplayedAfterPoint + 1);
-
 	float f = 1.0;
 	unsigned int maxDigitsAfterPoint = MaxFloatDigitsDisplayedAfterPoint;
 	while (maxDigitsAfterPoint > 1 && val >= f)
@@ -185,7 +182,115 @@ const char *_ecv_array GetFloatFormatString(float val, unsigned int numDigitsAft
 		--maxDigitsAfterPoint;
 	}
 
-	return FormatStrings[min<unsigned int>(numDigitsAfterPoint, maxDigitsAfterPoint)];
+	const unsigned int numDigits = min<unsigned int>(numDigitsAfterPoint, maxDigitsAfterPoint);
+	return (numDigits == 0) ? MaxFloatDigitsDisplayedAfterPoint : numDigits;
+}
+
+// Get the format string to use for printing a floating point number to the specified number of decimal digits. Zero means the maximum sensible number.
+const char *_ecv_array GetFloatFormatString(float val, unsigned int numDigitsAfterPoint) noexcept
+{
+	static constexpr const char *_ecv_array FormatStrings[] = { "%.7f", "%.1f", "%.2f", "%.3f", "%.4f", "%.5f", "%.6f", "%.7f" };
+	static_assert(ARRAY_SIZE(FormatStrings) == MaxFloatDigitsDisplayedAfterPoint + 1);
+
+	return FormatStrings[GetNumFloatDigits(val, numDigitsAfterPoint)];
+}
+
+// Write the decimal representation of an unsigned integer that is known to fit in 32 bits, padded with leading zeros to at least 'minDigits' digits
+static size_t FormatUnsigned32(char *_ecv_array buf, uint32_t val, unsigned int minDigits) noexcept
+{
+	char digits[10];
+	unsigned int numDigits = 0;
+	do
+	{
+		digits[numDigits++] = (char)('0' + (val % 10u));
+		val /= 10u;
+	} while (val != 0 || numDigits < minDigits);
+
+	for (unsigned int i = 0; i < numDigits; ++i)
+	{
+		buf[i] = digits[numDigits - 1 - i];
+	}
+	buf[numDigits] = 0;
+	return numDigits;
+}
+
+size_t FormatUnsigned(char *_ecv_array buf, uint64_t val) noexcept
+{
+	if (val <= 0xFFFFFFFFu)
+	{
+		return FormatUnsigned32(buf, (uint32_t)val, 1);			// 32-bit division is much faster than 64-bit division on our processors
+	}
+
+	// Split the value into a high part and the low 9 decimal digits so that we only need one 64-bit division
+	const uint64_t high = val / 1000000000u;
+	const uint32_t low = (uint32_t)(val - high * 1000000000u);
+	const size_t len = FormatUnsigned(buf, high);
+	return len + FormatUnsigned32(buf + len, low, 9);
+}
+
+size_t FormatSigned(char *_ecv_array buf, int32_t val) noexcept
+{
+	if (val < 0)
+	{
+		buf[0] = '-';
+		return 1 + FormatUnsigned32(buf + 1, (uint32_t)0 - (uint32_t)val, 1);
+	}
+	return FormatUnsigned32(buf, (uint32_t)val, 1);
+}
+
+// Write a floating point number to the specified number of decimal places, giving the same result as printf would with the format string from GetFloatFormatString.
+// The caller must handle NaNs and infinities if they may occur.
+// We use integer arithmetic on the binary representation of the float. A float has a 24-bit mantissa and 10^7 fits in 24 bits,
+// so the mantissa multiplied by the power of 10 fits in 48 bits and the value scaled by the power of 10 is exact before we round it.
+// We round exact halves to even, like the printf implementations we use. Values too large for this method are passed to printf.
+size_t FormatFloat(char *_ecv_array buf, float val, unsigned int numDigitsAfterPoint) noexcept
+{
+	static constexpr uint32_t PowersOfTen[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+	static_assert(ARRAY_SIZE(PowersOfTen) == MaxFloatDigitsDisplayedAfterPoint + 1);
+
+	const unsigned int numDigits = GetNumFloatDigits(val, numDigitsAfterPoint);
+	uint32_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	const unsigned int biasedExponent = (bits >> 23) & 0xFF;
+	const uint32_t mantissa = (biasedExponent == 0) ? (bits & 0x007FFFFF) : (bits & 0x007FFFFF) | 0x00800000;
+	const int exponent = (biasedExponent == 0) ? -149 : (int)biasedExponent - 150;
+	const uint64_t scaledMantissa = (uint64_t)mantissa * PowersOfTen[numDigits];
+
+	uint64_t scaledValue;
+	if (exponent >= 0)
+	{
+		if (biasedExponent == 0xFF || exponent > 15)
+		{
+			return SafeSnprintf(buf, MaxFormattedFloatLength, GetFloatFormatString(val, numDigitsAfterPoint), (double)val);
+		}
+		scaledValue = scaledMantissa << exponent;
+	}
+	else if (exponent > -64)
+	{
+		const unsigned int shift = (unsigned int)(-exponent);
+		scaledValue = scaledMantissa >> shift;
+		const uint64_t remainder = scaledMantissa & ((1ull << shift) - 1u);
+		const uint64_t half = 1ull << (shift - 1);
+		if (remainder > half || (remainder == half && (scaledValue & 1u) != 0))
+		{
+			++scaledValue;
+		}
+	}
+	else
+	{
+		scaledValue = 0;									// the value is less than 2^-16 of the least significant digit
+	}
+
+	size_t len = 0;
+	if ((bits & 0x80000000) != 0)
+	{
+		buf[len++] = '-';									// printf prints a minus sign even if the value rounds to zero
+	}
+	const uint64_t integerPart = scaledValue / PowersOfTen[numDigits];
+	len += FormatUnsigned(buf + len, integerPart);
+	buf[len++] = '.';
+	len += FormatUnsigned32(buf + len, (uint32_t)(scaledValue - integerPart * PowersOfTen[numDigits]), numDigits);
+	return len;
 }
 
 static const char *_ecv_array const moduleName[] =
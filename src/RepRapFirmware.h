@@ -556,6 +556,13 @@ static inline constexpr float InverseConvertAcceleration(float accel) noexcept
 constexpr unsigned int MaxFloatDigitsDisplayedAfterPoint = 7;
 const char *_ecv_array GetFloatFormatString(float val, unsigned int numDigitsAfterPoint) noexcept;
 
+// Functions to convert numbers to text faster than printf does. Each one writes a null-terminated string and returns its length.
+constexpr size_t MaxFormattedFloatLength = 52;						// enough for -FLT_MAX printed with 7 decimal places
+constexpr size_t MaxFormattedIntegerLength = 21;					// enough for a 64-bit unsigned integer or a signed 32-bit integer
+size_t FormatFloat(char *_ecv_array buf, float val, unsigned int numDigitsAfterPoint) noexcept;		// same result as printf with the format from GetFloatFormatString
+size_t FormatUnsigned(char *_ecv_array buf, uint64_t val) noexcept;
+size_t FormatSigned(char *_ecv_array buf, int32_t val) noexcept;
+
 #if SUPPORT_WORKPLACE_COORDINATES
 constexpr size_t NumCoordinateSystems = 9;							// G54 up to G59.3
 #else
@@ -405,10 +405,11 @@ alignas(4) __nocache char DataTransfer::txBuffer[SbcTransferBufferSize];
 #endif
 
 DataTransfer::DataTransfer() noexcept : state(InternalTransferState::ExchangingData), lastTransferNumber(0), failedTransfers(0), checksumErrors(0),
+	statsStartTime(0), completedTransfers(0), resendRequests(0), rxBytesTransferred(0), txBytesTransferred(0),
 #if SAME5x
 	rxBuffer(nullptr), txBuffer(nullptr),
 #endif
-	rxPointer(0), txPointer(0), packetId(0)
+	rxPointer(0), txPointer(0), txCrcPointer(0), packetId(0)
 {
 	rxResponse = TransferResponse::Success;
 	txResponse = TransferResponse::Success;
@@ -515,6 +516,18 @@ void DataTransfer::Diagnostics(MessageType mtype) noexcept
 	reprap.GetPlatform().MessageF(mtype, "Transfer state: %d, failed transfers: %u, checksum errors: %u\n", (int)state, failedTransfers, checksumErrors);
 	reprap.GetPlatform().MessageF(mtype, "RX/TX seq numbers: %d/%d\n", (int)rxHeader.sequenceNumber, (int)txHeader.sequenceNumber);
 	reprap.GetPlatform().MessageF(mtype, "SPI underruns %u, overruns %u\n", spiTxUnderruns, spiRxOverruns);
+
+	// Report the throughput since the last time we were called, so that changes to the transfer protocol can be measured
+	const uint32_t now = millis();
+	const float interval = (float)(now - statsStartTime) * 0.001;
+	if (interval > 0.0)
+	{
+		reprap.GetPlatform().MessageF(mtype, "Transfers %.1f/s, RX %.1fKb/s, TX %.1fKb/s, resend requests %" PRIu32 "\n",
+										(double)(completedTransfers/interval), (double)(rxBytesTransferred/(interval * 1024.0)), (double)(txBytesTransferred/(interval * 1024.0)), resendRequests);
+	}
+	statsStartTime = now;
+	completedTransfers = resendRequests = 0;
+	rxBytesTransferred = txBytesTransferred = 0;
 }
 
 const PacketHeader *DataTransfer::ReadPacket() noexcept
@@ -848,9 +861,7 @@ TransferState DataTransfer::DoTransfer() noexcept
 				else
 				{
 					// Everything OK
-					rxPointer = txPointer = 0;
-					packetId = 0;
-					state = InternalTransferState::ProcessingData;
+					FinishTransfer();
 					return IsConnectionReset() ? TransferState::connectionReset : TransferState::finished;
 				}
 			}
@@ -898,9 +909,7 @@ TransferState DataTransfer::DoTransfer() noexcept
 			if (rxResponse == TransferResponse::Success && txResponse == TransferResponse::Success)
 			{
 				// Everything OK
-				rxPointer = txPointer = 0;
-				packetId = 0;
-				state = InternalTransferState::ProcessingData;
+				FinishTransfer();
 				return IsConnectionReset() ? TransferState::connectionReset : TransferState::finished;
 			}
 
@@ -962,6 +971,19 @@ TransferState DataTransfer::DoTransfer() noexcept
 	return (state == InternalTransferState::ExchangingHeader) ? TransferState::doingFullTransfer : TransferState::doingPartialTransfer;
 }
 
+// Prepare for processing the received data
+void DataTransfer::FinishTransfer() noexcept
+{
+	completedTransfers++;
+	rxBytesTransferred += rxHeader.dataLength;
+	txBytesTransferred += txHeader.dataLength;
+
+	rxPointer = txPointer = 0;
+	packetId = 0;
+	ResetTxCrc();
+	state = InternalTransferState::ProcessingData;
+}
+
 void DataTransfer::StartNextTransfer() noexcept
 {
 	lastTransferNumber = rxHeader.sequenceNumber;
@@ -978,7 +1000,8 @@ void DataTransfer::StartNextTransfer() noexcept
 	txHeader.numPackets = packetId;
 	txHeader.sequenceNumber++;
 	txHeader.dataLength = txPointer;
-	txHeader.crcData = CalcCRC32(txBuffer, txPointer);
+	UpdateTxCrc();
+	txHeader.crcData = txCrc.Get();
 	txHeader.crcHeader = CalcCRC32(reinterpret_cast<const char *>(&txHeader), sizeof(TransferHeader) - sizeof(uint32_t));
 
 	// Begin SPI transfer
@@ -992,6 +1015,7 @@ void DataTransfer::ResetConnection(bool fullReset) noexcept
 	dataReceived = false;
 	rxPointer = txPointer = 0;
 	packetId = 0;
+	ResetTxCrc();
 
 	// Reset the TfrRdy pin level and the seq numbers only if no communication is taking place
 	if (fullReset)
@@ -1004,7 +1028,8 @@ void DataTransfer::ResetConnection(bool fullReset) noexcept
 	StartNextTransfer();
 }
 
-bool DataTransfer::WriteObjectModel(OutputBuffer *data) noexcept
+// Write an object model response. The data is JSON text or an error message, or CBOR if isBinary is true.
+bool DataTransfer::WriteObjectModel(OutputBuffer *data, bool isBinary) noexcept
 {
 	// Try to write the packet header. This packet type cannot deal with truncated messages
 	if (!CanWritePacket(data->Length()))
@@ -1013,7 +1038,7 @@ bool DataTransfer::WriteObjectModel(OutputBuffer *data) noexcept
 	}
 
 	// Write packet header
-	(void)WritePacketHeader(FirmwareRequest::ObjectModel, sizeof(StringHeader) + data->Length());
+	(void)WritePacketHeader((isBinary) ? FirmwareRequest::BinaryObjectModel : FirmwareRequest::ObjectModel, sizeof(StringHeader) + data->Length());
 
 	// Write header
 	StringHeader *header = WriteDataHeader<StringHeader>();
@@ -1021,15 +1046,12 @@ bool DataTransfer::WriteObjectModel(OutputBuffer *data) noexcept
 	header->padding = 0;
 
 	// Write data
-	while (data != nullptr)
-	{
-		WriteData(data->UnreadData(), data->BytesLeft());
-		data = OutputBuffer::Release(data);
-	}
+	WriteOutputBuffers(data, header->length);
+	OutputBuffer::ReleaseAll(data);
 	return true;
 }
 
-bool DataTransfer::WriteCodeBufferUpdate(uint16_t bufferSpace) noexcept
+bool DataTransfer::WriteCodeBufferUpdate(uint16_t bufferSpace, uint32_t queuedMoveTime) noexcept
 {
 	if (!CanWritePacket(sizeof(CodeBufferUpdateHeader)))
 	{
@@ -1042,7 +1064,7 @@ bool DataTransfer::WriteCodeBufferUpdate(uint16_t bufferSpace) noexcept
 	// Write header
 	CodeBufferUpdateHeader *header = WriteDataHeader<CodeBufferUpdateHeader>();
 	header->bufferSpace = bufferSpace;
-	header->padding = 0;
+	header->queuedMoveTime = min<uint32_t>(queuedMoveTime, UINT16_MAX);
 	return true;
 }
 
@@ -1064,40 +1086,23 @@ bool DataTransfer::WriteCodeReply(MessageType type, OutputBuffer *&response) noe
 	replyHeader->messageType = type;
 	replyHeader->padding = 0;
 
-	// Write code reply
-	size_t bytesWritten = 0;
-	if (response != nullptr)
+	// Work out how much of the reply we can send, so that the headers are complete before the reply is copied
+	size_t bytesLeft = 0;
+	for (const OutputBuffer *buf = response; buf != nullptr; buf = buf->Next())
 	{
-		size_t bytesToCopy;
-		do
-		{
-			bytesToCopy = min<size_t>(FreeTxSpace(), response->BytesLeft());
-			if (bytesToCopy == 0)
-			{
-				break;
-			}
-
-			WriteData(response->UnreadData(), bytesToCopy);
-			bytesWritten += bytesToCopy;
-
-			response->Taken(bytesToCopy);
-			if (response->BytesLeft() == 0)
-			{
-				response = OutputBuffer::Release(response);
-			}
-		}
-		while (response != nullptr);
-
-		if (response != nullptr)
-		{
-			// There is more to come...
-			replyHeader->messageType = (MessageType)(replyHeader->messageType | PushFlag);
-		}
+		bytesLeft += buf->BytesLeft();
 	}
+	const size_t bytesToWrite = min<size_t>(FreeTxSpace(), bytesLeft);
+	if (bytesToWrite < bytesLeft)
+	{
+		// There is more to come...
+		replyHeader->messageType = (MessageType)(replyHeader->messageType | PushFlag);
+	}
+	replyHeader->length = bytesToWrite;
+	header->length = sizeof(MessageHeader) + bytesToWrite;
 
-	// Finish the packet
-	replyHeader->length = bytesWritten;
-	header->length = sizeof(MessageHeader) + bytesWritten;
+	// Write code reply
+	WriteOutputBuffers(response, bytesToWrite);
 	return true;
 }
 
@@ -1706,6 +1711,7 @@ PacketHeader *DataTransfer::WritePacketHeader(FirmwareRequest request, size_t da
 {
 	// Make sure to stay aligned if the last packet ended with a string
 	txPointer = AddPadding(txPointer);
+	UpdateTxCrc();									// the previous packet is complete
 
 	// Write the next packet data
 	PacketHeader *header = reinterpret_cast<PacketHeader*>(txBuffer + txPointer);
@@ -1724,6 +1730,42 @@ void DataTransfer::WriteData(const char *data, size_t length) noexcept
 	txPointer += length;
 }
 
+// Copy data from a chain of output buffers, releasing the buffers that have been used up.
+// The packet must be complete apart from this data, because the data is added to the TX CRC as it is copied.
+void DataTransfer::WriteOutputBuffers(OutputBuffer *&buffers, size_t length) noexcept
+{
+	UpdateTxCrc();
+	while (buffers != nullptr)
+	{
+		const size_t bytesToCopy = min<size_t>(length, buffers->BytesLeft());
+		if (bytesToCopy != 0)
+		{
+			memcpy(txBuffer + txPointer, buffers->UnreadData(), bytesToCopy);
+			txCrc.Update(buffers->UnreadData(), bytesToCopy);
+			txPointer += bytesToCopy;
+			length -= bytesToCopy;
+			buffers->Taken(bytesToCopy);
+		}
+
+		if (buffers->BytesLeft() != 0)
+		{
+			break;
+		}
+		buffers = OutputBuffer::Release(buffers);
+	}
+	txCrcPointer = txPointer;
+}
+
+// Add the data written since the last call to the TX CRC. Only call this when the packets written so far will not be changed any more.
+void DataTransfer::UpdateTxCrc() noexcept
+{
+	if (txPointer > txCrcPointer)
+	{
+		txCrc.Update(txBuffer + txCrcPointer, txPointer - txCrcPointer);
+		txCrcPointer = txPointer;
+	}
+}
+
 template<typename T> T *DataTransfer::WriteDataHeader() noexcept
 {
 	T *header = reinterpret_cast<T*>(txBuffer + txPointer);
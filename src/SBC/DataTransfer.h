@@ -16,6 +16,7 @@
 #include <GCodes/GCodeChannel.h>
 #include "SbcMessageFormats.h"
 #include <RTOSIface/RTOSIface.h>
+#include <Storage/CRC32.h>
 
 class BinaryGCodeBuffer;
 class StringRef;
@@ -65,8 +66,8 @@ public:
 	int ReadFileData(char *buffer, size_t length) noexcept;									// Read file data from the SBC
 
 	void ResendPacket(const PacketHeader *packet) noexcept;
-	bool WriteObjectModel(OutputBuffer *data) noexcept;
-	bool WriteCodeBufferUpdate(uint16_t bufferSpace) noexcept;
+	bool WriteObjectModel(OutputBuffer *data, bool isBinary = false) noexcept;
+	bool WriteCodeBufferUpdate(uint16_t bufferSpace, uint32_t queuedMoveTime) noexcept;
 	bool WriteCodeReply(MessageType type, OutputBuffer *&response) noexcept;
 	bool WriteMacroRequest(GCodeChannel channel, const char *filename, bool fromCode) noexcept;
 	bool WriteAbortFileRequest(GCodeChannel channel, bool abortAll) noexcept;
@@ -107,6 +108,11 @@ private:
 	uint16_t lastTransferNumber;
 	unsigned int failedTransfers, checksumErrors;
 
+	// Throughput statistics, reset when the diagnostics are reported
+	uint32_t statsStartTime;
+	uint32_t completedTransfers, resendRequests;
+	uint64_t rxBytesTransferred, txBytesTransferred;
+
 	// Transfer buffers
 #if SAME70
 	// SAME70 has a write-back cache, so these must be in non-cached memory because we DMA to/from them.
@@ -131,6 +137,11 @@ private:
 #endif
 	size_t rxPointer, txPointer;
 
+	// The CRC of the data to send is accumulated as packets are completed, so that payloads copied from output buffers can be included
+	// in it as they are copied instead of being read back from the TX buffer (which is in non-cached memory on the SAME70)
+	CRC32 txCrc;
+	size_t txCrcPointer;			// the number of bytes at the start of txBuffer that txCrc covers
+
 	// Packet properties
 	uint16_t packetId;
 
@@ -140,6 +151,7 @@ private:
 	void ExchangeResponse(uint32_t response) noexcept;
 	void ExchangeData() noexcept;
 	void RestartTransfer(bool ownRequest) noexcept;
+	void FinishTransfer() noexcept;
 	uint32_t CalcCRC32(const char *buffer, size_t length) const noexcept;
 
 	template<typename T> const T *ReadDataHeader() noexcept;
@@ -150,6 +162,9 @@ private:
 	bool CanWritePacket(size_t dataLength = 0) const noexcept;
 	PacketHeader *WritePacketHeader(FirmwareRequest request, size_t dataLength = 0, uint16_t resendPacktId = 0) noexcept;
 	void WriteData(const char *data, size_t length) noexcept;
+	void WriteOutputBuffers(OutputBuffer *&buffers, size_t length) noexcept;
+	void UpdateTxCrc() noexcept;
+	void ResetTxCrc() noexcept { txCrc.Reset(); txCrcPointer = 0; }
 	template<typename T> T *WriteDataHeader() noexcept;
 
 	size_t AddPadding(size_t length) const noexcept;
@@ -169,6 +184,7 @@ inline size_t DataTransfer::PacketsToRead() const noexcept
 inline void DataTransfer::ResendPacket(const PacketHeader *packet) noexcept
 {
 	WritePacketHeader(FirmwareRequest::ResendPacket, 0, packet->id);
+	resendRequests++;
 }
 
 inline bool DataTransfer::CanWritePacket(size_t dataLength) const noexcept
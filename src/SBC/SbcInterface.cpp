@@ -52,7 +52,8 @@ extern "C" [[noreturn]] void SBCTaskStart(void * pvParameters) noexcept
 SbcInterface::SbcInterface() noexcept : isConnected(false), numDisconnects(0), numTimeouts(0), numSbcTimeouts(0), lastTransferTime(0),
 	maxDelayBetweenTransfers(SpiTransferDelay), maxFileOpenDelay(SpiFileOpenDelay), numMaxEvents(SpiEventsRequired),
 	delaying(false), numEvents(0), reportPause(false), reportPauseWritten(false), printAborted(false),
-	codeBuffer(nullptr), rxPointer(0), txPointer(0), txEnd(0), sendBufferUpdate(true), waitingForFileChunk(false),
+	codeBuffer(nullptr), rxPointer(0), txPointer(0), txEnd(0), sendBufferUpdate(true),
+	codeBufferThrottled(false), numStarvedTransfers(0), numThrottledTransfers(0), numCodesLatencyRecorded(0), totalCodeLatency(0), maxCodeLatency(0), waitingForFileChunk(false),
 	fileMutex(), numOpenFiles(0), fileSemaphore(), fileOperation(FileOperation::none), fileOperationPending(false)
 #ifdef TRACK_FILE_CODES
 	, fileCodesRead(0), fileCodesHandled(0), fileMacrosRunning(0), fileMacrosClosing(0)
@@ -292,6 +293,7 @@ void SbcInterface::ExchangeData() noexcept
 			BufferedCodeHeader *bufHeader = reinterpret_cast<BufferedCodeHeader *>(codeBuffer + txPointer);
 			bufHeader->isPending = true;
 			bufHeader->length = packet->length;
+			bufHeader->whenStored = millis();
 
 			// Store the corresponding code. Binary codes are always aligned on a 4-byte boundary
 			uint32_t *dst = reinterpret_cast<uint32_t *>(codeBuffer + txPointer + sizeof(BufferedCodeHeader));
@@ -310,8 +312,10 @@ void SbcInterface::ExchangeData() noexcept
 
 			try
 			{
-				OutputBuffer *outBuf = reprap.GetModelResponse(nullptr, key.c_str(), flags.c_str());
-				if (outBuf == nullptr || !transfer.WriteObjectModel(outBuf))
+				// If the flags include 'b' then the SBC can decode CBOR, which is faster for us to generate and shorter to send than JSON
+				const bool wantBinary = (strchr(flags.c_str(), 'b') != nullptr);
+				OutputBuffer *outBuf = (wantBinary) ? reprap.GetModelResponseCbor(nullptr, key.c_str(), flags.c_str()) : reprap.GetModelResponse(nullptr, key.c_str(), flags.c_str());
+				if (outBuf == nullptr || !transfer.WriteObjectModel(outBuf, wantBinary))
 				{
 					// Failed to write the whole object model, try again later
 					packetAcknowledged = false;
@@ -858,8 +862,23 @@ void SbcInterface::ExchangeData() noexcept
 		}
 	}
 
+	// Find out how much movement is queued. If the movement queue is about to run dry then ask the SBC for more codes straight away,
+	// and if plenty of movement is queued then report less code buffer space so that the SBC backs off
+	const uint32_t queuedMoveTime = reprap.GetMove().GetMainDDARing().GetQueuedMoveTime();
+	const bool movementStarved = queuedMoveTime < SpiMinQueuedMoveTime && (queuedMoveTime != 0 || reprap.GetGCodes().IsReallyPrinting());
+	const bool throttleCodes = queuedMoveTime > SpiMaxQueuedMoveTime;
+	if (movementStarved)
+	{
+		numStarvedTransfers++;
+		sendBufferUpdate = true;
+	}
+	else if (throttleCodes != codeBufferThrottled)
+	{
+		sendBufferUpdate = true;
+	}
+
 	// Check if we can wait a short moment to reduce CPU load on the SBC
-	if (!skipNextDelay && numEvents < numMaxEvents && !waitingForFileChunk &&
+	if (!skipNextDelay && !movementStarved && numEvents < numMaxEvents && !waitingForFileChunk &&
 		!fileOperationPending && fileOperation == FileOperation::none)
 	{
 		delaying = true;
@@ -893,8 +912,17 @@ void SbcInterface::ExchangeData() noexcept
 	{
 		TaskCriticalSectionLocker locker;
 
-		const uint16_t bufferSpace = (txEnd == 0) ? max<uint16_t>(rxPointer, SpiCodeBufferSize - txPointer) : rxPointer - txPointer;
-		sendBufferUpdate = !transfer.WriteCodeBufferUpdate(bufferSpace);
+		uint16_t bufferSpace = (txEnd == 0) ? max<uint16_t>(rxPointer, SpiCodeBufferSize - txPointer) : rxPointer - txPointer;
+		if (throttleCodes && bufferSpace > MaxCodeBufferSize)
+		{
+			bufferSpace = MaxCodeBufferSize;
+			numThrottledTransfers++;
+		}
+		sendBufferUpdate = !transfer.WriteCodeBufferUpdate(bufferSpace, queuedMoveTime);
+		if (!sendBufferUpdate)
+		{
+			codeBufferThrottled = throttleCodes;
+		}
 	}
 
 	// Get another chunk of the file being requested
@@ -1198,6 +1226,20 @@ void SbcInterface::Diagnostics(MessageType mtype) noexcept
 	transfer.Diagnostics(mtype);
 	reprap.GetPlatform().MessageF(mtype, "State: %d, disconnects: %" PRIu32 ", timeouts: %" PRIu32 " total, %" PRIu32 " by SBC, IAP RAM available 0x%05" PRIx32 "\n", (int)state, numDisconnects, numTimeouts, numSbcTimeouts, iapRamAvailable);
 	reprap.GetPlatform().MessageF(mtype, "Buffer RX/TX: %d/%d-%d, open files: %u\n", (int)rxPointer, (int)txPointer, (int)txEnd, numOpenFiles);
+	reprap.GetPlatform().MessageF(mtype, "Queued move time %" PRIu32 "ms, transfers with movement starved %" PRIu32 ", throttled %" PRIu32 "\n",
+									reprap.GetMove().GetMainDDARing().GetQueuedMoveTime(), numStarvedTransfers, numThrottledTransfers);
+	numStarvedTransfers = numThrottledTransfers = 0;
+
+	uint32_t numCodes, totalLatency, maxLatency;
+	{
+		TaskCriticalSectionLocker locker;
+		numCodes = numCodesLatencyRecorded;
+		totalLatency = totalCodeLatency;
+		maxLatency = maxCodeLatency;
+		numCodesLatencyRecorded = totalCodeLatency = maxCodeLatency = 0;
+	}
+	reprap.GetPlatform().MessageF(mtype, "Codes executed %" PRIu32 ", average wait %.1fms, max wait %" PRIu32 "ms\n",
+									numCodes, (double)((numCodes == 0) ? 0.0 : (float)totalLatency/(float)numCodes), maxLatency);
 #ifdef TRACK_FILE_CODES
 	reprap.GetPlatform().MessageF(mtype, "File codes read/handled: %d/%d, file macros open/closing: %d %d\n", (int)fileCodesRead, (int)fileCodesHandled, (int)fileMacrosRunning, (int)fileMacrosClosing);
 #endif
@@ -1302,6 +1344,15 @@ bool SbcInterface::FillBuffer(GCodeBuffer &gb) noexcept
 						gb.PutBinary(reinterpret_cast<const uint32_t *>(codeHeader), bufHeader->length / sizeof(uint32_t));
 						bufHeader->isPending = false;
 
+						// Record how long the code waited in the buffer
+						const uint32_t codeLatency = millis() - bufHeader->whenStored;
+						totalCodeLatency += codeLatency;
+						numCodesLatencyRecorded++;
+						if (codeLatency > maxCodeLatency)
+						{
+							maxCodeLatency = codeLatency;
+						}
+
 						// Check if we can reset the ring buffer pointers
 						if (updateRxPointer)
 						{
@@ -87,6 +87,9 @@ private:
 	char *codeBuffer;
 	volatile uint16_t rxPointer, txPointer, txEnd;
 	volatile bool sendBufferUpdate;
+	bool codeBufferThrottled;											// true if we reported less code buffer space than we have because plenty of movement is queued
+	uint32_t numStarvedTransfers, numThrottledTransfers;
+	uint32_t numCodesLatencyRecorded, totalCodeLatency, maxCodeLatency;	// how long codes wait in the code buffer before they are executed
 
 	uint32_t iapRamAvailable;											// must be at least 32Kb otherwise the SPI IAP can't work
 
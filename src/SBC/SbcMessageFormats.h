@@ -38,6 +38,8 @@ constexpr uint32_t SpiTransferTimeout = 500;		// maximum allowed delay between d
 constexpr uint32_t SpiMaxTransferTime = 50;			// maximum allowed time for a single SPI transfer
 constexpr uint32_t SpiConnectionTimeout = 4000;		// maximum time to wait for the next transfer (in ms)
 constexpr uint16_t SpiCodeBufferSize = 4096;		// number of bytes available for G-code caching
+constexpr uint32_t SpiMinQueuedMoveTime = 250;		// if less movement than this is queued (in ms) then don't delay the next transfer and always report the code buffer space
+constexpr uint32_t SpiMaxQueuedMoveTime = 2000;		// if more movement than this is queued (in ms) then report at most MaxCodeBufferSize bytes of code buffer space
 
 // Shared structures
 enum class DataType : uint8_t
@@ -139,7 +141,7 @@ struct FileHandleHeader
 struct CodeBufferUpdateHeader
 {
 	uint16_t bufferSpace;
-	uint16_t padding;
+	uint16_t queuedMoveTime;		// approximate time in ms needed to execute the queued moves, saturating at 65535. This used to be padding
 };
 
 struct DoCodeHeader
@@ -224,7 +226,8 @@ enum class FirmwareRequest : uint16_t
 	WriteFile = 21,						// Write to a file
 	SeekFile = 22,						// Seek in a file
 	TruncateFile = 23,					// Truncate a file
-	CloseFile = 24						// Close a file again
+	CloseFile = 24,						// Close a file again
+	BinaryObjectModel = 25				// Response to an object model request whose flags include 'b', encoded as CBOR
 };
 
 struct PrintPausedHeader
@@ -292,6 +295,7 @@ struct BufferedCodeHeader
 	bool isPending;
 	uint8_t padding;
 	uint16_t length;
+	uint32_t whenStored;		// value of millis() when the code was received from the SBC, used to measure how long codes wait to be executed
 };
 
 struct CodeHeader
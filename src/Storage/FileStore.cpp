@@ -9,7 +9,7 @@
 
 #include "FileStore.h"
 
-#if HAS_MASS_STORAGE || HAS_EMBEDDED_FILES
+#if HAS_MASS_STORAGE || HAS_SBC_INTERFACE || HAS_EMBEDDED_FILES
 # include "MassStorage.h"
 #endif
 
@@ -42,7 +42,9 @@ void FileStore::Init() noexcept
 #endif
 #if HAS_SBC_INTERFACE
 	handle = noFileHandle;
-	length = 0;
+	length = sbcOffset = readAheadOffset = 0;
+	readAheadLength = 0;
+	readAheadBuffer = nullptr;
 #endif
 #if HAS_EMBEDDED_FILES || HAS_SBC_INTERFACE
 	offset = 0;
@@ -112,7 +114,7 @@ bool FileStore::Open(const char *_ecv_array filePath, OpenMode mode, uint32_t pr
 		handle = reprap.GetSbcInterface().OpenFile(filePath, mode, length, preAllocSize);
 		if (handle != noFileHandle)
 		{
-			offset = (mode == OpenMode::append) ? length : 0;
+			offset = sbcOffset = (mode == OpenMode::append) ? length : 0;
 			fileOpened = true;
 		}
 		else
@@ -248,11 +250,18 @@ bool FileStore::Seek(FilePosition pos) noexcept
 #if HAS_SBC_INTERFACE
 		if (reprap.UsingSbcInterface())
 		{
-			if (reprap.GetSbcInterface().SeekFile(handle, pos))
+			// If the new position is within the read-ahead data or just after it then we don't need to tell the SBC
+			if (readAheadLength != 0 && pos >= readAheadOffset && pos <= readAheadOffset + readAheadLength)
 			{
 				offset = pos;
 				return true;
 			}
+			if (reprap.GetSbcInterface().SeekFile(handle, pos))
+			{
+				offset = sbcOffset = pos;
+				readAheadLength = 0;
+				return true;
+			}
 			return false;
 		}
 #endif
@@ -386,10 +395,16 @@ int FileStore::Read(char *_ecv_array extBuf, size_t nBytes) noexcept
 #if HAS_SBC_INTERFACE
 		if (reprap.UsingSbcInterface())
 		{
+			if (usageMode == FileUseMode::readOnly)
+			{
+				return ReadFromSbc(extBuf, nBytes);
+			}
+
 			int bytesRead = reprap.GetSbcInterface().ReadFile(handle, extBuf, nBytes);
 			if (bytesRead > 0)
 			{
 				offset += bytesRead;
+				sbcOffset = offset;
 			}
 			return bytesRead;
 		}
@@ -424,6 +439,82 @@ int FileStore::Read(char *_ecv_array extBuf, size_t nBytes) noexcept
 	}
 }
 
+#if HAS_SBC_INTERFACE
+
+// Read from a file opened for reading in SBC mode. Each read from the SBC costs at least one complete transfer,
+// so small reads are satisfied from a read-ahead buffer. This also makes ReadLine and short backward seeks cheap.
+int FileStore::ReadFromSbc(char *_ecv_array extBuf, size_t nBytes) noexcept
+{
+	// Copy as much as we can from the read-ahead buffer
+	size_t bytesCopied = 0;
+	if (readAheadLength != 0 && offset >= readAheadOffset && offset < readAheadOffset + readAheadLength)
+	{
+		bytesCopied = min<size_t>(nBytes, readAheadOffset + readAheadLength - offset);
+		memcpy(extBuf, readAheadBuffer + (offset - readAheadOffset), bytesCopied);
+		offset += bytesCopied;
+		if (bytesCopied == nBytes)
+		{
+			return (int)bytesCopied;
+		}
+	}
+
+	// We need more data from the SBC
+	SbcInterface& sbc = reprap.GetSbcInterface();
+	if (offset != sbcOffset)
+	{
+		if (!sbc.SeekFile(handle, offset))
+		{
+			return (bytesCopied != 0) ? (int)bytesCopied : -1;
+		}
+		sbcOffset = offset;
+	}
+
+	const size_t bytesWanted = nBytes - bytesCopied;
+	if (readAheadBuffer == nullptr && bytesWanted < SbcFileReadAheadSize)
+	{
+		readAheadBuffer = MassStorage::AllocateReadAheadBuffer();
+	}
+
+	if (readAheadBuffer == nullptr || bytesWanted >= SbcFileReadAheadSize)
+	{
+		// This is a big read or all the read-ahead buffers are in use, so read the data directly into the caller's buffer
+		const int bytesRead = sbc.ReadFile(handle, extBuf + bytesCopied, bytesWanted);
+		if (bytesRead < 0)
+		{
+			return (bytesCopied != 0) ? (int)bytesCopied : -1;
+		}
+		offset = sbcOffset = offset + bytesRead;
+		return (int)bytesCopied + bytesRead;
+	}
+
+	const int bytesRead = sbc.ReadFile(handle, readAheadBuffer, SbcFileReadAheadSize);
+	if (bytesRead < 0)
+	{
+		readAheadLength = 0;
+		return (bytesCopied != 0) ? (int)bytesCopied : -1;
+	}
+
+	readAheadOffset = offset;
+	readAheadLength = (size_t)bytesRead;
+	sbcOffset = offset + readAheadLength;
+	const size_t bytesToCopy = min<size_t>(bytesWanted, readAheadLength);
+	memcpy(extBuf + bytesCopied, readAheadBuffer, bytesToCopy);
+	offset += bytesToCopy;
+	return (int)(bytesCopied + bytesToCopy);
+}
+
+void FileStore::ReleaseReadAheadBuffer() noexcept
+{
+	if (readAheadBuffer != nullptr)
+	{
+		MassStorage::ReleaseReadAheadBuffer(readAheadBuffer);
+		readAheadBuffer = nullptr;
+	}
+	readAheadLength = 0;
+}
+
+#endif
+
 // As Read but stop after '\n' or '\r\n' and null-terminate the string.
 // If the next line is too long to fit in the buffer then the line will be split.
 // Return the number of characters in the line excluding the null terminator, or -1 if end of file or a read error occurs.
@@ -479,8 +570,9 @@ bool FileStore::ForceClose() noexcept
 	if (reprap.UsingSbcInterface())
 	{
 		reprap.GetSbcInterface().CloseFile(handle);
+		ReleaseReadAheadBuffer();
 		handle = noFileHandle;
-		offset = length = 0;
+		offset = length = sbcOffset = 0;
 		usageMode = FileUseMode::free;
 		return ok;
 	}
@@ -545,6 +637,7 @@ bool FileStore::Store(const char *_ecv_array s, size_t len, size_t *bytesWritten
 		bool ok = (len > 0) ? reprap.GetSbcInterface().WriteFile(handle, s, len) : true;
 		*bytesWritten = ok ? len : 0;
 		offset += len;
+		sbcOffset = offset;
 		if (offset > length)
 		{
 			length = offset;
@@ -684,6 +777,7 @@ void FileStore::Invalidate() noexcept
 		MassStorage::ReleaseWriteBuffer(writeBuffer);
 		writeBuffer = nullptr;
 	}
+	ReleaseReadAheadBuffer();
 	closeRequested = false;
 	openCount = 0;
 	usageMode = FileUseMode::invalidated;
@@ -91,6 +91,10 @@ public:
 private:
 	void Init() noexcept;
 	bool Store(const char *_ecv_array s, size_t len, size_t *bytesWritten) noexcept;	// Write data to the non-volatile storage
+#if HAS_SBC_INTERFACE
+	int ReadFromSbc(char *_ecv_array extBuf, size_t nBytes) noexcept;			// Read from a file opened for reading, using the read-ahead buffer
+	void ReleaseReadAheadBuffer() noexcept;
+#endif
 
 	volatile unsigned int openCount;
 
@@ -107,6 +111,10 @@ private:
 #if HAS_SBC_INTERFACE
 	FileHandle handle;
 	FilePosition length;
+	FilePosition sbcOffset;										// the file position that the SBC has, which is past the end of the read-ahead data if there is any
+	FilePosition readAheadOffset;								// the file position of the first byte in the read-ahead buffer
+	size_t readAheadLength;										// how many bytes of the file are in the read-ahead buffer
+	char *_ecv_array _ecv_null readAheadBuffer;					// taken from the pool in MassStorage when a file opened for reading is read in small chunks
 #endif
 
 #if HAS_EMBEDDED_FILES
@@ -145,6 +145,11 @@ static FileInfoParser infoParser;
 static FileWriteBuffer *freeWriteBuffers;
 #endif
 
+#if HAS_SBC_INTERFACE
+static char *_ecv_array _ecv_null readAheadBuffers[NumSbcReadAheadBuffers];		// allocated when first needed and never freed, to avoid fragmenting the heap
+static bool readAheadBufferInUse[NumSbcReadAheadBuffers];
+#endif
+
 #if HAS_MASS_STORAGE || HAS_SBC_INTERFACE || HAS_EMBEDDED_FILES
 static Mutex fsMutex;
 static FileStore files[MAX_FILES];
@@ -552,6 +557,39 @@ void MassStorage::ReleaseWriteBuffer(FileWriteBuffer *buffer) noexcept
 
 # if HAS_SBC_INTERFACE
 
+char *_ecv_array _ecv_null MassStorage::AllocateReadAheadBuffer() noexcept
+{
+	MutexLocker lock(fsMutex);
+
+	for (size_t i = 0; i < NumSbcReadAheadBuffers; ++i)
+	{
+		if (!readAheadBufferInUse[i])
+		{
+			if (readAheadBuffers[i] == nullptr)
+			{
+				readAheadBuffers[i] = new char[SbcFileReadAheadSize];
+			}
+			readAheadBufferInUse[i] = true;
+			return readAheadBuffers[i];
+		}
+	}
+	return nullptr;
+}
+
+void MassStorage::ReleaseReadAheadBuffer(char *_ecv_array buffer) noexcept
+{
+	MutexLocker lock(fsMutex);
+
+	for (size_t i = 0; i < NumSbcReadAheadBuffers; ++i)
+	{
+		if (readAheadBuffers[i] == buffer)
+		{
+			readAheadBufferInUse[i] = false;
+			break;
+		}
+	}
+}
+
 // Return true if any files are open on the file system
 bool MassStorage::AnyFileOpen() noexcept
 {
@@ -63,6 +63,8 @@ namespace MassStorage
 #endif
 
 #if HAS_SBC_INTERFACE
+	char *_ecv_array _ecv_null AllocateReadAheadBuffer() noexcept;							// Get a buffer of SbcFileReadAheadSize bytes, or nullptr if they are all in use
+	void ReleaseReadAheadBuffer(char *_ecv_array buffer) noexcept;
 	bool AnyFileOpen() noexcept;															// Return true if any files are open on the file system
 	void InvalidateAllFiles() noexcept;
 #endif